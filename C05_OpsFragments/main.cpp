@@ -183,6 +183,7 @@ struct App : public OpenGLApplication
 		texBox.deleteObject();
 		texDrywall.deleteObject();
 		texWindow.deleteObject();
+		getSamplers().deleteObjects();
 		basicProg.deleteShaders();
 		basicProg.deleteProgram();
 		fogProg.deleteShaders();
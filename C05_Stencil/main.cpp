@@ -65,6 +65,7 @@ struct App : public OpenGLApplication
 			"2 : wireframe à travers la lunette" "\n"
 			"3 : filtre négatif à travers la lunette" "\n"
 			"X et Z : zoom in/out dans la lunette" "\n"
+			"M : afficher la mémoire prise par les textures" "\n"
 		);
 
 		// Config de base, pas de cull, lignes assez visibles.
@@ -99,8 +100,7 @@ struct App : public OpenGLApplication
 		texDrywall = Texture::loadFromFile("drywall.png");
 		texRoad = Texture::loadFromFile("asphalt.png");
 		// Activer la répétition pour la texture d'asphalte.
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		texRoad.setSampling({.wrapS = GL_MIRRORED_REPEAT, .wrapT = GL_REPEAT});
 
 		basicProg.use();
 		basicProg.setInt("texMain", 0);
@@ -203,6 +203,7 @@ struct App : public OpenGLApplication
 		texRoad.deleteObject();
 		texScopeReticle.deleteObject();
 		texScopeMask.deleteObject();
+		getSamplers().deleteObjects();
 		basicProg.deleteShaders();
 		basicProg.deleteProgram();
 	}
@@ -221,6 +222,7 @@ struct App : public OpenGLApplication
 		// Touche 3 : Filtre négatif à travers la lunette
 		// Touche Z : Zoom out
 		// Touche X : Zoom in
+		// Touche M : Mémoire prise par les textures, par format (le masque de la lunette est en niveaux de gris avec alpha, donc en RG8)
 		using enum sf::Keyboard::Key;
 		switch (key.code) {
 		case Num1:
@@ -239,6 +241,9 @@ struct App : public OpenGLApplication
 		case X:
 			scopeZoom += 1;
 			break;
+		case M:
+			getTextureMemoryStats().print();
+			break;
 
 		case F5:
 			std::string path = saveScreenshot();
@@ -8,6 +8,9 @@ uniform mat4 projection = mat4(1);
 uniform vec4 clipPlane = vec4(0);
 uniform bool clipEnabled = false;
 
+// Échelle (xy) et décalage (zw) des coordonnées de texture, pour échantillonner une couleur de palette.
+uniform vec4 texCoordsTransform = vec4(1, 1, 0, 0);
+
 
 layout(location = 0) in vec3 a_position;
 layout(location = 1) in vec3 a_normal;
@@ -29,5 +32,5 @@ void main() {
 		gl_ClipDistance[0] = dot(clipPlane, worldPosition);
 
 	gl_Position = clipPosition;
-	texCoords = a_texCoords;
+	texCoords = a_texCoords * texCoordsTransform.xy + texCoordsTransform.zw;
 }
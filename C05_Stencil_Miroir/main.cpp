@@ -16,8 +16,10 @@
 
 #include <inf2705/OpenGLApplication.hpp>
 #include <inf2705/Mesh.hpp>
+#include <inf2705/MeshPool.hpp>
 #include <inf2705/ShaderProgram.hpp>
 #include <inf2705/Texture.hpp>
+#include <inf2705/TextureCache.hpp>
 #include <inf2705/TransformStack.hpp>
 #include <inf2705/OrbitCamera.hpp>
 
@@ -28,21 +30,25 @@ using namespace glm;
 
 struct App : public OpenGLApplication
 {
-	Mesh floor;
-	Mesh teapot;
-	Mesh cube;
-	Mesh pole;
-	Mesh quad;
-	Mesh mirrorFrame;
-	Texture texSteel;
-	Texture texRust;
-	Texture texConcrete;
-	Texture texBox;
-	Texture texBuilding;
-	Texture texRock;
-	Texture texGlass;
-	Texture texBlank;
-	Texture texStencil;
+	// Tous les meshes de la scène sont dans les mêmes tampons, donc on les trace sans changer de VAO.
+	MeshPool meshPool;
+	PooledMesh floor;
+	PooledMesh teapot;
+	PooledMesh cube;
+	PooledMesh pole;
+	PooledMesh quad;
+	PooledMesh mirrorFrame;
+	// Les textures viennent du cache, qui ne charge qu'une fois une même image. La couleur transparente du miroir est un texel de la palette du cache plutôt qu'une texture à part.
+	TextureCache textures;
+	SharedTexture texSteel;
+	SharedTexture texRust;
+	SharedTexture texConcrete;
+	SharedTexture texBox;
+	SharedTexture texBuilding;
+	SharedTexture texRock;
+	SharedTexture texGlass;
+	SharedTexture texStencil;
+	vec4 blankTexCoordsTransform = {};
 
 	ShaderProgram clipPlaneProg;
 
@@ -59,6 +65,7 @@ struct App : public OpenGLApplication
 	bool showingRegularScene = true;
 	Uniform<vec4> clipPlane = {"clipPlane"};
 	Uniform<bool> clipEnabled = {"clipEnabled"};
+	Uniform<vec4> texCoordsTransform = {"texCoordsTransform", {1, 1, 0, 0}};
 
 	// Appelée avant la première trame.
 	void init() override {
@@ -86,22 +93,26 @@ struct App : public OpenGLApplication
 
 		loadShaders();
 
-		teapot = Mesh::loadFromWavefrontFile("teapot.obj")[0];
-		cube = Mesh::loadFromWavefrontFile("cube.obj")[0];
-		floor = Mesh::loadFromWavefrontFile("floor.obj")[0];
-		pole = Mesh::loadFromWavefrontFile("pole.obj")[0];
-		quad = Mesh::loadFromWavefrontFile("quad.obj")[0];
-		mirrorFrame = Mesh::loadFromWavefrontFile("frame.obj")[0];
-
-		texSteel = Texture::loadFromFile("steel.png", 8);
-		texRust = Texture::loadFromFile("rust.png", 8);
-		texConcrete = Texture::loadFromFile("concrete.png", 8);
-		texBuilding = Texture::loadFromFile("building.png", 8);
-		texBox = Texture::loadFromFile("box.png", 1);
-		texRock = Texture::loadFromFile("rock.png", 8);
-		texGlass = Texture::loadFromFile("glass.png", 8);
-		texStencil = Texture::loadFromFile("stencil.png", 1);
-		texBlank = Texture::createFromColor({0, 0, 0, 0});
+		// Les meshes sont chargés sans créer leurs propres tampons (setupOnLoad = false), puis copiés dans le pool. Le pool grandit au besoin.
+		meshPool.create(8192, 16384, GL_UNSIGNED_SHORT);
+		teapot = meshPool.add(Mesh::loadFromWavefrontFile("teapot.obj", false, true)[0]);
+		cube = meshPool.add(Mesh::loadFromWavefrontFile("cube.obj", false, true)[0]);
+		floor = meshPool.add(Mesh::loadFromWavefrontFile("floor.obj", false, true)[0]);
+		pole = meshPool.add(Mesh::loadFromWavefrontFile("pole.obj", false, true)[0]);
+		quad = meshPool.add(Mesh::loadFromWavefrontFile("quad.obj", false, true)[0]);
+		mirrorFrame = meshPool.add(Mesh::loadFromWavefrontFile("frame.obj", false, true)[0]);
+
+		// Les textures sont compressées (BC1, ou BC3 pour celles avec de la transparence comme la vitre) : 4 à 8 fois moins de mémoire. La compression est faite au premier lancement puis relue des fichiers .bccache.
+		textures.compressing = true;
+		texSteel = textures.load("steel.png", 8);
+		texRust = textures.load("rust.png", 8);
+		texConcrete = textures.load("concrete.png", 8);
+		texBuilding = textures.load("building.png", 8);
+		texBox = textures.load("box.png", 1);
+		texRock = textures.load("rock.png", 8);
+		texGlass = textures.load("glass.png", 8);
+		texStencil = textures.load("stencil.png", 1);
+		blankTexCoordsTransform = textures.getColorTexCoordsTransform({0, 0, 0, 0});
 		clipPlaneProg.use();
 		clipPlaneProg.setInt("texMain", 0);
 
@@ -151,10 +162,9 @@ struct App : public OpenGLApplication
 
 	// Appelée lorsque la fenêtre se ferme.
 	void onClose() override {
-		for (auto mesh : {&floor, &teapot, &cube, &pole, &quad, &mirrorFrame})
-			mesh->deleteObjects();
-		for (auto tex : {&texSteel, &texRust, &texConcrete, &texBox, &texBuilding, &texRock, &texGlass, &texBlank, &texStencil})
-			tex->deleteObject();
+		meshPool.deleteObjects();
+		textures.deleteObjects();
+		getSamplers().deleteObjects();
 		clipPlaneProg.deleteShaders();
 		clipPlaneProg.deleteProgram();
 	}
@@ -232,13 +242,20 @@ struct App : public OpenGLApplication
 			model.scale({4, 2, 1});
 			clipPlaneProg.setMat(model);
 		} model.pop();
-		if (usingGlassTextured)
+		if (usingGlassTextured) {
 			// Texture semi-transparente.
-			texGlass.bindToTextureUnit(0);
-		else
-			// Texture complètement transparente.
-			texBlank.bindToTextureUnit(0);
-		quad.draw();
+			texGlass->bindToTextureUnit(0);
+		} else {
+			// Couleur complètement transparente, prise dans la palette.
+			textures.palette.getTexture().bindToTextureUnit(0);
+			texCoordsTransform = blankTexCoordsTransform;
+			clipPlaneProg.setUniform(texCoordsTransform);
+		}
+		meshPool.bind();
+		meshPool.draw(quad);
+		meshPool.unbind();
+		texCoordsTransform = {1, 1, 0, 0};
+		clipPlaneProg.setUniform(texCoordsTransform);
 	}
 
 	void drawReflectedScene() {
@@ -271,6 +288,7 @@ struct App : public OpenGLApplication
 
 	void drawScene() {
 		clipPlaneProg.use();
+		meshPool.bind();
 
 		clipPlaneProg.setMat(model);
 
@@ -279,8 +297,8 @@ struct App : public OpenGLApplication
 			model.translate({0, 0, -0.5});
 			clipPlaneProg.setMat(model);
 		} model.pop();
-		texConcrete.bindToTextureUnit(0);
-		floor.draw();
+		texConcrete->bindToTextureUnit(0);
+		meshPool.draw(floor);
 
 		// Le cube qui ressemble à un bâtiment.
 		model.push(); {
@@ -288,8 +306,8 @@ struct App : public OpenGLApplication
 			model.scale({1, 1.5, 1});
 			clipPlaneProg.setMat(model);
 		} model.pop();
-		texBuilding.bindToTextureUnit(0);
-		cube.draw();
+		texBuilding->bindToTextureUnit(0);
+		meshPool.draw(cube);
 
 		// La grosse boîte de carton.
 		model.push(); {
@@ -298,8 +316,8 @@ struct App : public OpenGLApplication
 			model.scale({1.5, 1.5, 1.5});
 			clipPlaneProg.setMat(model);
 		} model.pop();
-		texBox.bindToTextureUnit(0);
-		cube.draw();
+		texBox->bindToTextureUnit(0);
+		meshPool.draw(cube);
 
 		// Le pole de rotation de la théière.
 		model.push(); {
@@ -308,8 +326,8 @@ struct App : public OpenGLApplication
 			model.scale({0.5, 0.2, 0.5});
 			clipPlaneProg.setMat(model);
 		} model.pop();
-		texRust.bindToTextureUnit(0);
-		pole.draw();
+		texRust->bindToTextureUnit(0);
+		meshPool.draw(pole);
 
 		// La théière qui bouge.
 		model.push(); {
@@ -319,8 +337,8 @@ struct App : public OpenGLApplication
 			model.translate({0, -0.3, 1.5});
 			clipPlaneProg.setMat(model);
 		} model.pop();
-		texRock.bindToTextureUnit(0);
-		teapot.draw();
+		texRock->bindToTextureUnit(0);
+		meshPool.draw(teapot);
 
 		// Le poteau auquel est attaché le miroir.
 		model.push(); {
@@ -328,8 +346,8 @@ struct App : public OpenGLApplication
 			model.scale({0.75, 1, 0.75});
 			clipPlaneProg.setMat(model);
 		} model.pop();
-		texRust.bindToTextureUnit(0);
-		pole.draw();
+		texRust->bindToTextureUnit(0);
+		meshPool.draw(pole);
 
 		// Le cadre du miroir.
 		model.push(); {
@@ -337,8 +355,10 @@ struct App : public OpenGLApplication
 			model.scale({4, 2, 1});
 			clipPlaneProg.setMat(model);
 		} model.pop();
-		texSteel.bindToTextureUnit(0);
-		mirrorFrame.draw();
+		texSteel->bindToTextureUnit(0);
+		meshPool.draw(mirrorFrame);
+
+		meshPool.unbind();
 	}
 
 	void drawStencilZone() {
@@ -347,9 +367,11 @@ struct App : public OpenGLApplication
 			clipPlaneProg.setMat(model);
 			clipPlaneProg.setMat(view);
 			clipPlaneProg.setMat(projection);
-			texStencil.bindToTextureUnit(0);
+			texStencil->bindToTextureUnit(0);
 			glDisable(GL_CULL_FACE);
-			quad.draw();
+			meshPool.bind();
+			meshPool.draw(quad);
+			meshPool.unbind();
 			glEnable(GL_CULL_FACE);
 		} model.pop(); view.pop(); projection.pop();
 		clipPlaneProg.setMat(model);
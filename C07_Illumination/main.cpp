@@ -148,9 +148,16 @@ struct App : public OpenGLApplication
 
 		loadShaders();
 
-		// On a deux sphères dont les géométries sont identiques, mais dont les normales sont calculées différemment. "smooth" veut dire normales interpolées aux sommets et "flat" veut dire normales perpendiculaires à la surface des primitives. Cette information est précaculée (par Blender par exemple) et encodée dans le mesh lui-même (VertexData::normal).
-		shapeFlat = Mesh::loadFromWavefrontFile("sphere_flat.obj")[0];
-		shapeSmooth = Mesh::loadFromWavefrontFile("sphere_smooth.obj")[0];
+		// On a deux sphères dont les géométries sont identiques, mais dont les normales sont calculées différemment. "smooth" veut dire normales interpolées aux sommets et "flat" veut dire normales perpendiculaires à la surface des primitives. Plutôt que de charger deux fichiers, on charge la géométrie une fois et on calcule les deux sortes de normales (VertexData::normal) au chargement.
+		Mesh sphere = Mesh::loadFromWavefrontFile("sphere.obj", false)[0];
+		shapeFlat = sphere;
+		shapeFlat.generateFlatNormals();
+		shapeFlat.setup();
+		// La sphère lisse est tracée avec les nuanceurs les plus coûteux (Phong). Ses normales sont lissées (la sphère n'a pas d'arêtes vives, d'où l'angle de 90°), puis on réordonne ses triangles pour le cache de sommets et le surdessinage avant de l'envoyer sur le GPU.
+		shapeSmooth = sphere;
+		shapeSmooth.generateSmoothNormals(90);
+		shapeSmooth.optimize();
+		shapeSmooth.setup();
 		buildNormalLines(0.5f);
 
 		// Initialiser le matériau.
@@ -388,25 +395,25 @@ struct App : public OpenGLApplication
 
 	void loadShaders() {
 		uniformProg.create();
-		uniformProg.attachSourceFile(GL_VERTEX_SHADER, "basic_vert.glsl");
-		uniformProg.attachSourceFile(GL_FRAGMENT_SHADER, "uniform_frag.glsl");
+		uniformProg.addSourceFile(GL_VERTEX_SHADER, "basic_vert.glsl");
+		uniformProg.addSourceFile(GL_FRAGMENT_SHADER, "uniform_frag.glsl");
 		uniformProg.link();
 
 		// Le nuanceur de fragments pour le flat shading prend en entrée la couleur (venant du nuanceur de géométrie) et l'affecte telle-quelle en sortie. On réutilise donc le nuanceur de fragments de Gouraud.
 		flatProg.create();
-		flatProg.attachSourceFile(GL_VERTEX_SHADER, "flat_vert.glsl");
-		flatProg.attachSourceFile(GL_GEOMETRY_SHADER, "flat_geom.glsl");
-		flatProg.attachSourceFile(GL_FRAGMENT_SHADER, "gouraud_frag.glsl");
+		flatProg.addSourceFile(GL_VERTEX_SHADER, "flat_vert.glsl");
+		flatProg.addSourceFile(GL_GEOMETRY_SHADER, "flat_geom.glsl");
+		flatProg.addSourceFile(GL_FRAGMENT_SHADER, "gouraud_frag.glsl");
 		flatProg.link();
 
 		gouraudProg.create();
-		gouraudProg.attachSourceFile(GL_VERTEX_SHADER, "gouraud_vert.glsl");
-		gouraudProg.attachSourceFile(GL_FRAGMENT_SHADER, "gouraud_frag.glsl");
+		gouraudProg.addSourceFile(GL_VERTEX_SHADER, "gouraud_vert.glsl");
+		gouraudProg.addSourceFile(GL_FRAGMENT_SHADER, "gouraud_frag.glsl");
 		gouraudProg.link();
 
 		phongProg.create();
-		phongProg.attachSourceFile(GL_VERTEX_SHADER, "phong_vert.glsl");
-		phongProg.attachSourceFile(GL_FRAGMENT_SHADER, "phong_frag.glsl");
+		phongProg.addSourceFile(GL_VERTEX_SHADER, "phong_vert.glsl");
+		phongProg.addSourceFile(GL_FRAGMENT_SHADER, "phong_frag.glsl");
 		phongProg.link();
 	}
 
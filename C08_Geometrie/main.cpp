@@ -17,6 +17,7 @@
 #include <inf2705/Mesh.hpp>
 #include <inf2705/ShaderProgram.hpp>
 #include <inf2705/Texture.hpp>
+#include <inf2705/TextureArray.hpp>
 #include <inf2705/TransformStack.hpp>
 #include <inf2705/OrbitCamera.hpp>
 
@@ -26,44 +27,27 @@ using namespace glm;
 
 
 // Un spritesheet est une vielle méthode d'animation numérique. C'est à la base une image qui contient plusieurs sprites (lutins). Ces sprites sont de petites images qui, ensemble, forment les trames d'une animation. Chaque sprite dans le spritesheet est placé dans une disposition régulière (horizontalement dans notre cas). On utilise ensuite un index dans le spritesheet pour afficher le sprite correct à l'écran.
+// Les sprites sont les couches d'un tableau de textures (voir TextureArray). On lie le tableau une seule fois et l'index du sprite est passé au nuanceur par une variable uniforme, plutôt que de lier une texture différente à chaque trame.
 struct SpriteSheet
 {
-	sf::Image originalImg;
-	std::vector<Texture> sprites;
+	TextureArray sprites;
 	ivec2 elemSize;
 
-	void bindToTextureUnit(int spriteIndex, int activeUnit) {
-		sprites[spriteIndex].bindToTextureUnit(activeUnit);
+	int getNumSprites() const { return sprites.numLayers; }
+
+	void bindToTextureUnit(int activeUnit) {
+		sprites.bindToTextureUnit(activeUnit);
+	}
+
+	void deleteObject() {
+		sprites.deleteObject();
 	}
 
 	static SpriteSheet loadFromFile(const std::string& filename, ivec2 spriteElemSize, int numSprites) {
 		SpriteSheet result;
-		// Charger l'image avec tous les éléments.
-		if (not result.originalImg.loadFromFile(filename)) {
-			std::cerr << std::format("{} could not be loaded", filename) << "\n";
-			return {};
-		}
-
 		result.elemSize = spriteElemSize;
-		sf::Image spriteImg;
-		spriteImg.create(spriteElemSize.x, spriteElemSize.y);
-		// Pour chaque sprite :
-		for (int i = 0; i < numSprites; i++) {
-			// Copier la partie de l'image originale.
-			spriteImg.copy(
-				result.originalImg,
-				0, 0,
-				{i * spriteElemSize.x, 0, spriteElemSize.x, spriteElemSize.y}
-			);
-			// Charger cette sous-image dans une texture séparée.
-			result.sprites.push_back(Texture::loadFromImage(spriteImg));
-			// Configurer la texture pour ne pas appliquer de filtre. C'est une texture qui est supposée être pixelisée.
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		}
-
+		// Découper l'image en une couche par sprite. Les couches sont configurées sans filtre, ce sont des textures qui sont supposées être pixelisées.
+		result.sprites = TextureArray::loadFromSpriteSheet(filename, spriteElemSize, numSprites);
 		return result;
 	}
 };
@@ -92,6 +76,7 @@ struct App : public OpenGLApplication
 	int swordStartFrame = -1;
 	Uniform<float> extrudeLength = {"extrudeLength", 0.0f};
 	Uniform<bool> usingWorldPositions = {"usingWorldPositions", false};
+	Uniform<int> spriteLayer = {"spriteLayer", 0};
 
 	// Appelée avant la première trame.
 	void init() override {
@@ -157,7 +142,7 @@ struct App : public OpenGLApplication
 		extrudeSpikesProg.use();
 		extrudeSpikesProg.setInt("texMain", 0);
 		spritesProg.use();
-		spritesProg.setInt("texMain", 1);
+		spritesProg.setInt("texSprites", 1);
 		uniColorProg.use();
 		uniColorProg.setVec("globalColor", vec4(1, 0.7f, 0.7f, 1));
 
@@ -201,10 +186,9 @@ struct App : public OpenGLApplication
 			prog->deleteShaders();
 			prog->deleteProgram();
 		}
-		for (auto sheet : {&spriteLink, &spriteSword}) {
-			for (auto& sprite : sheet->sprites)
-				sprite.deleteObject();
-		}
+		for (auto sheet : {&spriteLink, &spriteSword})
+			sheet->deleteObject();
+		getSamplers().deleteObjects();
 	}
 
 	// Appelée lors d'une touche de clavier.
@@ -299,7 +283,7 @@ struct App : public OpenGLApplication
 		spritesProg.use();
 
 		// Calculer l'état de l'animation.
-		int numSwingAnimFrames = (int)spriteLink.sprites.size();
+		int numSwingAnimFrames = spriteLink.getNumSprites();
 		int swingAnimFrame = 0;
 		if (swingStartFrame != -1) {
 			swingAnimFrame = getCurrentFrameNumber() - swingStartFrame;
@@ -307,7 +291,9 @@ struct App : public OpenGLApplication
 		}
 
 		// Choisir quel lutin (sprite) utiliser selon la trame actuelle.
-		spriteLink.bindToTextureUnit(swingAnimFrame % numSwingAnimFrames, 1);
+		spriteLink.bindToTextureUnit(1);
+		spriteLayer = swingAnimFrame % numSwingAnimFrames;
+		spritesProg.setUniform(spriteLayer);
 
 		modelSprite.loadIdentity();
 		// Positionner le point.
@@ -324,14 +310,16 @@ struct App : public OpenGLApplication
 		spritesProg.use();
 
 		// Calculer l'état de l'animation.
-		int linkAnimLength = (int)spriteLink.sprites.size() * 4;
+		int linkAnimLength = spriteLink.getNumSprites() * 4;
 		int swordAnimFrame = getCurrentFrameNumber() - swingStartFrame - linkAnimLength;
 		if (swingStartFrame == -1 or swordAnimFrame < 0)
 			return;
-		int numSwordAnimFrames = (int)spriteSword.sprites.size();
+		int numSwordAnimFrames = spriteSword.getNumSprites();
 
 		// Choisir quel lutin (sprite) utiliser selon la trame actuelle.
-		spriteSword.bindToTextureUnit(swordAnimFrame / 2 % numSwordAnimFrames, 1);
+		spriteSword.bindToTextureUnit(1);
+		spriteLayer = swordAnimFrame / 2 % numSwordAnimFrames;
+		spritesProg.setUniform(spriteLayer);
 
 		modelSprite.loadIdentity();
 		// Positionner le point en fonction de la trame actuelle (donc mouvement vers la droite).
@@ -362,7 +350,7 @@ struct App : public OpenGLApplication
 		uniColorProg.attachSourceFile(GL_FRAGMENT_SHADER, "uniform_frag.glsl");
 		uniColorProg.link();
 
-		// Pour les deux programmes utilisant des textures (extrusions et sprites), on peut utiliser le nuanceur de fragments de base qui échantillonne simplement une texture avec des coordonnées en entrée.
+		// Le programme d'extrusion utilise le nuanceur de fragments de base qui échantillonne simplement une texture avec des coordonnées en entrée.
 		extrudeSpikesProg.attachSourceFile(GL_VERTEX_SHADER, "extrude_vert.glsl");
 		extrudeSpikesProg.attachSourceFile(GL_GEOMETRY_SHADER, "extrude_geom.glsl");
 		extrudeSpikesProg.attachSourceFile(GL_FRAGMENT_SHADER, "basic_frag.glsl");
@@ -371,7 +359,8 @@ struct App : public OpenGLApplication
 		// On peut réutiliser le nuanceur de sommets du programme d'extrusion pour avoir les positions originales passées en sortie.
 		spritesProg.attachSourceFile(GL_VERTEX_SHADER, "extrude_vert.glsl");
 		spritesProg.attachSourceFile(GL_GEOMETRY_SHADER, "sprites_geom.glsl");
-		spritesProg.attachSourceFile(GL_FRAGMENT_SHADER, "basic_frag.glsl");
+		// Les sprites sont échantillonnés dans un tableau de textures (sampler2DArray).
+		spritesProg.attachSourceFile(GL_FRAGMENT_SHADER, "sprites_frag.glsl");
 		spritesProg.link();
 	}
 };
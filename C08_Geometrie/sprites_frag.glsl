@@ -0,0 +1,18 @@
+#version 410
+
+
+uniform sampler2DArray texSprites;
+// La couche du tableau (le sprite) à afficher. Elle pourrait aussi venir d'un attribut par instance pour tracer beaucoup de sprites en un seul appel.
+uniform int spriteLayer = 0;
+
+
+in vec2 texCoords;
+
+
+out vec4 fragColor;
+
+
+void main() {
+	// Échantillonner la couche choisie du tableau de textures.
+	fragColor = texture(texSprites, vec3(texCoords, spriteLayer));
+}
@@ -124,6 +124,7 @@ struct App : public OpenGLApplication
 	void onClose() override {
 		d20.deleteObjects();
 		texBox.deleteObject();
+		getSamplers().deleteObjects();
 		for (auto prog : {&uniColorProg, &sphereProg}) {
 			prog->deleteShaders();
 			prog->deleteProgram();
@@ -247,15 +248,15 @@ struct App : public OpenGLApplication
 	}
 
 	void loadShaders() {
-		uniColorProg.attachSourceFile(GL_VERTEX_SHADER, "basic_vert.glsl");
-		uniColorProg.attachSourceFile(GL_FRAGMENT_SHADER, "uniform_frag.glsl");
+		uniColorProg.addSourceFile(GL_VERTEX_SHADER, "basic_vert.glsl");
+		uniColorProg.addSourceFile(GL_FRAGMENT_SHADER, "uniform_frag.glsl");
 		uniColorProg.link();
 
-		sphereProg.attachSourceFile(GL_VERTEX_SHADER, "sphere_vert.glsl");
-		sphereProg.attachSourceFile(GL_TESS_CONTROL_SHADER, "sphere_tessctrl.glsl");
-		sphereProg.attachSourceFile(GL_TESS_EVALUATION_SHADER, "sphere_tesseval.glsl");
-		sphereProg.attachSourceFile(GL_GEOMETRY_SHADER, "sphere_geom.glsl");
-		sphereProg.attachSourceFile(GL_FRAGMENT_SHADER, "basic_frag.glsl");
+		sphereProg.addSourceFile(GL_VERTEX_SHADER, "sphere_vert.glsl");
+		sphereProg.addSourceFile(GL_TESS_CONTROL_SHADER, "sphere_tessctrl.glsl");
+		sphereProg.addSourceFile(GL_TESS_EVALUATION_SHADER, "sphere_tesseval.glsl");
+		sphereProg.addSourceFile(GL_GEOMETRY_SHADER, "sphere_geom.glsl");
+		sphereProg.addSourceFile(GL_FRAGMENT_SHADER, "basic_frag.glsl");
 		sphereProg.link();
 	}
 };
@@ -15,9 +15,11 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <inf2705/OpenGLApplication.hpp>
+#include <inf2705/AssetLoader.hpp>
 #include <inf2705/Mesh.hpp>
 #include <inf2705/ShaderProgram.hpp>
 #include <inf2705/Texture.hpp>
+#include <inf2705/TextureCache.hpp>
 #include <inf2705/TransformStack.hpp>
 #include <inf2705/OrbitCamera.hpp>
 
@@ -28,21 +30,24 @@ using namespace glm;
 
 struct App : public OpenGLApplication
 {
-	Mesh floor;
-	Mesh teapot;
-	Mesh cube;
-	Mesh pole;
-	Mesh sphere;
-	Mesh eye;
-	Mesh quad;
-	Mesh tv;
-	Texture texSteel;
-	Texture texRust;
-	Texture texEye;
-	Texture texConcrete;
-	Texture texBox;
-	Texture texBuilding;
-	Texture texRock;
+	// Les meshes et les textures sont chargés en arrière-plan (voir init()). Tant qu'une ressource n'est pas arrivée, sa poignée donne un objet vide. Les textures sont gardées par le cache, qui les détruit dans onClose().
+	TextureCache textures;
+	AssetLoader loader;
+	MeshHandle floor;
+	MeshHandle teapot;
+	MeshHandle cube;
+	MeshHandle pole;
+	MeshHandle sphere;
+	MeshHandle eye;
+	MeshHandle quad;
+	MeshHandle tv;
+	TextureHandle texSteel;
+	TextureHandle texRust;
+	TextureHandle texEye;
+	TextureHandle texConcrete;
+	TextureHandle texBox;
+	TextureHandle texBuilding;
+	TextureHandle texRock;
 
 	Texture texRender;
 	GLuint camFrameBuffer;
@@ -59,6 +64,7 @@ struct App : public OpenGLApplication
 	float scanAngle = 0;
 	bool scanPaused = false;
 	float teapotValue = 0;
+	CullingStats cullingStats;
 
 	// Appelée avant la première trame.
 	void init() override {
@@ -71,6 +77,7 @@ struct App : public OpenGLApplication
 			"clic droit ou central : bouger la caméra en glissant la souris." "\n"
 			"roulette : rapprocher et éloigner la caméra orbitale." "\n"
 			"espace : mettre en pause le mouvement de la caméra de surveillance." "\n"
+			"I : afficher le nombre d'objets éliminés hors champ à la dernière trame." "\n"
 		);
 
 		glEnable(GL_DEPTH_TEST);
@@ -83,22 +90,26 @@ struct App : public OpenGLApplication
 		// On utilise les nuanceurs de base qui échantillonnent les textures, pas besoin de quoique ce soit de fancy.
 		loadShaders();
 
-		teapot = Mesh::loadFromWavefrontFile("teapot.obj")[0];
-		cube  = Mesh::loadFromWavefrontFile("cube.obj")[0];
-		floor = Mesh::loadFromWavefrontFile("floor.obj")[0];
-		pole = Mesh::loadFromWavefrontFile("pole.obj")[0];
-		sphere = Mesh::loadFromWavefrontFile("sphere.obj")[0];
-		eye = Mesh::loadFromWavefrontFile("eye.obj")[0];
-		quad = Mesh::loadFromWavefrontFile("quad.obj")[0];
-		tv = Mesh::loadFromWavefrontFile("tv.obj")[0];
-
-		texSteel = Texture::loadFromFile("steel.png", 8);
-		texRust = Texture::loadFromFile("rust.png", 8);
-		texEye = Texture::loadFromFile("eye.png", 8);
-		texConcrete = Texture::loadFromFile("concrete.png", 8);
-		texBuilding = Texture::loadFromFile("building.png", 8);
-		texBox = Texture::loadFromFile("box.png", 1);
-		texRock = Texture::loadFromFile("rock.png", 8);
+		// On charge les mesh en mode indexé : les sommets partagés entre les faces sont soudés et tracés avec glDrawElements. Ça réduit d'environ 3x la taille des VBO de la théière, de la sphère et de l'oeil.
+		// On passe aussi par le cache binaire (fichiers .meshcache) pour éviter de réanalyser les fichiers texte à chaque lancement.
+		// La théière, la sphère et l'oeil ont beaucoup de triangles pour leur taille à l'écran, on leur génère donc des niveaux de détail (enregistrés dans le cache avec le reste). Voir drawScene().
+		// Les fichiers sont décodés en parallèle par les fils du chargeur, puis envoyés au GPU quelques-uns à la fois au début de chaque trame (voir drawFrame()). init() retourne donc tout de suite et la scène se remplit pendant les premières trames.
+		teapot = loader.loadMesh("teapot.obj", true, 4);
+		cube  = loader.loadMesh("cube.obj", true);
+		floor = loader.loadMesh("floor.obj", true);
+		pole = loader.loadMesh("pole.obj", true);
+		sphere = loader.loadMesh("sphere.obj", true, 4);
+		eye = loader.loadMesh("eye.obj", true, 4);
+		quad = loader.loadMesh("quad.obj", true);
+		tv = loader.loadMesh("tv.obj", true);
+
+		texSteel = loader.loadTexture(textures, "steel.png", 8);
+		texRust = loader.loadTexture(textures, "rust.png", 8);
+		texEye = loader.loadTexture(textures, "eye.png", 8);
+		texConcrete = loader.loadTexture(textures, "concrete.png", 8);
+		texBuilding = loader.loadTexture(textures, "building.png", 8);
+		texBox = loader.loadTexture(textures, "box.png", 1);
+		texRock = loader.loadTexture(textures, "rock.png", 8);
 		basicProg.use();
 		basicProg.setInt("texMain", 0);
 
@@ -106,17 +117,13 @@ struct App : public OpenGLApplication
 		texRender.size = {1024, 768};
 		texRender.numLevels = 1;
 		glGenTextures(1, &texRender.id);
-		glBindTexture(GL_TEXTURE_2D, texRender.id);
 		// Créer un tampon de trame (frame buffer);
 		glGenFramebuffers(1, &camFrameBuffer);
 		glBindFramebuffer(GL_FRAMEBUFFER, camFrameBuffer);
-		// Formatter les données de la texture de rendu en RGBA (RGB aurait aussi été suffisant). Comme avec les VBO de sortie, on peut passer nullptr comme données ou passer une image de départ pour le débogage.
-		texRender.setPixelData(GL_RGBA, nullptr);
+		// Allouer le stockage de la texture de rendu en RGBA (RGB aurait aussi été suffisant). Comme avec les VBO de sortie, il n'y a pas de données de départ, on pourrait passer une image avec setPixelData pour le débogage.
+		texRender.allocateStorage(GL_RGBA8);
 		// Configurer la texture pour les filtres usuels et pas de répétition.
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		texRender.setSampling({GL_NEAREST, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE});
 		// Créer un tampon de rendu qui servira de tampon de profondeur. En effet, avec un framebuffer un z-buffer dédié doit être créé.
 		glGenRenderbuffers(1, &camZBuffer);
 		glBindRenderbuffer(GL_RENDERBUFFER, camZBuffer);
@@ -133,7 +140,13 @@ struct App : public OpenGLApplication
 
 	// Appelée à chaque trame. Le buffer swap est fait juste après.
 	void drawFrame() override {
+		// Envoyer au GPU les ressources décodées depuis la dernière trame, sans y passer plus de quelques millisecondes.
+		loader.processUploads(4);
+
 		basicProg.use();
+		// Les compteurs d'élimination hors champ et de liaisons de textures sont pour la trame (les deux caméras).
+		cullingStats = {};
+		getTextureBindings().resetCounters();
 
 		// Calculer l'angle de la caméra de surveillance selon le temps écoulé depuis la dernière trame.
 		if (not scanPaused) {
@@ -159,6 +172,7 @@ struct App : public OpenGLApplication
 		// Établir un viewport qui a les mêmes dimensions que la texture de rendu.
 		glViewport(0, 0, texRender.size.x, texRender.size.y);
 		// Positionner la caméra synthétique juste devant l'oeil. On se rappelle qu'il faut faire l'inverse des opérations quand on bouge la caméra synthétique à travers la matrice de visualisation.
+		// On garde les matrices de la caméra secondaire sur le dessus des piles pendant qu'on dessine la scène, car le choix des niveaux de détail en a besoin.
 		view.pushIdentity(); {
 			view.translate({0, 0, 1.2});
 			view.rotate(180, {0, 1, 0});
@@ -166,13 +180,13 @@ struct App : public OpenGLApplication
 			view.rotate(-scanAngle, {0, 1, 0});
 			view.translate({0, -6, 10});
 			basicProg.setMat(view);
+			// Appliquer une perpective pour la caméra secondaire encore là selon les dimensions de la texture de rendu (dans notre cas 1024x768, donc aspect 4:3).
+			projection.push(); {
+				applyPerspective(40, (float)texRender.size.x / texRender.size.y);
+				// Dessiner la scène normalement.
+				drawScene();
+			} projection.pop();
 		} view.pop();
-		// Appliquer une perpective pour la caméra secondaire encore là selon les dimensions de la texture de rendu (dans notre cas 1024x768, donc aspect 4:3).
-		projection.push(); {
-			applyPerspective(40, (float)texRender.size.x / texRender.size.y);
-		} projection.pop();
-		// Dessiner la scène normalement.
-		drawScene();
 
 		// Restaurer la caméra normale.
 		basicProg.setMat(view);
@@ -191,10 +205,11 @@ struct App : public OpenGLApplication
 
 	// Appelée lorsque la fenêtre se ferme.
 	void onClose() override {
-		for (auto mesh : {&floor, &teapot, &cube, &pole, &sphere, &eye, &quad, &tv})
+		for (auto mesh : {floor, teapot, cube, pole, sphere, eye, quad, tv})
 			mesh->deleteObjects();
-		for (auto tex : {&texSteel, &texRust, &texEye, &texConcrete, &texBox, &texBuilding, &texRock, &texRender})
-			tex->deleteObject();
+		textures.deleteObjects();
+		texRender.deleteObject();
+		getSamplers().deleteObjects();
 		glDeleteFramebuffers(1, &camFrameBuffer);
 		glDeleteRenderbuffers(1, &camZBuffer);
 		basicProg.deleteShaders();
@@ -208,6 +223,7 @@ struct App : public OpenGLApplication
 		// Les touches haut/bas change l'élévation ou la latitude de la caméra orbitale.
 		// Les touches gauche/droite change la longitude ou le roulement (avec shift) de la caméra orbitale.
 		// Espace met en pause le mouvement de la caméra de surveillance.
+		// I affiche les compteurs d'élimination hors champ et de liaisons de textures de la dernière trame.
 
 		camera.handleKeyEvent(key, 5, 0.5, {10, 15, 30, 0, {0, 2, -5}});
 		camera.updateProgram(basicProg, view);
@@ -219,6 +235,11 @@ struct App : public OpenGLApplication
 			std::cout << "Scan " << (scanPaused ? "pause" : "unpause") << "\n";
 			break;
 
+		case I:
+			std::cout << "Objets testés : " << cullingStats.numTested << ", éliminés hors champ : " << cullingStats.numCulled << "\n";
+			std::cout << "Liaisons de textures faites : " << getTextureBindings().getNumCalls() << ", évitées : " << getTextureBindings().getNumSkippedCalls() << "\n";
+			break;
+
 		case F5:
 			std::string path = saveScreenshot();
 			std::cout << "Capture d'écran dans " << path << std::endl;
@@ -254,22 +275,29 @@ struct App : public OpenGLApplication
 		model.loadIdentity();
 		basicProg.setMat(model);
 
+		// La hauteur du viewport actuel, pour le choix des niveaux de détail selon la taille des objets à l'écran.
+		GLint viewport[4] = {};
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		float viewportHeight = (float)viewport[3];
+		// Le volume de vue de la caméra actuelle. Chaque objet est tracé seulement si sa boîte englobante y touche, ce qui évite de tracer la moitié de la scène avec la caméra de surveillance.
+		Frustum frustum = Frustum::fromMatrices(projection, view);
+
 		// Le plancher en ciment.
 		model.push(); {
 			model.translate({0, 0, -0.5});
 			basicProg.setMat(model);
+			texConcrete->bindToTextureUnit(0);
+			floor->drawIfVisible(frustum, model, &cullingStats);
 		} model.pop();
-		texConcrete.bindToTextureUnit(0);
-		floor.draw();
 
 		// Le cube qui ressemble à un bâtiment.
 		model.push(); {
 			model.translate({-5, 1.45, 5});
 			model.scale({1, 1.5, 1});
 			basicProg.setMat(model);
+			texBuilding->bindToTextureUnit(0);
+			cube->drawIfVisible(frustum, model, &cullingStats);
 		} model.pop();
-		texBuilding.bindToTextureUnit(0);
-		cube.draw();
 
 		// La grosse boîte de carton.
 		model.push(); {
@@ -277,9 +305,9 @@ struct App : public OpenGLApplication
 			model.rotate(180, {0, 1, 0});
 			model.scale({1.5, 1.5, 1.5});
 			basicProg.setMat(model);
+			texBox->bindToTextureUnit(0);
+			cube->drawIfVisible(frustum, model, &cullingStats);
 		} model.pop();
-		texBox.bindToTextureUnit(0);
-		cube.draw();
 
 		// Le pole de rotation de la théière.
 		model.push(); {
@@ -287,9 +315,9 @@ struct App : public OpenGLApplication
 			model.rotate(90, {1, 0, 0});
 			model.scale({0.5, 0.2, 0.5});
 			basicProg.setMat(model);
+			texRust->bindToTextureUnit(0);
+			pole->drawIfVisible(frustum, model, &cullingStats);
 		} model.pop();
-		texRust.bindToTextureUnit(0);
-		pole.draw();
 
 		// La théière qui bouge.
 		model.push(); {
@@ -299,26 +327,31 @@ struct App : public OpenGLApplication
 			model.rotate(angle, {1, 0, 0});
 			model.translate({0, -0.3, 1.5});
 			basicProg.setMat(model);
+			// Le niveau de détail est choisi selon la taille de la théière à l'écran, donc pendant qu'on a sa matrice de modélisation. On ne le fait pas si elle est hors champ.
+			if (teapot->isVisible(frustum, model, &cullingStats)) {
+				texRock->bindToTextureUnit(0);
+				teapot->drawLod(view * model, projection, viewportHeight);
+			}
 		} model.pop();
-		texRock.bindToTextureUnit(0);
-		teapot.draw();
 
 		// Le poteau au bout duquel se trouve l'oeil observateur.
 		model.push(); {
 			model.translate({0, 0, -10});
 			model.scale({0.75, 1, 0.75});
 			basicProg.setMat(model);
+			texRust->bindToTextureUnit(0);
+			pole->drawIfVisible(frustum, model, &cullingStats);
 		} model.pop();
-		texRust.bindToTextureUnit(0);
-		pole.draw();
 
 		// La sphère autour de laquelle l'oeil tourne.
 		model.push(); {
 			model.translate({0, 6, -10});
 			basicProg.setMat(model);
+			if (sphere->isVisible(frustum, model, &cullingStats)) {
+				texRust->bindToTextureUnit(0);
+				sphere->drawLod(view * model, projection, viewportHeight);
+			}
 		} model.pop();
-		texRust.bindToTextureUnit(0);
-		sphere.draw();
 
 		// L'oeil observateur. On applique l'angle qui change dans le temps.
 		model.push(); {
@@ -326,9 +359,11 @@ struct App : public OpenGLApplication
 			model.rotate(scanAngle, {0, 1, 0});
 			model.rotate(20, {1, 0, 0});
 			basicProg.setMat(model);
+			if (eye->isVisible(frustum, model, &cullingStats)) {
+				texEye->bindToTextureUnit(0);
+				eye->drawLod(view * model, projection, viewportHeight);
+			}
 		} model.pop();
-		texEye.bindToTextureUnit(0);
-		eye.draw();
 
 		// La TV et l'écran (le quad texturé à l'intérieur de la TV). Ils ont le même positionnement et mise à l'échelle, donc même matrice de modélisation.
 		model.push(); {
@@ -336,12 +371,12 @@ struct App : public OpenGLApplication
 			model.scale({(float)texRender.size.x / texRender.size.y, 1, 1});
 			model.scale({2, 2, 1});
 			basicProg.setMat(model);
+			texSteel->bindToTextureUnit(0);
+			tv->drawIfVisible(frustum, model, &cullingStats);
+			// Ici on utilise la texture de rendu comme texture de l'objet. C'est tout ça le but d'utiliser une texture comme sortie du framebuffer, pas besoin de lire vers le CPU pour ensuite renvoyer sur le GPU; tout reste dans la mémoire graphique.
+			texRender.bindToTextureUnit(0);
+			quad->drawIfVisible(frustum, model, &cullingStats);
 		} model.pop();
-		texSteel.bindToTextureUnit(0);
-		tv.draw();
-		// Ici on utilise la texture de rendu comme texture de l'objet. C'est tout ça le but d'utiliser une texture comme sortie du framebuffer, pas besoin de lire vers le CPU pour ensuite renvoyer sur le GPU; tout reste dans la mémoire graphique.
-		texRender.bindToTextureUnit(0);
-		quad.draw();
 	}
 
 	void applyPerspective(float fovy, float aspect) {
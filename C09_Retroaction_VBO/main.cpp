@@ -35,16 +35,22 @@ struct Particle
 	vec3 velocity; // Vecteur de vitesse (donc direction de la particule).
 	float mass; // Masse (affecte l'accélération et taille de la particule).
 	float miscValue; // Une valeur quelconque. On peut mettre ce qu'on veut dans nos données.
+};
 
-	// Configurer les attributs dans un VBO.
-	static void setupAttribs() {
-		SET_VEC_VERTEX_ATTRIB_FROM_STRUCT_MEM(0, Particle, position);
-		SET_VEC_VERTEX_ATTRIB_FROM_STRUCT_MEM(1, Particle, velocity);
-		SET_SCALAR_VERTEX_ATTRIB_FROM_STRUCT_MEM(2, Particle, mass);
-		SET_SCALAR_VERTEX_ATTRIB_FROM_STRUCT_MEM(3, Particle, miscValue);
-	}
+// La description des membres de Particle, utilisée autant pour les attributs de sommets que pour les variables de sortie de la rétroaction.
+template <>
+struct VertexAttribList<Particle>
+{
+	static constexpr std::array attribs = {
+		VERTEX_ATTRIB(0, Particle, position),
+		VERTEX_ATTRIB(1, Particle, velocity),
+		VERTEX_ATTRIB(2, Particle, mass),
+		VERTEX_ATTRIB(3, Particle, miscValue),
+	};
 };
 
+using ParticleFormat = VertexFormat<Particle>;
+
 struct App : public OpenGLApplication
 {
 	const size_t numParticles = 1'000'000;
@@ -131,23 +137,17 @@ struct App : public OpenGLApplication
 		glBindBuffer(GL_ARRAY_BUFFER, vboOut);
 		glBufferData(GL_ARRAY_BUFFER, numBytes, nullptr, GL_DYNAMIC_COPY);
 
-		// Lier le TFO au VAO de calcul (pas besoin pour le VAO d'affichage).
+		// Configurer le format des attributs des deux VAO une seule fois. Le VBO source change à chaque trame (on alterne vboIn et vboOut), mais avec la séparation du format et du tampon (OpenGL 4.3), il suffit alors de lier l'autre tampon avec ParticleFormat::bindVertexBuffer().
+		glBindVertexArray(vaoDrawing);
+		ParticleFormat::setupAttribFormats();
 		glBindVertexArray(vaoComputation);
+		ParticleFormat::setupAttribFormats();
+
+		// Lier le TFO au VAO de calcul (pas besoin pour le VAO d'affichage).
 		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, tfoComputation);
 
-		// Configurer les variables de sortie de la rétroaction. Il faut passer les noms dans l'ordre dans lequel ils seront écrits dans le tampon de sortie. Dans notre cas, on met le même ordre que dans la struct `Particle`. On veut que la sortie des calculs ait le même format que les données en entrée.
-		const char* variableNames[] = {
-			"position",
-			"velocity",
-			"mass",
-			"miscValue",
-		};
-		glTransformFeedbackVaryings(
-			computationProg.getObject(),
-			(GLsizei)std::size(variableNames),
-			variableNames,
-			GL_INTERLEAVED_ATTRIBS
-		);
+		// Configurer les variables de sortie de la rétroaction. Il faut passer les noms dans l'ordre dans lequel ils seront écrits dans le tampon de sortie. Dans notre cas, ParticleFormat donne le même ordre que dans la struct `Particle` (les noms des membres). On veut que la sortie des calculs ait le même format que les données en entrée.
+		ParticleFormat::setTransformFeedbackVaryings(computationProg.getObject());
 		// glTransformFeedbackVaryings doit être appelée AVANT l'édition de lien du programme de nuanceurs.
 		computationProg.link();
 
@@ -161,10 +161,7 @@ struct App : public OpenGLApplication
 		// La texture utilisée pour le sprite des particules.
 		particleSprite = Texture::loadFromFile("particle_sprite.png");
 		// Pas de filtres, c'est une texture qui doit être pixelisée.
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		particleSprite.setSampling({GL_NEAREST, GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE});
 		drawingProg.setInt("texMain", 0);
 
 		applyOrtho();
@@ -207,6 +204,7 @@ struct App : public OpenGLApplication
 		glDeleteQueries(1, &reqParticles);
 		glDeleteTransformFeedbacks(1, &tfoComputation);
 		particleSprite.deleteObject();
+		getSamplers().deleteObjects();
 		computationProg.deleteShaders();
 		computationProg.deleteProgram();
 		drawingProg.deleteShaders();
@@ -326,9 +324,8 @@ struct App : public OpenGLApplication
 		computationProg.setUniform(forceFieldPosition);
 
 		glBindVertexArray(vaoComputation);
-		// Configurer le VBO d'entrée pour les données de sommets. Il faut répéter les configurations d'attributs quand on bind un différent VBO.
-		glBindBuffer(GL_ARRAY_BUFFER, vboIn);
-		Particle::setupAttribs();
+		// Lier le VBO d'entrée pour les données de sommets. Le format des attributs est déjà dans le VAO, seul le tampon change (sans OpenGL 4.3, bindVertexBuffer() répète les configurations d'attributs, comme il faut le faire avec glVertexAttribPointer quand on change de VBO).
+		ParticleFormat::bindVertexBuffer(vboIn);
 		// Configurer le VBO de sortie pour contenir les résultats de calculs.
 		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vboOut);
 
@@ -349,11 +346,10 @@ struct App : public OpenGLApplication
 	void drawParticles() {
 		drawingProg.use();
 
-		// Rien de très spécial ici, on fait le bind et les configs d'attributs puis on dessine. Le nuanceur de géométrie s'occupe de générer les sommets en temps réel selon les propriétés physiques des particules.
+		// Rien de très spécial ici, on fait le bind du VAO et du VBO puis on dessine. Le nuanceur de géométrie s'occupe de générer les sommets en temps réel selon les propriétés physiques des particules.
 		particleSprite.bindToTextureUnit(0);
 		glBindVertexArray(vaoDrawing);
-		glBindBuffer(GL_ARRAY_BUFFER, vboIn);
-		Particle::setupAttribs();
+		ParticleFormat::bindVertexBuffer(vboIn);
 		glDrawArrays(GL_POINTS, 0, (GLsizei)particles.size());
 	}
 
@@ -1,5 +1,6 @@
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 #include <array>
 #include <cmath>
@@ -33,7 +34,8 @@ struct App : public OpenGLApplication
 	Mesh gridPoints;
 	Mesh referenceLines;
 	bool activeFrags[gridSize][gridSize] = {};
-	GLuint activeFragsVbo = 0;
+	// Les fragments actifs changent à chaque trame, ils sont donc envoyés dans un tampon en anneau (voir drawFragments).
+	StreamingRingBuffer activeFragsBuffer;
 
 	ShaderProgram globalColorProg;
 	ShaderProgram quadGenProg;
@@ -73,7 +75,8 @@ struct App : public OpenGLApplication
 
 		loadShaders();
 
-		referenceLines.setup();
+		// Les lignes de référence sont recalculées à chaque trame, donc on les envoie dans un tampon en anneau plutôt que de réallouer un VBO à chaque fois. Le tampon grandit au besoin.
+		referenceLines.setupStreaming(2048);
 
 		for (int i = 0; i <= gridSize; i++) {
 			gridLines.vertices.push_back({{i, 0, 0}});
@@ -89,11 +92,10 @@ struct App : public OpenGLApplication
 		gridPoints.setup();
 
 		gridPoints.bindVao();
-		glGenBuffers(1, &activeFragsVbo);
-		glBindBuffer(GL_ARRAY_BUFFER, activeFragsVbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(activeFrags), activeFrags, GL_DYNAMIC_DRAW);
+		activeFragsBuffer.create(GL_ARRAY_BUFFER, sizeof(activeFrags));
 		glVertexAttribPointer(3, 1, GL_UNSIGNED_BYTE, GL_FALSE, 1, 0);
 		glEnableVertexAttribArray(3);
+		gridPoints.unbindVao();
 
 		applyOrtho();
 	}
@@ -162,8 +164,7 @@ struct App : public OpenGLApplication
 	void onClose() override {
 		gridLines.deleteObjects();
 		gridPoints.deleteObjects();
-		glDeleteBuffers(1, &activeFragsVbo);
-		activeFragsVbo = 0;
+		activeFragsBuffer.deleteObjects();
 		referenceLines.deleteObjects();
 		globalColorProg.deleteShaders();
 		globalColorProg.deleteProgram();
@@ -335,9 +336,12 @@ struct App : public OpenGLApplication
 
 	void drawFragments() {
 		quadGenProg.use();
+		// On écrit dans une région que le GPU ne lit plus, puis on fait pointer l'attribut sur cette région.
+		std::memcpy(activeFragsBuffer.beginWrite(), activeFrags, sizeof(activeFrags));
+		activeFragsBuffer.endWrite(sizeof(activeFrags));
 		gridPoints.bindVao();
-		glBindBuffer(GL_ARRAY_BUFFER, activeFragsVbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(activeFrags), activeFrags, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, activeFragsBuffer.getBuffer());
+		glVertexAttribPointer(3, 1, GL_UNSIGNED_BYTE, GL_FALSE, 1, (const void*)activeFragsBuffer.getRegionOffset());
 		gridPoints.draw(GL_POINTS);
 	}
 
@@ -347,7 +351,7 @@ struct App : public OpenGLApplication
 		glEnable(GL_LINE_SMOOTH);
 		glLineWidth(5);
 
-		referenceLines.updateBuffers();
+		referenceLines.streamVertices();
 		globalColorProg.use();
 		globalColor = lineColor;
 		globalColorProg.setUniform(globalColor);
@@ -375,6 +379,8 @@ struct App : public OpenGLApplication
 		globalColor = vec4(0, 0, 0, 0.5);
 		globalColorProg.setUniform(globalColor);
 		gridPoints.draw(GL_POINTS);
+		// Ce tracé utilise le même VAO, qui pointe encore sur la région des fragments actifs.
+		activeFragsBuffer.fenceCurrentRegion();
 	}
 
 	void applyOrtho() {
@@ -0,0 +1,16 @@
+#version 410
+
+
+in vec2 texCoords;
+flat in vec4 instanceColor;
+
+uniform sampler2D texMain;
+// En mode sélection, on applique la couleur qui encode l'ID de l'instance (comme selection_frag.glsl) plutôt que la texture.
+uniform bool selecting = false;
+
+out vec4 fragColor;
+
+
+void main() {
+	fragColor = selecting ? instanceColor : texture(texMain, texCoords);
+}
@@ -0,0 +1,23 @@
+#version 410
+
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+layout(location = 2) in vec2 a_texCoords;
+// Les attributs d'instance (voir InstanceData dans Mesh.hpp). Ils changent d'une instance à l'autre plutôt que d'un sommet à l'autre. La matrice prend les localisations 4 à 7.
+layout(location = 4) in mat4 a_instanceModel;
+layout(location = 8) in vec4 a_instanceColor;
+
+uniform mat4 view = mat4(1);
+uniform mat4 projection = mat4(1);
+
+out vec2 texCoords;
+flat out vec4 instanceColor;
+
+
+void main() {
+	// Comme basic_vert.glsl, mais la matrice de modélisation vient de l'instance plutôt que d'une variable uniforme.
+	gl_Position = projection * view * a_instanceModel * vec4(a_position, 1.0);
+	texCoords = a_texCoords;
+	instanceColor = a_instanceColor;
+}
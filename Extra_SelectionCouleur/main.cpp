@@ -72,7 +72,8 @@ struct App : public OpenGLApplication
 	ShaderProgram basicProg;
 	ShaderProgram selectionProg;
 	ShaderProgram flashingProg;
-	ShaderProgram* programs[3] = {&basicProg, &selectionProg, &flashingProg};
+	ShaderProgram instancedProg;
+	ShaderProgram* programs[4] = {&basicProg, &selectionProg, &flashingProg, &instancedProg};
 
 	TransformStack model = {"model"};
 	TransformStack view = {"view"};
@@ -82,6 +83,7 @@ struct App : public OpenGLApplication
 
 	sf::Event::MouseButtonEvent lastMouseBtnEvent = {};
 	bool selecting = false;
+	bool colorSelection = false; // Sélection par couleur (relecture du tampon de couleur) plutôt que par lancer de rayon sur le CPU.
 	unsigned selectedObjectID = 0;
 	float flashingValue = 0;
 
@@ -98,6 +100,7 @@ struct App : public OpenGLApplication
 			"WASD : contrôler la théière sélectionnée." "\n"
 			"clic gauche : sélectionner l'objet sous le curseur (théières seulement)." "\n"
 			"espace : annuler la sélection." "\n"
+			"C : alterner entre la sélection par lancer de rayon et la sélection par couleur." "\n"
 		);
 
 		glEnable(GL_DEPTH_TEST);
@@ -112,12 +115,16 @@ struct App : public OpenGLApplication
 		// Affecter une couleur qui va faire clignoter l'objet sélectionné.
 		flashingProg.use();
 		flashingProg.setVec("flashingColor", vec4{1, 0.2f, 0.2f, 1});
+		instancedProg.use();
+		instancedProg.setTextureUnit("texMain", 0);
 
 		meshBoard = Mesh::loadFromWavefrontFile("cube_board.obj")[0];
 		meshTeapot = Mesh::loadFromWavefrontFile("teapot.obj")[0];
+		// Les BVH servent à la sélection par lancer de rayon.
+		meshBoard.buildBvh();
+		meshTeapot.buildBvh();
 		texCheckers = Texture::loadFromFile("checkers_board.png", 4);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		texCheckers.setSampling({.wrapS = GL_CLAMP_TO_EDGE, .wrapT = GL_CLAMP_TO_EDGE});
 		texRock = Texture::loadFromFile("rock.png", 4);
 		texRockDark = Texture::loadFromFile("rock_dark.png", 4);
 
@@ -158,12 +165,7 @@ struct App : public OpenGLApplication
 			unsigned clickedObj = getObjectIDUnderMouse(lastMouseBtnEvent);
 			if (clickedObj != 0)
 				std::cout << std::format("Sélection de l'objet 0x{:04X}", clickedObj) << "\n";
-			// Chercher dans le dictionnaire de théières (pieces) si le ID est reconnu. On choisit de ne pas pouvoir sélectionner la planche.
-			if (clickedObj != selectedObjectID and pieces.contains(clickedObj)) {
-				// Sélectionner l'objet et réinitialiser l'animation de clignotement.
-				selectedObjectID = clickedObj;
-				flashingValue = 0;
-			}
+			selectObject(clickedObj);
 
 			// Rétablir la configuration régulière.
 			selecting = false;
@@ -190,6 +192,7 @@ struct App : public OpenGLApplication
 		texRock.deleteObject();
 		texRockDark.deleteObject();
 		texCheckers.deleteObject();
+		getSamplers().deleteObjects();
 		for (auto prog : programs) {
 			prog->deleteShaders();
 			prog->deleteProgram();
@@ -215,6 +218,10 @@ struct App : public OpenGLApplication
 			selectedObjectID = 0;
 			selecting = false;
 			break;
+		case C:
+			colorSelection ^= 1;
+			std::cout << "Sélection " << (colorSelection ? "par couleur" : "par lancer de rayon") << "\n";
+			break;
 		case A:
 			pieceTranslate = {1, 0, 0};
 			break;
@@ -252,9 +259,14 @@ struct App : public OpenGLApplication
 		switch (mouseBtn.button) {
 		// Clic gauche sélectionne l'objet sous la souris.
 		case sf::Mouse::Left:
-			// Enregistrer l'évènement de souris et se mettre en mode de sélection.
-			lastMouseBtnEvent = mouseBtn;
-			selecting = true;
+			if (colorSelection) {
+				// Enregistrer l'évènement de souris et se mettre en mode de sélection. La sélection se fera à la prochaine trame.
+				lastMouseBtnEvent = mouseBtn;
+				selecting = true;
+			} else {
+				// Le lancer de rayon se fait tout de suite sur le CPU, sans toucher au GPU.
+				selectObject(getObjectIDWithRay(mouseBtn));
+			}
 			break;
 		}
 	}
@@ -284,6 +296,10 @@ struct App : public OpenGLApplication
 	void drawScene() {
 		// Pour chaque objet dans la scène. On fait du beau C++17 avec de l'affectation structurée pour itérer sur un hash map (INF1015 to the MOON!).
 		for (auto&& [objectID, obj] : objects) {
+			// Les pièces sont tracées ensemble par drawPiecesInstanced(), sauf celle qui clignote.
+			if (pieces.contains(objectID) and (selecting or objectID != selectedObjectID))
+				continue;
+
 			// Choisir le programme nuanceur à utiliser (texturé, sélection, ou animation sélectionnée).
 			ShaderProgram* prog = &basicProg;
 			if (selecting)
@@ -303,6 +319,34 @@ struct App : public OpenGLApplication
 			obj.draw(*prog);
 			obj.modelMat.pop();
 		}
+
+		drawPiecesInstanced();
+	}
+
+	// Les 24 pièces partagent le même mesh. Plutôt qu'un changement de programme, des variables uniformes et un tracé par pièce, on met leurs matrices et leurs couleurs de sélection dans le tampon d'instances du mesh et on les trace en deux appels (un par texture).
+	void drawPiecesInstanced() {
+		auto& instances = meshTeapot.instances;
+		instances.clear();
+		size_t numLightPieces = 0;
+		for (GLuint dark = 0; dark < 2; dark++) {
+			for (auto&& [id, piece] : pieces) {
+				bool isDark = id >= 0xF000;
+				if (isDark != (dark == 1) or (not selecting and id == selectedObjectID))
+					continue;
+				instances.push_back({model * piece->modelMat, uintToVec4(id), id, dark});
+			}
+			if (dark == 0)
+				numLightPieces = instances.size();
+		}
+		// Appelé à chaque passe (sélection et affichage), avec des instances différentes. Le tampon est rendu orphelin à chaque envoi, donc la passe suivante n'attend pas la fin des tracés de la précédente.
+		meshTeapot.updateInstances();
+
+		instancedProg.use();
+		instancedProg.setBool("selecting", selecting);
+		texRock.bindToTextureUnit(0);
+		meshTeapot.drawInstanced(GL_TRIANGLES, 0, numLightPieces);
+		texRockDark.bindToTextureUnit(0);
+		meshTeapot.drawInstanced(GL_TRIANGLES, numLightPieces);
 	}
 
 	void loadScene() {
@@ -348,6 +392,43 @@ struct App : public OpenGLApplication
 		board->modelMat.scale({4, 0.12f, 4});
 	}
 
+	// Sélectionner un objet par son ID, si c'est une pièce.
+	void selectObject(unsigned clickedObj) {
+		// Chercher dans le dictionnaire de théières (pieces) si le ID est reconnu. On choisit de ne pas pouvoir sélectionner la planche.
+		if (clickedObj != selectedObjectID and pieces.contains(clickedObj)) {
+			// Sélectionner l'objet et réinitialiser l'animation de clignotement.
+			selectedObjectID = clickedObj;
+			flashingValue = 0;
+		}
+	}
+
+	// Sélection par lancer de rayon. Plutôt que de redessiner la scène et d'attendre le GPU pour relire un pixel (ce qui bloque le pipeline pendant une trame), on lance un rayon à partir de la caméra à travers le pixel cliqué et on cherche le triangle le plus proche qu'il touche dans la BVH de chaque objet. Tout se fait sur le CPU en quelques microsecondes.
+	unsigned getObjectIDWithRay(const sf::Event::MouseButtonEvent& mouseBtn) {
+		struct { GLint x, y, width, height; } viewport = {};
+		glGetIntegerv(GL_VIEWPORT, (GLint*)&viewport);
+		// Convertir les coordonnées de souris en coordonnées normalisées [-1,1] avec les y vers le haut, comme dans MouseState::normalized.
+		vec2 mousePosition = {
+			 (2.0f * mouseBtn.x - (viewport.width - 1)) / (viewport.width - 1),
+			-(2.0f * mouseBtn.y - (viewport.height - 1)) / (viewport.height - 1)
+		};
+		Ray ray = makeRayFromScreen(mousePosition, projection, view);
+
+		// Le même RayHit est passé à tous les objets : chacun ne le remplace que s'il est touché plus près.
+		RayHit hit;
+		unsigned objectID = 0;
+		for (auto&& [id, obj] : objects) {
+			if (obj.mesh->raycast(ray, model * obj.modelMat, hit))
+				objectID = id;
+		}
+		if (objectID != 0) {
+			std::cout << std::format(
+				"Sélection de l'objet 0x{:04X} (triangle {}, distance {:.3f}, barycentriques {:.2f} {:.2f} {:.2f})",
+				objectID, hit.triangle, hit.distance, hit.barycentrics.x, hit.barycentrics.y, hit.barycentrics.z
+			) << "\n";
+		}
+		return objectID;
+	}
+
 	unsigned getObjectIDUnderMouse(const sf::Event::MouseButtonEvent& mouseBtn) {
 		// Du bon vieux C où on crée une structure anonyme plutôt qu'un tableau bête.
 		struct { GLint x, y, width, height; } viewport = {};
@@ -376,17 +457,19 @@ struct App : public OpenGLApplication
 		flashingProg.attachSourceFile(GL_VERTEX_SHADER, "basic_vert.glsl");
 		flashingProg.attachSourceFile(GL_FRAGMENT_SHADER, "flashing_frag.glsl");
 		flashingProg.link();
+		instancedProg.create();
+		instancedProg.attachSourceFile(GL_VERTEX_SHADER, "instanced_vert.glsl");
+		instancedProg.attachSourceFile(GL_FRAGMENT_SHADER, "instanced_frag.glsl");
+		instancedProg.link();
 	}
 
 	void applyPerspective(float fovy = 50) {
-		projection.pushIdentity();
-		// Appliquer la perspective avec un champs de vision (FOV) vertical donné et avec un aspect correspondant à celui de la fenêtre.
+		// Appliquer la perspective avec un champs de vision (FOV) vertical donné et avec un aspect correspondant à celui de la fenêtre. On la garde sur le dessus de la pile, car la sélection par lancer de rayon en a besoin.
 		projection.perspective(fovy, getWindowAspect(), 0.01f, 100.0f);
 		for (auto&& prog : programs) {
 			prog->use();
 			prog->setMat("projection", projection);
 		}
-		projection.pop();
 	}
 };
 
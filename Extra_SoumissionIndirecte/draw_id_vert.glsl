@@ -0,0 +1,38 @@
+#version 430
+// gl_DrawIDARB est le gl_DrawID de GLSL 4.60. Les pilotes 4.6 ont aussi l'extension, ce qui permet le même nuanceur avec OpenGL 4.3 à 4.5.
+#extension GL_ARB_shader_draw_parameters : require
+
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+layout(location = 2) in vec2 a_texCoords;
+
+// Les données de chaque objet (voir DrawData dans IndirectDraw.hpp).
+struct DrawData
+{
+	mat4 model;
+	uint textureLayer;
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer
+{
+	DrawData drawData[];
+};
+
+uniform mat4 view = mat4(1);
+uniform mat4 projection = mat4(1);
+// Le premier objet du tracé dans le SSBO. Avec glMultiDrawElementsIndirect, chaque commande a son propre gl_DrawIDARB et drawOffset reste à 0. Avec un tracé instancié, gl_DrawIDARB vaut 0 et c'est gl_InstanceID qui avance.
+uniform uint drawOffset = 0;
+
+out vec2 texCoords;
+out float shade;
+flat out uint layer;
+
+
+void main() {
+	DrawData data = drawData[drawOffset + gl_DrawIDARB + gl_InstanceID];
+	gl_Position = projection * view * data.model * vec4(a_position, 1.0);
+	texCoords = a_texCoords;
+	shade = 0.5 + 0.5 * max(normalize(mat3(data.model) * a_normal).y, 0.0);
+	layer = data.textureLayer;
+}
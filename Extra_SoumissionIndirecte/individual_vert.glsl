@@ -0,0 +1,24 @@
+#version 410
+
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+layout(location = 2) in vec2 a_texCoords;
+
+uniform mat4 model = mat4(1);
+uniform mat4 view = mat4(1);
+uniform mat4 projection = mat4(1);
+uniform uint textureLayer = 0;
+
+out vec2 texCoords;
+out float shade;
+flat out uint layer;
+
+
+void main() {
+	// Soumission individuelle : la matrice de modélisation et la couche de texture sont des variables uniformes changées avant chaque tracé.
+	gl_Position = projection * view * model * vec4(a_position, 1.0);
+	texCoords = a_texCoords;
+	shade = 0.5 + 0.5 * max(normalize(mat3(model) * a_normal).y, 0.0);
+	layer = textureLayer;
+}
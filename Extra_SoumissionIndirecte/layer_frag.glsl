@@ -0,0 +1,16 @@
+#version 410
+
+
+in vec2 texCoords;
+in float shade;
+flat in uint layer;
+
+uniform sampler2DArray texLayers;
+
+out vec4 fragColor;
+
+
+void main() {
+	// La couche du tableau de textures est choisie par objet.
+	fragColor = vec4(texture(texLayers, vec3(texCoords, layer)).rgb * shade, 1.0);
+}
@@ -0,0 +1,433 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <inf2705/OpenGLApplication.hpp>
+#include <inf2705/Culling.hpp>
+#include <inf2705/IndirectDraw.hpp>
+#include <inf2705/Mesh.hpp>
+#include <inf2705/MeshPool.hpp>
+#include <inf2705/ShaderProgram.hpp>
+#include <inf2705/TransformStack.hpp>
+#include <inf2705/OrbitCamera.hpp>
+
+
+using namespace gl;
+using namespace glm;
+
+
+enum class SubmissionMode
+{
+	Individual,
+	Instanced,
+	MultiDrawIndirect,
+};
+
+struct App : public OpenGLApplication
+{
+	static constexpr int gridSize = 100; // 100 x 100 = 10 000 objets.
+	static constexpr int numTextureLayers = 4;
+
+	// Les objets de la scène. Ils sont regroupés par mesh (tous les cubes, puis toutes les sphères) pour que les tracés instanciés puissent prendre une plage contiguë du SSBO.
+	struct Object
+	{
+		const PooledMesh* mesh;
+		vec3 position;
+		float phase;
+		GLuint textureLayer;
+	};
+
+	MeshPool meshPool;
+	PooledMesh cube;
+	PooledMesh sphere;
+	std::vector<Object> objects;
+	IndirectDrawBatch batch;
+	GLuint texLayers = 0;
+
+	// Les boîtes englobantes des objets, recalculées à chaque trame, et le résultat de leur test contre le volume de vue. Seuls les objets visibles sont soumis, peu importe le mode.
+	BoundingBoxBatch worldBoxes;
+	std::vector<uint8_t> isObjectVisible;
+	CullingStats cullingStats;
+	bool isCulling = true;
+
+	ShaderProgram individualProg;
+	ShaderProgram drawIdProg;
+
+	TransformStack view = {"view"};
+	TransformStack projection = {"projection"};
+
+	OrbitCamera camera = {150, 40, 30, 0, {0, 0, 0}};
+	SubmissionMode mode = SubmissionMode::Individual;
+	bool isMultiDrawSupported = false;
+	bool isAnimating = true;
+	float animationTime = 0;
+
+	// Mesures de performance, moyennées sur environ une seconde.
+	static constexpr int numTimerQueries = 3;
+	GLuint timerQueries[numTimerQueries] = {};
+	int numMeasuredFrames = 0;
+	int numGpuMeasuredFrames = 0;
+	double totalCpuTime = 0;
+	double totalGpuTime = 0;
+	float timeSinceReport = 0;
+
+	// Appelée avant la première trame.
+	void init() override {
+		setKeybindMessage(
+			"F5 : capture d'écran." "\n"
+			"R : réinitialiser la position de la caméra." "\n"
+			"+ et - :  rapprocher et éloigner la caméra orbitale." "\n"
+			"haut/bas : changer la latitude de la caméra orbitale." "\n"
+			"gauche/droite : changer la longitude ou le roulement (avec shift) de la caméra orbitale." "\n"
+			"clic droit ou central : bouger la caméra en glissant la souris." "\n"
+			"roulette : rapprocher et éloigner la caméra orbitale." "\n"
+			"1 : soumission individuelle (un glDrawElementsBaseVertex par objet)." "\n"
+			"2 : soumission instanciée (un tracé instancié par mesh)." "\n"
+			"3 : soumission indirecte (un seul glMultiDrawElementsIndirect)." "\n"
+			"C : activer/désactiver l'élimination hors champ." "\n"
+			"espace : arrêter/repartir l'animation." "\n"
+		);
+
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
+		glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+
+		isMultiDrawSupported = isMultiDrawIndirectSupported();
+		if (not isMultiDrawSupported)
+			std::cout << "OpenGL 4.6 (ou 4.3 avec ARB_shader_draw_parameters) n'est pas disponible, seule la soumission individuelle est possible." << std::endl;
+
+		loadShaders();
+
+		meshPool.create(4096, 8192, GL_UNSIGNED_SHORT);
+		cube = meshPool.add(Mesh::loadFromWavefrontFile("cube.obj", false, true)[0]);
+		sphere = meshPool.add(Mesh::loadFromWavefrontFile("sphere.obj", false, true)[0]);
+
+		for (auto mesh : {&cube, &sphere}) {
+			for (int x = 0; x < gridSize; x++) {
+				for (int z = 0; z < gridSize; z++) {
+					if (((x + z) % 2 == 0) != (mesh == &cube))
+						continue;
+					vec3 position = {(x - gridSize / 2) * 2.5f, 0, (z - gridSize / 2) * 2.5f};
+					objects.push_back({mesh, position, (x * 7 + z * 13) % 100 / 100.0f, GLuint((x + 3 * z) % numTextureLayers)});
+				}
+			}
+		}
+
+		if (isMultiDrawSupported)
+			batch.create(0);
+		texLayers = createLayerTexture();
+		glGenQueries(numTimerQueries, timerQueries);
+
+		for (auto prog : {&individualProg, &drawIdProg}) {
+			if (prog->getObject() == 0)
+				continue;
+			prog->use();
+			prog->setTextureUnit("texLayers", 0);
+			camera.updateProgram(*prog, view);
+		}
+		applyPerspective();
+	}
+
+	// Appelée à chaque trame. Le buffer swap est fait juste après.
+	void drawFrame() override {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		if (isAnimating)
+			animationTime += getFrameDeltaTime();
+
+		// Lire le temps GPU d'il y a trois trames avant de réutiliser sa requête (on alterne entre trois requêtes pour ne pas attendre après le GPU). Si le GPU est encore plus en retard, le résultat n'est pas disponible : on perd cette mesure plutôt que d'attendre.
+		int frame = getCurrentFrameNumber();
+		GLuint query = timerQueries[frame % numTimerQueries];
+		if (frame >= numTimerQueries) {
+			GLuint isAvailable = 0;
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+			if (isAvailable != 0) {
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+				totalGpuTime += elapsed * 1e-6;
+				numGpuMeasuredFrames++;
+			}
+		}
+
+		// Les matrices de modélisation et l'élimination hors champ sont faites de la même façon pour tous les modes, et ne sont pas incluses dans la mesure.
+		std::vector<mat4> models(objects.size());
+		for (size_t i = 0; i < objects.size(); i++) {
+			auto& object = objects[i];
+			float height = std::sin((animationTime + object.phase * 4) * 2) * 0.5f;
+			models[i] = translate(mat4(1), object.position + vec3(0, height, 0));
+			models[i] = rotate(models[i], radians(animationTime * 45 + object.phase * 360), vec3(0, 1, 0));
+		}
+		cullObjects(models);
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texLayers);
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		auto cpuStart = std::chrono::high_resolution_clock::now();
+
+		switch (mode) {
+		case SubmissionMode::Individual:
+			drawIndividual(models);
+			break;
+		case SubmissionMode::Instanced:
+			drawInstanced(models);
+			break;
+		case SubmissionMode::MultiDrawIndirect:
+			drawMultiDrawIndirect(models);
+			break;
+		}
+
+		std::chrono::duration<double, std::milli> cpuTime = std::chrono::high_resolution_clock::now() - cpuStart;
+		glEndQuery(GL_TIME_ELAPSED);
+		totalCpuTime += cpuTime.count();
+		numMeasuredFrames++;
+		reportTimes();
+	}
+
+	// Appelée lorsque la fenêtre se ferme.
+	void onClose() override {
+		meshPool.deleteObjects();
+		batch.deleteObjects();
+		glDeleteTextures(1, &texLayers);
+		glDeleteQueries(numTimerQueries, timerQueries);
+		for (auto prog : {&individualProg, &drawIdProg}) {
+			prog->deleteShaders();
+			prog->deleteProgram();
+		}
+	}
+
+	// Appelée lors d'une touche de clavier.
+	void onKeyPress(const sf::Event::KeyEvent& key) override {
+		// La touche R réinitialise la position de la caméra.
+		// Les touches + et - rapprochent et éloignent la caméra orbitale.
+		// Les touches haut/bas change l'élévation ou la latitude de la caméra orbitale.
+		// Les touches gauche/droite change la longitude ou le roulement (avec shift) de la caméra orbitale.
+
+		camera.handleKeyEvent(key, 5, 5, {150, 40, 30, 0, {0, 0, 0}});
+		updateCamera();
+
+		using enum sf::Keyboard::Key;
+		switch (key.code) {
+		case Num1:
+			setMode(SubmissionMode::Individual, "individuelle");
+			break;
+		case Num2:
+			setMode(SubmissionMode::Instanced, "instanciée");
+			break;
+		case Num3:
+			setMode(SubmissionMode::MultiDrawIndirect, "indirecte");
+			break;
+		case C:
+			isCulling ^= 1;
+			std::cout << "Élimination hors champ " << (isCulling ? "activée" : "désactivée") << std::endl;
+			break;
+		case Space:
+			isAnimating ^= 1;
+			break;
+
+		case F5:
+			std::string path = saveScreenshot();
+			std::cout << "Capture d'écran dans " << path << std::endl;
+			break;
+		}
+	}
+
+	// Appelée lors d'un mouvement de souris.
+	void onMouseMove(const sf::Event::MouseMoveEvent& mouseDelta) override {
+		// Mettre à jour la caméra si on a un clic droit ou central.
+		auto& mouse = getMouse();
+		camera.handleMouseMoveEvent(mouseDelta, mouse, deltaTime_ / (0.7f / 30));
+		updateCamera();
+	}
+
+	// Appelée lors d'un défilement de souris.
+	void onMouseScroll(const sf::Event::MouseWheelScrollEvent& mouseScroll) override {
+		// Zoom in/out
+		camera.altitude -= mouseScroll.delta * 5;
+		updateCamera();
+	}
+
+	// Appelée lorsque la fenêtre se redimensionne (juste après le redimensionnement).
+	void onResize(const sf::Event::SizeEvent& event) override {
+		applyPerspective();
+	}
+
+	// Une variable uniforme et un tracé par objet, comme dans les autres exemples (mais sans changer de VAO, grâce au MeshPool).
+	void drawIndividual(const std::vector<mat4>& models) {
+		individualProg.use();
+		GLuint modelLoc = individualProg.getUniformLocation("model");
+		GLuint layerLoc = individualProg.getUniformLocation("textureLayer");
+		meshPool.bind();
+		for (size_t i = 0; i < objects.size(); i++) {
+			if (not isObjectVisible[i])
+				continue;
+			individualProg.setMat(modelLoc, models[i]);
+			individualProg.setUint(layerLoc, objects[i].textureLayer);
+			meshPool.draw(*objects[i].mesh);
+		}
+		meshPool.unbind();
+	}
+
+	// Les données des objets visibles dans le SSBO, puis un tracé instancié par groupe d'objets ayant le même mesh. Le lot ne contient que les objets visibles, donc chaque groupe commence après les objets visibles des groupes précédents.
+	void drawInstanced(const std::vector<mat4>& models) {
+		fillBatch(models);
+		drawIdProg.use();
+		GLuint offsetLoc = drawIdProg.getUniformLocation("drawOffset");
+		meshPool.bind();
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, batch.getDrawDataBuffer());
+		size_t first = 0;
+		size_t drawOffset = 0;
+		while (first < objects.size()) {
+			size_t last = first;
+			size_t numVisible = 0;
+			while (last < objects.size() and objects[last].mesh == objects[first].mesh)
+				numVisible += isObjectVisible[last++];
+			auto& mesh = *objects[first].mesh;
+			if (numVisible > 0) {
+				drawIdProg.setUint(offsetLoc, (unsigned)drawOffset);
+				auto offset = (const void*)(mesh.firstIndex * meshPool.getIndexSize());
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)mesh.numIndices, meshPool.getIndexType(), offset, (GLsizei)numVisible, (GLint)mesh.firstVertex);
+			}
+			drawOffset += numVisible;
+			first = last;
+		}
+		drawIdProg.setUint(offsetLoc, 0);
+		meshPool.unbind();
+	}
+
+	// Toute la scène en un seul appel.
+	void drawMultiDrawIndirect(const std::vector<mat4>& models) {
+		fillBatch(models);
+		drawIdProg.use();
+		batch.draw(meshPool);
+	}
+
+	void fillBatch(const std::vector<mat4>& models) {
+		batch.clear();
+		for (size_t i = 0; i < objects.size(); i++) {
+			if (isObjectVisible[i])
+				batch.add(*objects[i].mesh, models[i], objects[i].textureLayer);
+		}
+		batch.upload();
+	}
+
+	// Tester les boîtes englobantes de tous les objets contre le volume de vue, 8 à la fois (voir cullBoundingBoxes).
+	void cullObjects(const std::vector<mat4>& models) {
+		if (not isCulling) {
+			isObjectVisible.assign(objects.size(), 1);
+			return;
+		}
+		worldBoxes.clear();
+		for (size_t i = 0; i < objects.size(); i++) {
+			vec3 center, extent;
+			objects[i].mesh->getWorldBox(models[i], center, extent);
+			worldBoxes.add(center, extent);
+		}
+		cullBoundingBoxes(Frustum::fromMatrices(projection, view), worldBoxes, isObjectVisible, &cullingStats);
+	}
+
+	void setMode(SubmissionMode newMode, const char* name) {
+		if (newMode != SubmissionMode::Individual and not isMultiDrawSupported) {
+			std::cout << "Ce mode demande OpenGL 4.6 (ou 4.3 avec ARB_shader_draw_parameters)." << std::endl;
+			return;
+		}
+		mode = newMode;
+		numMeasuredFrames = numGpuMeasuredFrames = 0;
+		totalCpuTime = totalGpuTime = 0;
+		timeSinceReport = 0;
+		cullingStats = {};
+		std::cout << "Soumission " << name << std::endl;
+	}
+
+	void reportTimes() {
+		timeSinceReport += getFrameDeltaTime();
+		if (timeSinceReport < 1 or numMeasuredFrames == 0)
+			return;
+		size_t numVisible = std::count(isObjectVisible.begin(), isObjectVisible.end(), 1);
+		size_t numDrawCalls = mode == SubmissionMode::Individual ? numVisible : mode == SubmissionMode::Instanced ? 2 : 1;
+		std::cout << std::format(
+			"{} objets ({} visibles), {} appels de tracé : CPU {:.3f} ms, GPU {:.3f} ms par trame",
+			objects.size(), numVisible, numDrawCalls, totalCpuTime / numMeasuredFrames, totalGpuTime / std::max(numGpuMeasuredFrames, 1)
+		) << std::endl;
+		if (cullingStats.numTested > 0)
+			std::cout << std::format("Éliminés hors champ : {:.1f} %", 100.0 * cullingStats.numCulled / cullingStats.numTested) << std::endl;
+		numMeasuredFrames = numGpuMeasuredFrames = 0;
+		totalCpuTime = totalGpuTime = 0;
+		timeSinceReport = 0;
+		cullingStats = {};
+	}
+
+	// Un tableau de textures avec un damier d'une couleur différente dans chaque couche.
+	GLuint createLayerTexture() {
+		static const int size = 8;
+		static const std::array<u8vec4, numTextureLayers> colors = {{
+			{230, 80, 60, 255}, {80, 200, 90, 255}, {70, 120, 230, 255}, {240, 200, 60, 255},
+		}};
+		std::vector<u8vec4> pixels;
+		for (auto&& color : colors) {
+			for (int y = 0; y < size; y++) {
+				for (int x = 0; x < size; x++)
+					pixels.push_back((x + y) % 2 == 0 ? color : u8vec4(255));
+			}
+		}
+
+		GLuint texture = 0;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, numTextureLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		return texture;
+	}
+
+	void updateCamera() {
+		for (auto prog : {&individualProg, &drawIdProg}) {
+			if (prog->getObject() != 0)
+				camera.updateProgram(*prog, view);
+		}
+	}
+
+	void applyPerspective(float fovy = 50) {
+		projection.perspective(fovy, getWindowAspect(), 1.0f, 1000.0f);
+		for (auto prog : {&individualProg, &drawIdProg}) {
+			if (prog->getObject() == 0)
+				continue;
+			prog->use();
+			prog->setMat(projection);
+		}
+	}
+
+	void loadShaders() {
+		individualProg.create();
+		individualProg.attachSourceFile(GL_VERTEX_SHADER, "individual_vert.glsl");
+		individualProg.attachSourceFile(GL_FRAGMENT_SHADER, "layer_frag.glsl");
+		individualProg.link();
+
+		// Le nuanceur avec gl_DrawIDARB ne compile qu'avec OpenGL 4.6 ou l'extension ARB_shader_draw_parameters.
+		if (isMultiDrawSupported) {
+			drawIdProg.create();
+			drawIdProg.attachSourceFile(GL_VERTEX_SHADER, "draw_id_vert.glsl");
+			drawIdProg.attachSourceFile(GL_FRAGMENT_SHADER, "layer_frag.glsl");
+			drawIdProg.link();
+		}
+	}
+};
+
+
+int main(int argc, char* argv[]) {
+	WindowSettings settings = {};
+	// Pas de limite de trames, pour mesurer le coût de la soumission.
+	settings.fps = 0;
+
+	App app;
+	app.run(argc, argv, "Exemple Extra: Soumission indirecte", settings);
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <SFML/Graphics.hpp>
+
+#include "Mesh.hpp"
+#include "Texture.hpp"
+#include "TextureCache.hpp"
+
+
+using namespace gl;
+
+
+// Chargement asynchrone des ressources. Le décodage (analyse des fichiers OBJ, décompression des PNG) se fait sur des fils de travail, et l'envoi à OpenGL se fait sur le fil principal (le seul qui a le contexte) avec processUploads(), appelée à chaque trame avec un budget de temps. La première trame s'affiche donc tout de suite et les objets apparaissent au fur et à mesure qu'ils sont prêts.
+// Les ressources sont accessibles par des poignées (AssetHandle) dès le départ. Tant qu'une ressource n'est pas résidente (sur le GPU), la poignée donne un objet vide : un Mesh vide n'est pas tracé et un Texture vide lie la texture 0.
+// On aurait pu faire les envois dans un deuxième contexte partagé, avec glFenceSync pour savoir quand ils sont terminés, mais les VAO ne sont pas partagés entre les contextes et les contextes partagés sont peu fiables sur certaines plateformes (macOS). Le budget par trame donne un résultat semblable de façon portable.
+
+
+enum class AssetState
+{
+	Loading,  // En décodage ou en attente d'envoi.
+	Resident, // Sur le GPU, utilisable.
+	Failed,   // Le décodage a échoué (l'erreur a été affichée).
+};
+
+// Une poignée vers une ressource chargée par AssetLoader. Les copies d'une poignée partagent la même ressource.
+template <typename T>
+class AssetHandle
+{
+public:
+	static AssetHandle create() {
+		AssetHandle result;
+		result.slot_ = std::make_shared<Slot>();
+		return result;
+	}
+
+	AssetState getState() const { return slot_ != nullptr ? slot_->state : AssetState::Failed; }
+	bool isResident() const { return getState() == AssetState::Resident; }
+
+	T& get() const { return *slot_->asset; }
+	T& operator* () const { return get(); }
+	T* operator-> () const { return &get(); }
+
+	// Appelées par AssetLoader sur le fil principal.
+	void setResident() { slot_->state = AssetState::Resident; }
+	void setFailed() { slot_->state = AssetState::Failed; }
+
+	// Faire pointer la poignée vers un objet possédé ailleurs (par exemple par TextureCache). L'objet reste référencé tant qu'une copie de la poignée existe.
+	void setResident(std::shared_ptr<T> asset) {
+		slot_->asset = std::move(asset);
+		setResident();
+	}
+
+private:
+	struct Slot
+	{
+		std::shared_ptr<T> asset = std::make_shared<T>();
+		AssetState state = AssetState::Loading;
+	};
+
+	std::shared_ptr<Slot> slot_;
+};
+
+using MeshHandle = AssetHandle<Mesh>;
+using TextureHandle = AssetHandle<Texture>;
+
+
+class AssetLoader
+{
+public:
+	// L'envoi à faire sur le fil principal, retourné par le décodage.
+	using UploadFunc = std::function<void()>;
+	// Le décodage, exécuté sur un fil de travail.
+	using DecodeFunc = std::function<UploadFunc()>;
+
+	// Si numThreads est 0, on utilise un fil de moins que le nombre de coeurs (le fil principal continue d'afficher).
+	AssetLoader(unsigned numThreads = 0) {
+		if (numThreads == 0)
+			numThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		for (unsigned i = 0; i < numThreads; i++)
+			workers_.emplace_back([this] { workerLoop(); });
+	}
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator= (const AssetLoader&) = delete;
+
+	// Les décodages pas encore commencés sont abandonnés, ceux en cours sont terminés.
+	~AssetLoader() {
+		{
+			std::lock_guard lock(mutex_);
+			isStopping_ = true;
+			decodeQueue_.clear();
+		}
+		decodeCondition_.notify_all();
+		for (auto& worker : workers_)
+			worker.join();
+	}
+
+	// Nombre de ressources pas encore envoyées (ou abandonnées).
+	size_t getNumPending() const { return numPending_; }
+	bool isDone() const { return numPending_ == 0; }
+
+	// Charger le mesh numéro objectIndex d'un fichier Wavefront, en passant par le cache binaire (voir Mesh::loadFromWavefrontFileCached).
+	MeshHandle loadMesh(const std::string& filename, bool indexed = true, int maxLods = 0, size_t objectIndex = 0) {
+		MeshHandle handle = MeshHandle::create();
+		enqueue([=]() -> UploadFunc {
+			auto meshes = Mesh::loadFromWavefrontFileCached(filename, false, indexed, maxLods);
+			if (objectIndex >= meshes.size()) {
+				std::cerr << std::format("AssetLoader: {} n'a pas d'objet {}", filename, objectIndex) << "\n";
+				return [=]() mutable { handle.setFailed(); };
+			}
+			auto mesh = std::make_shared<Mesh>(std::move(meshes[objectIndex]));
+			return [=]() mutable {
+				*handle = std::move(*mesh);
+				handle->setup();
+				handle.setResident();
+			};
+		});
+		return handle;
+	}
+
+	// Charger une image en passant par un TextureCache, avec la même clé que TextureCache::load (nombre de niveaux, échantillonnage et cache.compressing). Une image déjà dans le cache donne tout de suite une poignée résidente. Sinon, le décodage, le renversement vertical, les mipmaps (voir loadMipChainFromFileCached) et la compression (voir loadCompressedMipChainFromFileCached) sont faits sur un fil de travail, puis la texture envoyée est ajoutée au cache, qui en est propriétaire (détruite par TextureCache::deleteObjects, et par releaseUnused quand plus aucune poignée ne la référence).
+	// Une image demandée de nouveau avant la fin de son chargement donne la même poignée.
+	TextureHandle loadTexture(TextureCache& cache, const std::string& filename, int detailLevels = 1, const TextureSampling& sampling = {}) {
+		TextureHandle handle = TextureHandle::create();
+		auto key = TextureCache::makeKey(filename, detailLevels, sampling, cache.compressing);
+		if (auto tex = cache.find(key)) {
+			handle.setResident(tex);
+			return handle;
+		}
+		auto pendingKey = std::make_pair(&cache, key);
+		if (auto it = pendingTextures_.find(pendingKey); it != pendingTextures_.end())
+			return it->second;
+		pendingTextures_[pendingKey] = handle;
+
+		// isS3tcSupported demande le contexte OpenGL, donc on la vérifie ici plutôt que sur le fil de travail. Sans S3TC, on revient à une texture non compressée comme Texture::loadFromFileCompressed.
+		bool isCompressing = cache.compressing and isS3tcSupported();
+		int numLevels = std::max(detailLevels, 1);
+		enqueue([=, this, &cache]() -> UploadFunc {
+			auto chain = std::make_shared<MipChain>();
+			auto compressedChain = std::make_shared<CompressedMipChain>();
+			if (isCompressing)
+				*compressedChain = loadCompressedMipChainFromFileCached(filename, numLevels);
+			else
+				*chain = loadMipChainFromFileCached(filename, numLevels);
+			bool isEmpty = isCompressing ? compressedChain->levels.empty() : chain->levels.empty();
+			return [=, this, &cache]() mutable {
+				pendingTextures_.erase(pendingKey);
+				if (isEmpty) {
+					handle.setFailed();
+					return;
+				}
+				Texture loaded = isCompressing ? Texture::createFromCompressedMipChain(*compressedChain) : Texture::createFromMipChain(*chain);
+				handle.setResident(cache.insert(pendingKey.second, loaded));
+			};
+		});
+		return handle;
+	}
+
+	// Ajouter un chargement quelconque. decode est appelée sur un fil de travail et ne doit pas utiliser OpenGL. L'envoi qu'elle retourne est appelé par processUploads().
+	void enqueue(DecodeFunc decode) {
+		numPending_++;
+		{
+			std::lock_guard lock(mutex_);
+			decodeQueue_.push_back(std::move(decode));
+		}
+		decodeCondition_.notify_one();
+	}
+
+	// Faire les envois des ressources décodées jusqu'à ce que budgetMs millisecondes soient écoulées (au moins un envoi s'il y en a). À appeler une fois par trame sur le fil principal. Retourne le nombre d'envois faits.
+	size_t processUploads(double budgetMs = 2.0) {
+		auto start = std::chrono::steady_clock::now();
+		size_t numUploads = 0;
+		while (true) {
+			UploadFunc upload;
+			{
+				std::lock_guard lock(mutex_);
+				if (uploadQueue_.empty())
+					break;
+				upload = std::move(uploadQueue_.front());
+				uploadQueue_.pop_front();
+			}
+			if (upload)
+				upload();
+			numPending_--;
+			numUploads++;
+			if (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= budgetMs)
+				break;
+		}
+		return numUploads;
+	}
+
+	// Attendre que tout soit chargé et envoyé (comme un chargement synchrone, mais avec le décodage en parallèle).
+	void waitAll() {
+		while (numPending_ > 0) {
+			{
+				std::unique_lock lock(mutex_);
+				uploadCondition_.wait(lock, [this] { return not uploadQueue_.empty(); });
+			}
+			processUploads(std::numeric_limits<double>::infinity());
+		}
+	}
+
+private:
+	void workerLoop() {
+		while (true) {
+			DecodeFunc decode;
+			{
+				std::unique_lock lock(mutex_);
+				decodeCondition_.wait(lock, [this] { return isStopping_ or not decodeQueue_.empty(); });
+				if (isStopping_)
+					return;
+				decode = std::move(decodeQueue_.front());
+				decodeQueue_.pop_front();
+			}
+			UploadFunc upload = decode();
+			{
+				std::lock_guard lock(mutex_);
+				uploadQueue_.push_back(std::move(upload));
+			}
+			uploadCondition_.notify_one();
+		}
+	}
+
+	std::vector<std::thread> workers_;
+	std::mutex mutex_;
+	std::condition_variable decodeCondition_;
+	std::condition_variable uploadCondition_;
+	std::deque<DecodeFunc> decodeQueue_;
+	std::deque<UploadFunc> uploadQueue_;
+	std::map<std::pair<const TextureCache*, TextureCache::Key>, TextureHandle> pendingTextures_; // Les textures en cours de chargement, jusqu'à leur ajout au cache. Seulement utilisé par le fil principal.
+	bool isStopping_ = false;
+	size_t numPending_ = 0; // Seulement modifié par le fil principal.
+};
@@ -0,0 +1,279 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+using namespace glm;
+
+
+// Lancer de rayons sur le CPU avec une hiérarchie de volumes englobants (BVH) de triangles. Sert à la sélection d'objets à la souris sans relire le tampon de couleur du GPU (voir Extra_SelectionCouleur).
+
+
+// Un rayon origin + t * direction. La direction n'a pas besoin d'être normalisée, mais t est une distance seulement si elle l'est.
+struct Ray
+{
+	vec3 origin;
+	vec3 direction;
+
+	vec3 at(float t) const { return origin + t * direction; }
+
+	// Le même rayon dans le repère donné par une matrice (typiquement l'inverse de la matrice de modélisation). La direction n'est pas renormalisée, donc les t restent les mêmes dans les deux repères.
+	Ray transformed(const mat4& m) const {
+		return {vec3(m * vec4(origin, 1)), vec3(m * vec4(direction, 0))};
+	}
+};
+
+// Générer le rayon qui passe par un point de l'écran, en coordonnées normalisées ([-1,1], y vers le haut, comme MouseState::normalized). Comme dans C09_Retroaction_VBO::computePhysics, on applique l'inverse de projection * view au point, ici une fois sur le plan proche (z = -1) et une fois sur le plan loin (z = 1). Le rayon est en coordonnées du monde et sa direction est normalisée.
+inline Ray makeRayFromScreen(vec2 normalizedCoords, const mat4& projection, const mat4& view) {
+	mat4 invTransform = inverse(projection * view);
+	vec4 nearPoint = invTransform * vec4(normalizedCoords, -1, 1);
+	vec4 farPoint = invTransform * vec4(normalizedCoords, 1, 1);
+	vec3 origin = vec3(nearPoint) / nearPoint.w;
+	vec3 target = vec3(farPoint) / farPoint.w;
+	return {origin, normalize(target - origin)};
+}
+
+// Le résultat d'un lancer de rayon.
+struct RayHit
+{
+	float distance = std::numeric_limits<float>::infinity(); // Le t du rayon au point d'impact.
+	uint32_t triangle = 0; // L'index du triangle touché (ses sommets sont aux indices 3 * triangle, 3 * triangle + 1 et 3 * triangle + 2).
+	vec3 barycentrics = vec3(0); // Les poids des trois sommets du triangle au point d'impact (leur somme est 1).
+
+	bool isHit() const { return distance < std::numeric_limits<float>::infinity(); }
+};
+
+// Intersection rayon-triangle de Möller et Trumbore (les deux faces). Retourne vrai et remplit t, u et v (barycentriques des sommets 1 et 2) s'il y a un impact avec 0 <= t < maxT.
+inline bool intersectTriangle(const Ray& ray, const vec3& p0, const vec3& p1, const vec3& p2, float maxT, float& t, float& u, float& v) {
+	vec3 edge1 = p1 - p0;
+	vec3 edge2 = p2 - p0;
+	vec3 pvec = cross(ray.direction, edge2);
+	float det = dot(edge1, pvec);
+	if (std::abs(det) < 1e-12f)
+		return false;
+	float invDet = 1 / det;
+	vec3 tvec = ray.origin - p0;
+	u = dot(tvec, pvec) * invDet;
+	if (u < 0 or u > 1)
+		return false;
+	vec3 qvec = cross(tvec, edge1);
+	v = dot(ray.direction, qvec) * invDet;
+	if (v < 0 or u + v > 1)
+		return false;
+	t = dot(edge2, qvec) * invDet;
+	return t >= 0 and t < maxT;
+}
+
+// Intersection rayon-boîte par la méthode des dalles. invDirection est 1 / ray.direction (les divisions par 0 donnent des infinis, ce qui fonctionne). Retourne la distance d'entrée, ou l'infini s'il n'y a pas d'impact avant maxT.
+inline float intersectBox(const Ray& ray, const vec3& invDirection, const vec3& boxMin, const vec3& boxMax, float maxT) {
+	float tMin = 0;
+	float tMax = maxT;
+	for (int axis = 0; axis < 3; axis++) {
+		float t1 = (boxMin[axis] - ray.origin[axis]) * invDirection[axis];
+		float t2 = (boxMax[axis] - ray.origin[axis]) * invDirection[axis];
+		tMin = std::max(tMin, std::min(t1, t2));
+		tMax = std::min(tMax, std::max(t1, t2));
+	}
+	return tMin <= tMax ? tMin : std::numeric_limits<float>::infinity();
+}
+
+
+// Un noeud de BVH. Une feuille a numTriangles > 0 et ses triangles sont triangles[first .. first + numTriangles[. Un noeud interne a numTriangles = 0 et ses enfants sont nodes[first] et nodes[first + 1].
+struct BvhNode
+{
+	vec3 boundsMin;
+	uint32_t first;
+	vec3 boundsMax;
+	uint32_t numTriangles;
+};
+
+// Une BVH de triangles construite avec l'heuristique d'aire de surface (SAH) par casiers. Les positions des sommets des triangles sont copiées dans l'ordre des feuilles pour que le parcours lise la mémoire de façon séquentielle.
+class TriangleBvh
+{
+public:
+	static constexpr int numBins = 16;
+	static constexpr uint32_t maxLeafSize = 4;
+	// La profondeur maximale d'une feuille (la racine est à 0). Le parcours garde au plus un noeud en attente par niveau, plus les deux enfants du noeud courant, donc sa pile de maxDepth + 1 entrées ne déborde jamais. Un noeud à cette profondeur devient une feuille même s'il a plus de maxLeafSize triangles (ça arrive seulement avec beaucoup de triangles superposés ou dégénérés).
+	static constexpr int maxDepth = 63;
+
+	bool isEmpty() const { return nodes_.empty(); }
+	size_t getNumNodes() const { return nodes_.size(); }
+
+	// Construire la BVH. vertexOf(triangle, corner) doit retourner la position (vec3) du coin corner (0, 1 ou 2) du triangle donné.
+	template <typename VertexFunc>
+	void build(size_t numTriangles, VertexFunc&& vertexOf) {
+		nodes_.clear();
+		triangleIds_.resize(numTriangles);
+		std::iota(triangleIds_.begin(), triangleIds_.end(), 0u);
+		if (numTriangles == 0)
+			return;
+
+		// Boîtes et centroïdes de chaque triangle.
+		std::vector<vec3> triangleMin(numTriangles), triangleMax(numTriangles), centroids(numTriangles);
+		for (size_t t = 0; t < numTriangles; t++) {
+			vec3 p0 = vertexOf(t, 0), p1 = vertexOf(t, 1), p2 = vertexOf(t, 2);
+			triangleMin[t] = min(p0, min(p1, p2));
+			triangleMax[t] = max(p0, max(p1, p2));
+			centroids[t] = (p0 + p1 + p2) / 3.0f;
+		}
+
+		nodes_.reserve(2 * numTriangles);
+		nodes_.push_back({vec3(0), 0, vec3(0), (uint32_t)numTriangles});
+		// Les noeuds à découper, avec leur profondeur.
+		std::vector<std::pair<uint32_t, int>> stack = {{0, 0}};
+		while (not stack.empty()) {
+			auto [nodeIndex, depth] = stack.back();
+			stack.pop_back();
+			// Copier les champs plutôt que garder une référence, car nodes_ peut être réalloué plus bas.
+			uint32_t first = nodes_[nodeIndex].first;
+			uint32_t count = nodes_[nodeIndex].numTriangles;
+
+			vec3 boundsMin = triangleMin[triangleIds_[first]], boundsMax = triangleMax[triangleIds_[first]];
+			vec3 centroidMin = centroids[triangleIds_[first]], centroidMax = centroidMin;
+			for (uint32_t i = first; i < first + count; i++) {
+				uint32_t t = triangleIds_[i];
+				boundsMin = min(boundsMin, triangleMin[t]);
+				boundsMax = max(boundsMax, triangleMax[t]);
+				centroidMin = min(centroidMin, centroids[t]);
+				centroidMax = max(centroidMax, centroids[t]);
+			}
+			nodes_[nodeIndex].boundsMin = boundsMin;
+			nodes_[nodeIndex].boundsMax = boundsMax;
+			if (count <= maxLeafSize or depth >= maxDepth)
+				continue;
+
+			// Chercher le meilleur plan de coupe parmi les frontières de casiers sur les trois axes. Le coût SAH d'une coupe est la somme, pour chaque côté, de l'aire de la boîte fois le nombre de triangles.
+			float bestCost = std::numeric_limits<float>::infinity();
+			int bestAxis = -1;
+			int bestSplit = 0;
+			for (int axis = 0; axis < 3; axis++) {
+				float extent = centroidMax[axis] - centroidMin[axis];
+				if (extent <= 0)
+					continue;
+				struct Bin { vec3 boundsMin = vec3(std::numeric_limits<float>::infinity()); vec3 boundsMax = vec3(-std::numeric_limits<float>::infinity()); uint32_t count = 0; };
+				Bin bins[numBins];
+				float binScale = numBins / extent;
+				for (uint32_t i = first; i < first + count; i++) {
+					uint32_t t = triangleIds_[i];
+					int b = std::min(numBins - 1, int((centroids[t][axis] - centroidMin[axis]) * binScale));
+					bins[b].boundsMin = min(bins[b].boundsMin, triangleMin[t]);
+					bins[b].boundsMax = max(bins[b].boundsMax, triangleMax[t]);
+					bins[b].count++;
+				}
+				// Balayer de gauche à droite puis de droite à gauche pour avoir les aires et compteurs cumulés des deux côtés de chaque coupe.
+				float leftCost[numBins - 1];
+				Bin accumulated;
+				for (int b = 0; b < numBins - 1; b++) {
+					accumulated.boundsMin = min(accumulated.boundsMin, bins[b].boundsMin);
+					accumulated.boundsMax = max(accumulated.boundsMax, bins[b].boundsMax);
+					accumulated.count += bins[b].count;
+					leftCost[b] = accumulated.count * surfaceArea(accumulated.boundsMin, accumulated.boundsMax);
+				}
+				accumulated = {};
+				for (int b = numBins - 1; b > 0; b--) {
+					accumulated.boundsMin = min(accumulated.boundsMin, bins[b].boundsMin);
+					accumulated.boundsMax = max(accumulated.boundsMax, bins[b].boundsMax);
+					accumulated.count += bins[b].count;
+					float cost = leftCost[b - 1] + accumulated.count * surfaceArea(accumulated.boundsMin, accumulated.boundsMax);
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = b;
+					}
+				}
+			}
+
+			// Garder une feuille si aucune coupe n'est moins chère que de tester tous les triangles.
+			float leafCost = count * surfaceArea(boundsMin, boundsMax);
+			if (bestAxis < 0 or bestCost >= leafCost)
+				continue;
+
+			// Partitionner les triangles selon le casier de leur centroïde.
+			float binScale = numBins / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+			auto middle = std::partition(triangleIds_.begin() + first, triangleIds_.begin() + first + count, [&](uint32_t t) {
+				return std::min(numBins - 1, int((centroids[t][bestAxis] - centroidMin[bestAxis]) * binScale)) < bestSplit;
+			});
+			uint32_t leftCount = uint32_t(middle - triangleIds_.begin()) - first;
+			if (leftCount == 0 or leftCount == count)
+				continue;
+
+			uint32_t leftIndex = (uint32_t)nodes_.size();
+			nodes_.push_back({vec3(0), first, vec3(0), leftCount});
+			nodes_.push_back({vec3(0), first + leftCount, vec3(0), count - leftCount});
+			nodes_[nodeIndex].first = leftIndex;
+			nodes_[nodeIndex].numTriangles = 0;
+			stack.push_back({leftIndex + 1, depth + 1});
+			stack.push_back({leftIndex, depth + 1});
+		}
+
+		// Copier les sommets dans l'ordre des feuilles.
+		triangleVertices_.resize(3 * numTriangles);
+		for (size_t i = 0; i < numTriangles; i++) {
+			for (int c = 0; c < 3; c++)
+				triangleVertices_[3 * i + c] = vertexOf(triangleIds_[i], c);
+		}
+	}
+
+	// Trouver l'impact le plus proche du rayon, en partant de hit.distance comme distance maximale. Retourne vrai si un impact plus proche a été trouvé (hit est alors mis à jour).
+	bool intersect(const Ray& ray, RayHit& hit) const {
+		if (nodes_.empty())
+			return false;
+
+		vec3 invDirection = 1.0f / ray.direction;
+		bool found = false;
+		// La profondeur est limitée à la construction (voir maxDepth), donc la pile ne peut pas déborder.
+		uint32_t stack[maxDepth + 1];
+		int stackSize = 0;
+		if (intersectBox(ray, invDirection, nodes_[0].boundsMin, nodes_[0].boundsMax, hit.distance) < hit.distance)
+			stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const BvhNode& node = nodes_[stack[--stackSize]];
+			if (node.numTriangles > 0) {
+				for (uint32_t i = node.first; i < node.first + node.numTriangles; i++) {
+					float t, u, v;
+					if (intersectTriangle(ray, triangleVertices_[3 * i], triangleVertices_[3 * i + 1], triangleVertices_[3 * i + 2], hit.distance, t, u, v)) {
+						hit = {t, triangleIds_[i], vec3(1 - u - v, u, v)};
+						found = true;
+					}
+				}
+				continue;
+			}
+
+			// Visiter l'enfant le plus proche en premier (il est empilé en dernier) pour réduire hit.distance le plus tôt possible.
+			float tLeft = intersectBox(ray, invDirection, nodes_[node.first].boundsMin, nodes_[node.first].boundsMax, hit.distance);
+			float tRight = intersectBox(ray, invDirection, nodes_[node.first + 1].boundsMin, nodes_[node.first + 1].boundsMax, hit.distance);
+			uint32_t nearChild = node.first, farChild = node.first + 1;
+			if (tRight < tLeft) {
+				std::swap(tLeft, tRight);
+				std::swap(nearChild, farChild);
+			}
+			assert(stackSize + 2 <= maxDepth + 1);
+			if (tRight < hit.distance)
+				stack[stackSize++] = farChild;
+			if (tLeft < hit.distance)
+				stack[stackSize++] = nearChild;
+		}
+		return found;
+	}
+
+private:
+	static float surfaceArea(const vec3& boundsMin, const vec3& boundsMax) {
+		vec3 size = max(boundsMax - boundsMin, vec3(0));
+		return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	std::vector<BvhNode> nodes_;
+	std::vector<uint32_t> triangleIds_;
+	std::vector<vec3> triangleVertices_;
+};
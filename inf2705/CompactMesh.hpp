@@ -0,0 +1,231 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "utils.hpp"
+#include "Mesh.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Un petit vecteur de N composantes de type T, utilisable avec les macros VERTEX_ATTRIB (il a length() et value_type comme les vecteurs de GLM). Contrairement à GLM, T peut être Half.
+template <typename T, int N>
+struct PackedVec
+{
+	using value_type = T;
+
+	T components[N];
+
+	static constexpr int length() { return N; }
+	T& operator[] (int i) { return components[i]; }
+	const T& operator[] (int i) const { return components[i]; }
+};
+
+
+// Un sommet compact (16 octets au lieu des 32 de VertexData) :
+//   - position : 3 composantes, soit GLushort normalisé dans la boîte englobante du mesh, soit Half relatif au centre de la boîte. Dans les deux cas, il faut appliquer la matrice CompactMesh::getDequantizationMatrix() avant la matrice de modélisation.
+//   - normale : 2 composantes encodées en octaèdre, GLbyte ou GLshort normalisé dans [-1,1]. Il faut la décoder dans le nuanceur de sommets (voir plus bas).
+//   - coordonnées de texture : 2 Half, pour garder la répétition (coordonnées hors de [0,1]).
+// Chaque attribut commence sur une frontière de 4 octets et la taille est 16 octets : plusieurs GPU (notamment AMD) lisent les attributs mal alignés par un chemin lent, ou pas du tout. La position (6 octets) est donc suivie de 2 octets de remplissage, et une normale en GLbyte (2 octets) aussi.
+// Les attributs sont aux mêmes localisations que VertexData (0, 1 et 2). La position arrive en vec3 dans le nuanceur et les coordonnées de texture en vec2, donc les nuanceurs qui n'utilisent pas la normale n'ont pas besoin d'être modifiés. La normale arrive en vec2 et se décode avec :
+//     vec3 decodeOctahedral(vec2 e) {
+//         vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//         if (n.z < 0.0)
+//             n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+//         return normalize(n);
+//     }
+template <typename PositionComponent, typename NormalComponent>
+struct CompactVertexData
+{
+	static_assert(isTypeOneOf_v<PositionComponent, GLushort, Half>, "Positions compactes en GLushort ou Half");
+	static_assert(isTypeOneOf_v<NormalComponent, GLbyte, GLshort>, "Normales compactes en GLbyte ou GLshort");
+
+	PackedVec<PositionComponent, 3> position;      // layout(location = 0)
+	alignas(4) PackedVec<NormalComponent, 2> normal; // layout(location = 1)
+	alignas(4) PackedVec<Half, 2> texCoords;         // layout(location = 2)
+
+	static void setupAttribs() {
+		VertexFormat<CompactVertexData>::setupAttribs();
+	}
+};
+
+template <typename PositionComponent, typename NormalComponent>
+struct VertexAttribList<CompactVertexData<PositionComponent, NormalComponent>>
+{
+	using Vertex = CompactVertexData<PositionComponent, NormalComponent>;
+	// Les types entiers sont normalisés, les Half sont passés tels quels (GL_TRUE est ignoré pour les types flottants).
+	static constexpr std::array attribs = {
+		NORMALIZED_VERTEX_ATTRIB(0, Vertex, position),
+		NORMALIZED_VERTEX_ATTRIB(1, Vertex, normal),
+		NORMALIZED_VERTEX_ATTRIB(2, Vertex, texCoords),
+	};
+};
+
+// Les formats usuels. Avec l'alignement, des normales en GLbyte prendraient la même place que des GLshort, donc les deux utilisent des GLshort.
+using CompactVertexData16 = CompactVertexData<GLushort, GLshort>; // Positions quantifiées dans la boîte englobante.
+using CompactVertexDataHalf = CompactVertexData<Half, GLshort>; // Positions en Half, plus précises près du centre.
+
+static_assert(sizeof(CompactVertexData<GLushort, GLbyte>) == 16 and sizeof(CompactVertexData16) == 16 and sizeof(CompactVertexDataHalf) == 16, "Les sommets compacts font 16 octets");
+static_assert(offsetof(CompactVertexData16, normal) % 4 == 0 and offsetof(CompactVertexData16, texCoords) % 4 == 0, "Les attributs compacts sont alignés sur 4 octets");
+static_assert(offsetof(CompactVertexDataHalf, normal) % 4 == 0 and offsetof(CompactVertexDataHalf, texCoords) % 4 == 0, "Les attributs compacts sont alignés sur 4 octets");
+
+
+// Encoder une normale unitaire en octaèdre : on projette la sphère sur l'octaèdre |x|+|y|+|z|=1, puis on déplie la moitié inférieure sur les coins du carré [-1,1]². Beaucoup plus précis à taille égale que de quantifier x, y et z séparément.
+inline vec2 encodeOctahedral(vec3 n) {
+	float l1Norm = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	// Une normale nulle (non initialisée, ou d'une face d'aire nulle) donnerait 0/0. On l'encode comme (0, 0, 1).
+	if (l1Norm == 0)
+		return {0, 0};
+	n /= l1Norm;
+	vec2 e = {n.x, n.y};
+	if (n.z < 0) {
+		e.x = (1 - std::abs(n.y)) * (n.x >= 0 ? 1.0f : -1.0f);
+		e.y = (1 - std::abs(n.x)) * (n.y >= 0 ? 1.0f : -1.0f);
+	}
+	return e;
+}
+
+// Quantifier une valeur de [-1,1] en entier signé normalisé, ou une valeur de [0,1] en entier non signé normalisé. NaN donne 0 (std::clamp le laisserait passer, et sa conversion en entier n'est pas définie).
+template <typename T>
+inline T quantizeNormalized(float value) {
+	constexpr float maxValue = (float)std::numeric_limits<T>::max();
+	if (std::isnan(value))
+		return 0;
+	if constexpr (std::is_signed_v<T>)
+		return (T)std::round(std::clamp(value, -1.0f, 1.0f) * maxValue);
+	else
+		return (T)std::round(std::clamp(value, 0.0f, 1.0f) * maxValue);
+}
+
+inline Half toHalf(float value) {
+	return {(uint16_t)packHalf1x16(value)};
+}
+
+
+// Un mesh dont les sommets sont dans un format compact. On le construit à partir d'un Mesh normal avec fromMesh(). Les indices sont envoyés sur 16 bits si possible.
+template <typename VertexT>
+struct CompactMesh
+{
+	std::vector<VertexT> vertices;
+	std::vector<GLuint> indices;
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint ebo = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+	// La transformation des positions quantifiées vers les coordonnées d'origine : origine + position * échelle. L'échelle est la même sur les trois axes pour que la matrice ne déforme pas les normales.
+	vec3 dequantizationOrigin = vec3(0);
+	float dequantizationScale = 1;
+
+	// Construire la version compacte d'un mesh.
+	static CompactMesh fromMesh(const Mesh& mesh, bool setupOnLoad = true) {
+		using PositionComponent = typename decltype(VertexT::position)::value_type;
+		using NormalComponent = typename decltype(VertexT::normal)::value_type;
+
+		CompactMesh result;
+		result.indices = mesh.indices;
+		if (mesh.vertices.empty())
+			return result;
+
+		// Calculer la boîte englobante.
+		vec3 boundsMin = mesh.vertices[0].position;
+		vec3 boundsMax = mesh.vertices[0].position;
+		for (auto&& v : mesh.vertices) {
+			boundsMin = min(boundsMin, v.position);
+			boundsMax = max(boundsMax, v.position);
+		}
+		vec3 extent = boundsMax - boundsMin;
+		float maxExtent = std::max({extent.x, extent.y, extent.z, 1e-20f});
+		if constexpr (std::is_same_v<PositionComponent, Half>) {
+			// Les Half sont plus précis près de 0, donc on centre les positions.
+			result.dequantizationOrigin = (boundsMin + boundsMax) * 0.5f;
+			result.dequantizationScale = 1;
+		} else {
+			result.dequantizationOrigin = boundsMin;
+			result.dequantizationScale = maxExtent;
+		}
+
+		result.vertices.resize(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); i++) {
+			auto& src = mesh.vertices[i];
+			auto& dst = result.vertices[i];
+			vec3 p = (src.position - result.dequantizationOrigin) / result.dequantizationScale;
+			vec2 n = encodeOctahedral(src.normal);
+			for (int c = 0; c < 3; c++) {
+				if constexpr (std::is_same_v<PositionComponent, Half>)
+					dst.position[c] = toHalf(p[c]);
+				else
+					dst.position[c] = quantizeNormalized<PositionComponent>(p[c]);
+			}
+			for (int c = 0; c < 2; c++) {
+				dst.normal[c] = quantizeNormalized<NormalComponent>(n[c]);
+				dst.texCoords[c] = toHalf(src.texCoords[c]);
+			}
+		}
+
+		if (setupOnLoad)
+			result.setup();
+		return result;
+	}
+
+	// La matrice à appliquer avant la matrice de modélisation pour retrouver les positions d'origine (model * getDequantizationMatrix()).
+	mat4 getDequantizationMatrix() const {
+		mat4 result = translate(mat4(1.0f), dequantizationOrigin);
+		return scale(result, vec3(dequantizationScale));
+	}
+
+	void setup(GLenum usageMode = GL_STATIC_DRAW) {
+		if (vao == 0)
+			glGenVertexArrays(1, &vao);
+		if (vbo == 0)
+			glGenBuffers(1, &vbo);
+		if (ebo == 0)
+			glGenBuffers(1, &ebo);
+
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		if (not vertices.empty())
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexT), vertices.data(), usageMode);
+		if (not indices.empty())
+			indexType = uploadIndexBuffer(indices, usageMode);
+		VertexT::setupAttribs();
+		glBindVertexArray(0);
+	}
+
+	void draw(GLenum drawMode = GL_TRIANGLES) {
+		glBindVertexArray(vao);
+		if (not indices.empty())
+			glDrawElements(drawMode, (GLsizei)indices.size(), indexType, nullptr);
+		else
+			glDrawArrays(drawMode, 0, (GLsizei)vertices.size());
+		glBindVertexArray(0);
+	}
+
+	// Taille en mémoire graphique des tampons de sommets et d'indices, en octets.
+	size_t getGpuMemorySize() const {
+		size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		return vertices.size() * sizeof(VertexT) + indices.size() * indexSize;
+	}
+
+	void deleteObjects() {
+		glDeleteVertexArrays(1, &vao);
+		glDeleteBuffers(1, &vbo);
+		glDeleteBuffers(1, &ebo);
+		vao = vbo = ebo = 0;
+	}
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) or defined(_M_X64) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+#define INF2705_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+#include <glm/glm.hpp>
+
+
+using namespace glm;
+
+
+// Élimination des objets hors du champ de vue (frustum culling). On teste des boîtes englobantes alignées sur les axes (AABB) en coordonnées du monde contre les 6 plans du volume de vue. Un objet est éliminé seulement s'il est entièrement du côté extérieur d'un des plans, donc le test est conservateur : certains objets hors champ près des coins sont quand même tracés, mais un objet visible n'est jamais éliminé.
+
+
+// Les compteurs d'élimination, pour voir combien de tracés ont été évités.
+struct CullingStats
+{
+	size_t numTested = 0;
+	size_t numCulled = 0;
+
+	size_t getNumVisible() const { return numTested - numCulled; }
+};
+
+// Les 6 plans du volume de vue, avec la normale vers l'intérieur : un point p est du bon côté du plan i si dot(planes[i].xyz, p) + planes[i].w >= 0.
+struct Frustum
+{
+	vec4 planes[6];
+
+	// Extraire les plans à partir de la matrice projection * view (méthode de Gribb et Hartmann). Les plans sont alors en coordonnées du monde. Avec projection * view * model, ils seraient en coordonnées de l'objet.
+	static Frustum fromMatrix(const mat4& viewProjection) {
+		// Les rangées de la matrice (GLM est en colonnes).
+		vec4 rows[4];
+		for (int i = 0; i < 4; i++)
+			rows[i] = vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+		// Gauche, droite, bas, haut, proche, loin. En OpenGL, le volume de clipping est -w <= x,y,z <= w.
+		Frustum result;
+		result.planes[0] = rows[3] + rows[0];
+		result.planes[1] = rows[3] - rows[0];
+		result.planes[2] = rows[3] + rows[1];
+		result.planes[3] = rows[3] - rows[1];
+		result.planes[4] = rows[3] + rows[2];
+		result.planes[5] = rows[3] - rows[2];
+		for (auto& plane : result.planes) {
+			float normalLength = length(vec3(plane));
+			if (normalLength > 0)
+				plane /= normalLength;
+		}
+		return result;
+	}
+
+	static Frustum fromMatrices(const mat4& projection, const mat4& view) {
+		return fromMatrix(projection * view);
+	}
+
+	// Une AABB donnée par son centre et sa demi-étendue (demi-taille sur chaque axe) touche-t-elle le volume de vue?
+	bool isBoxVisible(const vec3& center, const vec3& extent) const {
+		for (auto&& plane : planes) {
+			float distance = dot(vec3(plane), center) + plane.w;
+			float radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+			if (distance + radius < 0)
+				return false;
+		}
+		return true;
+	}
+
+	bool isSphereVisible(const vec3& center, float radius) const {
+		for (auto&& plane : planes) {
+			if (dot(vec3(plane), center) + plane.w + radius < 0)
+				return false;
+		}
+		return true;
+	}
+};
+
+// Transformer une AABB locale (centre et demi-étendue) par une matrice de modélisation, et retourner l'AABB dans le nouveau repère qui la contient (méthode d'Arvo : la demi-étendue est transformée par la valeur absolue de la matrice).
+inline void transformBox(const mat4& model, const vec3& localCenter, const vec3& localExtent, vec3& center, vec3& extent) {
+	center = vec3(model * vec4(localCenter, 1));
+	extent = vec3(0);
+	for (int col = 0; col < 3; col++) {
+		for (int row = 0; row < 3; row++)
+			extent[row] += std::abs(model[col][row]) * localExtent[col];
+	}
+}
+
+
+// Un lot d'AABB en structure de tableaux (SoA), pour que le test d'élimination traite 8 boîtes à la fois avec des instructions SIMD.
+struct BoundingBoxBatch
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+	size_t size() const { return centerX.size(); }
+
+	void clear() {
+		for (auto array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+			array->clear();
+	}
+
+	// Ajouter une boîte et retourner son index dans le lot.
+	size_t add(const vec3& center, const vec3& extent) {
+		centerX.push_back(center.x);
+		centerY.push_back(center.y);
+		centerZ.push_back(center.z);
+		extentX.push_back(extent.x);
+		extentY.push_back(extent.y);
+		extentZ.push_back(extent.z);
+		return size() - 1;
+	}
+};
+
+// Tester toutes les boîtes d'un lot contre le volume de vue. visible[i] reçoit 1 si la boîte i est (potentiellement) visible, 0 sinon. Retourne le nombre de boîtes éliminées et ajoute les compteurs à stats s'il est donné.
+// Les boîtes sont traitées par groupes de 8 : avec AVX en un registre, sinon avec SSE2 en deux registres de 4. La fin du lot (moins de 8 boîtes) et les architectures sans SSE2 passent par le test normal.
+inline size_t cullBoundingBoxes(const Frustum& frustum, const BoundingBoxBatch& batch, std::vector<uint8_t>& visible, CullingStats* stats = nullptr) {
+	size_t count = batch.size();
+	visible.resize(count);
+	size_t numCulled = 0;
+	size_t i = 0;
+
+#if defined(__AVX__)
+	for (; i + 8 <= count; i += 8) {
+		__m256 cx = _mm256_loadu_ps(&batch.centerX[i]);
+		__m256 cy = _mm256_loadu_ps(&batch.centerY[i]);
+		__m256 cz = _mm256_loadu_ps(&batch.centerZ[i]);
+		__m256 ex = _mm256_loadu_ps(&batch.extentX[i]);
+		__m256 ey = _mm256_loadu_ps(&batch.extentY[i]);
+		__m256 ez = _mm256_loadu_ps(&batch.extentZ[i]);
+		// Un bit par boîte, mis à 1 si la boîte est entièrement à l'extérieur d'au moins un plan.
+		__m256 outside = _mm256_setzero_ps();
+		for (auto&& plane : frustum.planes) {
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane.x)), _mm256_mul_ps(cy, _mm256_set1_ps(plane.y))),
+				_mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w))
+			);
+			__m256 radius = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(std::abs(plane.x))), _mm256_mul_ps(ey, _mm256_set1_ps(std::abs(plane.y)))),
+				_mm256_mul_ps(ez, _mm256_set1_ps(std::abs(plane.z)))
+			);
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+		int mask = _mm256_movemask_ps(outside);
+		for (int k = 0; k < 8; k++) {
+			bool isOutside = (mask >> k) & 1;
+			visible[i + k] = not isOutside;
+			numCulled += isOutside;
+		}
+	}
+#elif defined(INF2705_CULLING_SSE)
+	for (; i + 8 <= count; i += 8) {
+		for (size_t half = i; half < i + 8; half += 4) {
+			__m128 cx = _mm_loadu_ps(&batch.centerX[half]);
+			__m128 cy = _mm_loadu_ps(&batch.centerY[half]);
+			__m128 cz = _mm_loadu_ps(&batch.centerZ[half]);
+			__m128 ex = _mm_loadu_ps(&batch.extentX[half]);
+			__m128 ey = _mm_loadu_ps(&batch.extentY[half]);
+			__m128 ez = _mm_loadu_ps(&batch.extentZ[half]);
+			__m128 outside = _mm_setzero_ps();
+			for (auto&& plane : frustum.planes) {
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+					_mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w))
+				);
+				__m128 radius = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::abs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(std::abs(plane.y)))),
+					_mm_mul_ps(ez, _mm_set1_ps(std::abs(plane.z)))
+				);
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+			}
+			int mask = _mm_movemask_ps(outside);
+			for (int k = 0; k < 4; k++) {
+				bool isOutside = (mask >> k) & 1;
+				visible[half + k] = not isOutside;
+				numCulled += isOutside;
+			}
+		}
+	}
+#endif
+
+	for (; i < count; i++) {
+		vec3 center = {batch.centerX[i], batch.centerY[i], batch.centerZ[i]};
+		vec3 extent = {batch.extentX[i], batch.extentY[i], batch.extentZ[i]};
+		bool isVisible = frustum.isBoxVisible(center, extent);
+		visible[i] = isVisible;
+		numCulled += not isVisible;
+	}
+
+	if (stats != nullptr) {
+		stats->numTested += count;
+		stats->numCulled += numCulled;
+	}
+	return numCulled;
+}
+
+#undef INF2705_CULLING_SSE
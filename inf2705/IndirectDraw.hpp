@@ -0,0 +1,134 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "MeshPool.hpp"
+#include "StreamingBuffer.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Soumission d'une scène complète en un seul appel avec glMultiDrawElementsIndirect. Les commandes de tracé sont dans un tampon GL_DRAW_INDIRECT_BUFFER et les données de chaque objet (matrice de modélisation, couche de texture) dans un SSBO. Le nuanceur de sommets retrouve les données de son objet avec gl_DrawID :
+//     struct DrawData { mat4 model; uint textureLayer; };
+//     layout(std430, binding = 0) readonly buffer DrawDataBuffer { DrawData drawData[]; };
+//     uniform uint drawOffset = 0;
+//     ...
+//     DrawData data = drawData[drawOffset + gl_DrawID + gl_InstanceID];
+// gl_DrawID demande GLSL 4.60, ou GLSL 4.30 avec l'extension ARB_shader_draw_parameters (il s'appelle alors gl_DrawIDARB), et glMultiDrawElementsIndirect et les SSBO OpenGL 4.3, alors que les exemples visent OpenGL 4.1. Il faut donc vérifier isMultiDrawIndirectSupported() et garder un chemin de tracé normal sinon.
+
+
+// Format d'une commande de tracé indirect, imposé par OpenGL.
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Les données d'un objet dans le SSBO, avec la disposition std430 (la taille est un multiple de 16 octets à cause du mat4).
+struct DrawData
+{
+	mat4 model;
+	GLuint textureLayer;
+	GLuint padding[3];
+};
+
+// OpenGL 4.3 pour glMultiDrawElementsIndirect et les SSBO, et OpenGL 4.6 ou l'extension ARB_shader_draw_parameters pour gl_DrawID. Beaucoup de pilotes 4.3 à 4.5 ont l'extension.
+inline bool isMultiDrawIndirectSupported() {
+	static const bool result = isOpenGLVersionOrExtensionSupported(4, 3) and isOpenGLVersionOrExtensionSupported(4, 6, "GL_ARB_shader_draw_parameters");
+	return result;
+}
+
+
+// Un lot d'objets d'un MeshPool à tracer en un seul appel. À chaque trame : clear(), add() pour chaque objet, upload(), puis draw() (autant de fois que nécessaire, par exemple pour la scène réfléchie et la scène normale).
+class IndirectDrawBatch
+{
+public:
+	const std::vector<DrawElementsIndirectCommand>& getCommands() const { return commands_; }
+	const std::vector<DrawData>& getDrawData() const { return drawData_; }
+	size_t size() const { return commands_.size(); }
+	GLuint getDrawDataBuffer() const { return ssbo_; }
+
+	// drawDataBinding est le point de liaison du SSBO (binding = ... dans le nuanceur).
+	void create(GLuint drawDataBinding = 0) {
+		deleteObjects();
+		drawDataBinding_ = drawDataBinding;
+		glGenBuffers(1, &ssbo_);
+		glGenBuffers(1, &indirectBuffer_);
+	}
+
+	void clear() {
+		commands_.clear();
+		drawData_.clear();
+	}
+
+	// Ajouter un objet (un niveau de détail d'un mesh indexé du pool) avec sa matrice de modélisation et sa couche de texture.
+	void add(const PooledMesh& mesh, const mat4& model, GLuint textureLayer = 0, int lodLevel = 0) {
+		if (mesh.numIndices == 0) {
+			std::cerr << "IndirectDrawBatch: seuls les meshes indexés peuvent être tracés indirectement" << std::endl;
+			return;
+		}
+		GLuint firstIndex = 0;
+		GLuint numIndices = mesh.numIndices;
+		if (not mesh.lods.empty()) {
+			auto& lod = mesh.lods[std::clamp(lodLevel, 0, (int)mesh.lods.size() - 1)];
+			firstIndex = lod.firstIndex;
+			numIndices = lod.numIndices;
+		}
+		// baseInstance n'est pas utilisé par le nuanceur, mais on y met l'index de l'objet pour qu'il soit disponible (gl_BaseInstance) au besoin.
+		commands_.push_back({numIndices, 1, mesh.firstIndex + firstIndex, (GLint)mesh.firstVertex, (GLuint)commands_.size()});
+		drawData_.push_back({model, textureLayer, {}});
+	}
+
+	// Envoyer les commandes et les données des objets au GPU. Les tampons ne sont réalloués que s'ils doivent grandir.
+	void upload() {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_);
+		uploadToBuffer(GL_SHADER_STORAGE_BUFFER, drawData_.data(), drawData_.size() * sizeof(DrawData), ssboCapacity_, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer_);
+		uploadToBuffer(GL_DRAW_INDIRECT_BUFFER, commands_.data(), commands_.size() * sizeof(DrawElementsIndirectCommand), indirectCapacity_, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	// Tracer tous les objets du lot en un appel. Le programme de nuanceur doit être actif, avec drawOffset à 0.
+	void draw(const MeshPool& pool, GLenum drawMode = GL_TRIANGLES) const {
+		if (commands_.empty())
+			return;
+		pool.bind();
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, drawDataBinding_, ssbo_);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer_);
+		glMultiDrawElementsIndirect(drawMode, pool.getIndexType(), nullptr, (GLsizei)commands_.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		pool.unbind();
+	}
+
+	void deleteObjects() {
+		glDeleteBuffers(1, &ssbo_);
+		glDeleteBuffers(1, &indirectBuffer_);
+		ssbo_ = indirectBuffer_ = 0;
+		ssboCapacity_ = indirectCapacity_ = 0;
+	}
+
+private:
+	std::vector<DrawElementsIndirectCommand> commands_;
+	std::vector<DrawData> drawData_;
+	GLuint ssbo_ = 0;
+	GLuint indirectBuffer_ = 0;
+	size_t ssboCapacity_ = 0;
+	size_t indirectCapacity_ = 0;
+	GLuint drawDataBinding_ = 0;
+};
@@ -4,8 +4,14 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <algorithm>
+#include <cstring>
+#include <format>
 #include <fstream>
+#include <iostream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <glbinding/gl/gl.h>
@@ -14,39 +20,37 @@
 #include <tiny_obj_loader.h>
 
 #include "utils.hpp"
+#include "Bvh.hpp"
+#include "Culling.hpp"
+#include "MeshNormals.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "StreamingBuffer.hpp"
+#include "VertexFormat.hpp"
+#include "WavefrontParser.hpp"
 
 
 using namespace gl;
 using namespace glm;
 
 
-// Configurer l'attribut de sommets pour un membre scalaire `member` (int, float) d'une struct `elemType`.
-#define SET_SCALAR_VERTEX_ATTRIB_FROM_STRUCT_MEM(index, elemType, member)	\
-{																			\
-	glVertexAttribPointer(													\
-		(GLuint)index,														\
-		1,																	\
-		getTypeGLenum_v<decltype(elemType::member)>,						\
-		GL_FALSE,															\
-		(GLint)sizeof(elemType),											\
-		(const void*)offsetof(elemType, member)								\
-	);																		\
-	glEnableVertexAttribArray(index);										\
-}																			\
-
-// Configurer l'attribut de sommets pour un membre vectoriel `member` (vec3, vec4) d'une struct `elemType`.
-#define SET_VEC_VERTEX_ATTRIB_FROM_STRUCT_MEM(index, elemType, member)	\
-{																		\
-	glVertexAttribPointer(												\
-		(GLuint)index,													\
-		(GLint)decltype(elemType::member)::length(),					\
-		getTypeGLenum_v<decltype(elemType::member)::value_type>,		\
-		GL_FALSE,														\
-		(GLint)sizeof(elemType),										\
-		(const void*)offsetof(elemType, member)							\
-	);																	\
-	glEnableVertexAttribArray(index);									\
-}																		\
+// Envoyer un tableau d'indices dans le tampon GL_ELEMENT_ARRAY_BUFFER lié. Si tous les indices tiennent sur 16 bits (donc moins de 65536 sommets), ils sont envoyés en GLushort : moitié moins de mémoire et de bande passante. On évite 0xFFFF, qui est l'index de redémarrage de primitive fixe. Retourne le type d'indices à passer à glDrawElements.
+inline GLenum uploadIndexBuffer(const std::vector<GLuint>& indices, GLenum usageMode, size_t& capacity) {
+	GLuint maxIndex = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+	if (maxIndex < 0xFFFF) {
+		std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+		uploadToBuffer(GL_ELEMENT_ARRAY_BUFFER, shortIndices.data(), shortIndices.size() * sizeof(GLushort), capacity, usageMode);
+		return GL_UNSIGNED_SHORT;
+	} else {
+		uploadToBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.data(), indices.size() * sizeof(GLuint), capacity, usageMode);
+		return GL_UNSIGNED_INT;
+	}
+}
+
+inline GLenum uploadIndexBuffer(const std::vector<GLuint>& indices, GLenum usageMode) {
+	size_t capacity = 0;
+	return uploadIndexBuffer(indices, usageMode, capacity);
+}
 
 
 // Informations de base d'un sommet
@@ -57,6 +61,74 @@ struct VertexData
 	vec2 texCoords; // layout(location = 2)
 };
 
+template <>
+struct VertexAttribList<VertexData>
+{
+	static constexpr std::array attribs = {
+		VERTEX_ATTRIB(0, VertexData, position),
+		VERTEX_ATTRIB(1, VertexData, normal),
+		VERTEX_ATTRIB(2, VertexData, texCoords),
+	};
+};
+
+// Données d'une instance pour Mesh::drawInstanced. Les attributs d'instance commencent à la localisation 4, ce qui laisse la localisation 3 libre pour un attribut de sommet propre à un exemple.
+struct InstanceData
+{
+	mat4 model;          // layout(location = 4) in mat4 (une localisation par colonne, donc 4 à 7)
+	vec4 color;          // layout(location = 8), par exemple la couleur de sélection qui encode l'ID
+	GLuint id;           // layout(location = 9) in uint
+	GLuint textureLayer; // layout(location = 10) in uint
+};
+
+inline constexpr GLuint instanceAttribLocation = 4;
+
+// Les tangentes (voir Mesh::generateTangents) sont dans leur propre tampon, à la localisation 3 : layout(location = 3) in vec4 a_tangent. Elles ne sont configurées que si le mesh en a, donc un exemple qui utilise déjà la localisation 3 pour autre chose ne doit pas en générer.
+inline constexpr GLuint tangentAttribLocation = 3;
+
+// Comparaison et hachage bit à bit d'un VertexData. VertexData n'a pas de bourrage (8 floats), on peut donc comparer et hacher directement ses octets. Sert à la soudure des sommets identiques avec une table de hachage.
+struct VertexDataBitwiseEqual
+{
+	bool operator() (const VertexData& a, const VertexData& b) const {
+		return std::memcmp(&a, &b, sizeof(VertexData)) == 0;
+	}
+};
+
+struct VertexDataHash
+{
+	size_t operator() (const VertexData& v) const {
+		return std::hash<std::string_view>()(std::string_view((const char*)&v, sizeof(VertexData)));
+	}
+};
+
+// Entête d'un fichier de cache binaire de mesh. Le fichier contient l'entête, suivi d'un MeshCacheEntry par mesh, suivi des tableaux de sommets, d'indices et de niveaux de détail de chaque mesh mis bout à bout (dans l'ordre des entrées).
+struct MeshCacheHeader
+{
+	char magic[4]; // Toujours "I27M".
+	uint32_t version; // Incrémenté à chaque changement du format (incluant VertexData).
+	uint64_t sourceHash; // Hash du fichier source. Si le fichier source change, le cache est invalide.
+	uint32_t numMeshes;
+	uint32_t indexed; // Mode de chargement utilisé pour générer le cache.
+	uint32_t maxLods; // Nombre maximal de niveaux de détail demandé pour générer le cache (0 si aucun).
+};
+
+struct MeshCacheEntry
+{
+	uint64_t numVertices;
+	uint64_t numIndices;
+	uint64_t numLods;
+};
+
+inline constexpr char meshCacheMagic[4] = {'I', '2', '7', 'M'};
+inline constexpr uint32_t meshCacheVersion = 2;
+
+// Un niveau de détail d'un mesh : une plage du tableau d'indices. Tous les niveaux partagent les mêmes sommets.
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t numIndices;
+	float error; // Erreur géométrique maximale par rapport au mesh complet, dans les unités du mesh.
+};
+
 // Un mesh (ou maillage) représente la géométrie d'un objet d'une façon traçable par OpenGL.
 struct Mesh
 {
@@ -65,6 +137,36 @@ struct Mesh
 	GLuint vao = 0;
 	GLuint vbo = 0;
 	GLuint ebo = 0;
+	GLenum indexType = GL_UNSIGNED_INT; // Choisi par updateBuffers() selon la valeur maximale des indices.
+	// La disposition des sommets dans le VBO (voir VertexLayout). Les dispositions autres qu'entrelacée sont pour les meshes statiques : les mises à jour partielles renvoient tout et le mode de diffusion est toujours entrelacé.
+	VertexLayout vertexLayout = VertexLayout::Interleaved;
+	// Les niveaux de détail (voir generateLods). S'il y en a, le niveau 0 est le mesh complet et les indices des niveaux simplifiés sont placés à la suite dans le tableau d'indices.
+	std::vector<MeshLod> lods;
+	// Boîte englobante alignée sur les axes et sphère englobante, en coordonnées de l'objet (voir computeBounds).
+	vec3 boundsMin = vec3(0);
+	vec3 boundsMax = vec3(0);
+	vec3 boundsCenter = vec3(0);
+	float boundsRadius = 0;
+	// Hiérarchie de volumes englobants des triangles, pour le lancer de rayons sur le CPU (voir buildBvh).
+	TriangleBvh bvh;
+	// Taille allouée des tampons en octets. updateBuffers() ne réalloue que si les données ne tiennent plus.
+	size_t vboCapacity = 0;
+	size_t eboCapacity = 0;
+	// Les éléments modifiés depuis le dernier envoi (voir markVerticesDirty et updateDirtyRanges).
+	DirtyRanges dirtyVertices;
+	DirtyRanges dirtyIndices;
+	// Le tampon en anneau des sommets envoyés à chaque trame (voir setupStreaming), et le premier sommet de la région courante.
+	StreamingRingBuffer streamingVbo;
+	GLint streamingBaseVertex = 0;
+	// Les instances tracées par drawInstanced() et leur tampon (voir updateInstances). instanceAttribsFirst est l'instance sur laquelle pointent les attributs d'instance du VAO.
+	std::vector<InstanceData> instances;
+	GLuint instanceVbo = 0;
+	size_t instanceVboCapacity = 0;
+	size_t instanceAttribsFirst = SIZE_MAX;
+	// Une tangente par sommet (xyz, et l'orientation de la bitangente dans w), vide si elles n'ont pas été générées. Envoyées par updateBuffers() dans tangentVbo.
+	std::vector<vec4> tangents;
+	GLuint tangentVbo = 0;
+	size_t tangentVboCapacity = 0;
 
 	void setup(GLenum usageMode = GL_STATIC_DRAW) {
 		// Créer les buffer objects.
@@ -77,15 +179,22 @@ struct Mesh
 
 		// Mettre les données dans les tampons en mémoire graphique.
 		updateBuffers(usageMode);
+		// Calculer les volumes englobants pour l'élimination hors champ et les niveaux de détail.
+		computeBounds();
 		// Configurer les attributs selon la struct VertexData.
 		setupAttribs();
 	}
 
 	void draw(GLenum drawMode = GL_TRIANGLES) {
+		// Un mesh pas encore configuré (par exemple encore en chargement, voir AssetLoader) n'est simplement pas tracé.
+		if (vao == 0)
+			return;
 		bindVao();
 
-		// Avoir un tableau d'indices vide ou non indique si on veut dessiner avec les données directement ou avec un tableau de connectivité.
-		if (not indices.empty())
+		// Avoir un tableau d'indices vide ou non indique si on veut dessiner avec les données directement ou avec un tableau de connectivité. S'il y a des niveaux de détail, seul le niveau complet est tracé.
+		if (not lods.empty())
+			drawElements(drawMode, (GLsizei)lods[0].numIndices);
+		else if (not indices.empty())
 			drawElements(drawMode, (GLsizei)indices.size());
 		else
 			drawArrays(drawMode);
@@ -97,41 +206,248 @@ struct Mesh
 		// Techniquement, on n'a pas besoin de refaire les glBindBuffer, mais ça ne coûte pas cher et c'est plus fiable de les refaire.
 		bindVbo();
 		// Tracer selon le tampon de données.
-		glDrawArrays(drawMode, offset, (GLsizei)vertices.size());
+		glDrawArrays(drawMode, streamingBaseVertex + offset, (GLsizei)vertices.size());
+		if (isStreaming())
+			streamingVbo.fenceCurrentRegion();
 	}
 
 	void drawElements(GLenum drawMode, GLsizei numIndices, GLsizei offset = 0) {
 		// Techniquement, on n'a pas besoin de refaire les glBindBuffer, mais ça ne coûte pas cher et c'est plus fiable de les refaire.
 		bindEbo();
-		// Tracer selon le tampon d'indices.
-		glDrawElements(drawMode, numIndices, GL_UNSIGNED_INT, (const void*)(size_t)offset);
+		// Tracer selon le tampon d'indices. En mode de diffusion, les indices sont relatifs au début de la région courante du tampon en anneau.
+		if (isStreaming()) {
+			glDrawElementsBaseVertex(drawMode, numIndices, indexType, (const void*)(size_t)offset, streamingBaseVertex);
+			streamingVbo.fenceCurrentRegion();
+		} else {
+			glDrawElements(drawMode, numIndices, indexType, (const void*)(size_t)offset);
+		}
 	}
 
+	// Tracer un niveau de détail donné (voir generateLods et selectLod).
+	void drawLod(int level, GLenum drawMode = GL_TRIANGLES) {
+		if (lods.empty()) {
+			draw(drawMode);
+			return;
+		}
+		auto& lod = lods[std::clamp(level, 0, (int)lods.size() - 1)];
+		GLsizei indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		bindVao();
+		drawElements(drawMode, (GLsizei)lod.numIndices, (GLsizei)lod.firstIndex * indexSize);
+		unbindVao();
+	}
+
+	// Choisir puis tracer le niveau de détail selon la taille de l'objet à l'écran.
+	void drawLod(const mat4& modelView, const mat4& projection, float viewportHeight, float maxPixelError = 1.0f, GLenum drawMode = GL_TRIANGLES) {
+		drawLod(selectLod(modelView, projection, viewportHeight, maxPixelError), drawMode);
+	}
+
+	// Tracer numInstances copies du mesh en un seul appel, à partir de l'instance firstInstance du tableau instances (envoyé avec updateInstances). Le nuanceur de sommets reçoit les données de chaque instance dans les attributs de InstanceData.
+	void drawInstanced(GLenum drawMode = GL_TRIANGLES, size_t firstInstance = 0, size_t numInstances = SIZE_MAX) {
+		// Sans tampon d'instances (updateInstances jamais appelé), les attributs d'instance ne pointeraient sur rien.
+		if (vao == 0 or instanceVbo == 0 or firstInstance >= instances.size())
+			return;
+		numInstances = std::min(numInstances, instances.size() - firstInstance);
+		// OpenGL 4.1 n'a pas de baseInstance dans les tracés instanciés. Pour tracer une plage d'instances, on décale plutôt le début des attributs d'instance dans le tampon.
+		if (firstInstance != instanceAttribsFirst)
+			setupInstanceAttribs(firstInstance);
+
+		bindVao();
+		if (not indices.empty()) {
+			bindEbo();
+			GLsizei numIndices = lods.empty() ? (GLsizei)indices.size() : (GLsizei)lods[0].numIndices;
+			if (isStreaming())
+				glDrawElementsInstancedBaseVertex(drawMode, numIndices, indexType, nullptr, (GLsizei)numInstances, streamingBaseVertex);
+			else
+				glDrawElementsInstanced(drawMode, numIndices, indexType, nullptr, (GLsizei)numInstances);
+		} else {
+			bindVbo();
+			glDrawArraysInstanced(drawMode, streamingBaseVertex, (GLsizei)vertices.size(), (GLsizei)numInstances);
+		}
+		if (isStreaming())
+			streamingVbo.fenceCurrentRegion();
+		unbindVao();
+	}
+
+	// Le mesh (transformé par la matrice de modélisation model) touche-t-il le volume de vue? Le frustum est celui de projection * view (voir Culling.hpp). Ajoute le résultat aux compteurs de stats s'il est donné.
+	bool isVisible(const Frustum& frustum, const mat4& model, CullingStats* stats = nullptr) const {
+		vec3 center, extent;
+		getWorldBox(model, center, extent);
+		bool result = frustum.isBoxVisible(center, extent);
+		if (stats != nullptr) {
+			stats->numTested++;
+			stats->numCulled += not result;
+		}
+		return result;
+	}
+
+	// Tracer le mesh seulement s'il touche le volume de vue. Retourne vrai s'il a été tracé.
+	bool drawIfVisible(const Frustum& frustum, const mat4& model, CullingStats* stats = nullptr, GLenum drawMode = GL_TRIANGLES) {
+		if (not isVisible(frustum, model, stats))
+			return false;
+		draw(drawMode);
+		return true;
+	}
+
+	// La boîte englobante en coordonnées du monde (centre et demi-étendue), pour une matrice de modélisation donnée. Sert aussi à remplir un BoundingBoxBatch pour éliminer plusieurs objets à la fois.
+	void getWorldBox(const mat4& model, vec3& center, vec3& extent) const {
+		transformBox(model, (boundsMin + boundsMax) * 0.5f, (boundsMax - boundsMin) * 0.5f, center, extent);
+	}
+
+	// Envoyer tous les sommets et les indices. Les tampons gardent leur capacité tant que les données y tiennent et sont rendus orphelins avant l'envoi (voir uploadToBuffer), donc appeler updateBuffers() à chaque trame ne fait ni agrandissement ni attente après les tracés précédents.
 	void updateBuffers(GLenum usageMode = GL_STATIC_DRAW) {
 		bindVao();
 		bindVbo();
 		bindEbo();
 
-		if (not vertices.empty()) {
-			auto numBytes = vertices.size() * sizeof(VertexData);
-			glBufferData(GL_ARRAY_BUFFER, numBytes, vertices.data(), usageMode);
+		bool isInterleaved = vertexLayout == VertexLayout::Interleaved;
+		if (not vertices.empty() and not isStreaming()) {
+			if (isInterleaved) {
+				auto numBytes = vertices.size() * sizeof(VertexData);
+				uploadToBuffer(GL_ARRAY_BUFFER, vertices.data(), numBytes, vboCapacity, usageMode);
+			} else {
+				std::vector<std::byte> packed;
+				visitVertexLayout<VertexData>(vertexLayout, [&](auto format) {
+					packed.resize(format.getBufferSize(vertices.size()));
+					format.pack(vertices.data(), vertices.size(), packed.data());
+				});
+				uploadToBuffer(GL_ARRAY_BUFFER, packed.data(), packed.size(), vboCapacity, usageMode);
+				// La position des flux dépend du nombre de sommets, il faut donc relier le tampon (le format ne change pas).
+				if (vao != 0)
+					visitVertexLayout<VertexData>(vertexLayout, [&](auto format) { format.bindVertexBuffer(vbo, vertices.size()); });
+			}
 		}
-		if (not indices.empty()) {
-			auto numBytes = indices.size() * sizeof(GLuint);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, numBytes, indices.data(), usageMode);
+		if (tangents.size() == vertices.size() and not tangents.empty() and not isStreaming()) {
+			if (tangentVbo == 0)
+				glGenBuffers(1, &tangentVbo);
+			glBindBuffer(GL_ARRAY_BUFFER, tangentVbo);
+			uploadToBuffer(GL_ARRAY_BUFFER, tangents.data(), tangents.size() * sizeof(vec4), tangentVboCapacity, usageMode);
+			glVertexAttribPointer(tangentAttribLocation, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), nullptr);
+			glEnableVertexAttribArray(tangentAttribLocation);
 		}
+		if (not indices.empty())
+			indexType = uploadIndexBuffer(indices, usageMode, eboCapacity);
+		dirtyVertices.clear();
+		dirtyIndices.clear();
 
 		unbindVao();
 	}
 
-	void setupAttribs() {
+	// Indiquer que count sommets (ou indices) à partir de first ont été modifiés ou ajoutés. Ils seront envoyés au prochain updateDirtyRanges().
+	void markVerticesDirty(size_t first, size_t count) { dirtyVertices.add(first, count); }
+	void markIndicesDirty(size_t first, size_t count) { dirtyIndices.add(first, count); }
+
+	// Envoyer seulement les plages de sommets et d'indices marquées comme modifiées, avec un glBufferSubData par plage (les plages proches sont fusionnées). Si les tableaux ne tiennent plus dans les tampons, ou si un nouvel indice ne tient plus sur 16 bits, tout est renvoyé avec updateBuffers().
+	void updateDirtyRanges(size_t mergeGap = 16) {
+		if (dirtyVertices.isEmpty() and dirtyIndices.isEmpty())
+			return;
+		auto& vertexRanges = dirtyVertices.getMerged(mergeGap);
+		auto& indexRanges = dirtyIndices.getMerged(mergeGap);
+
+		size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		bool needsFullUpload = vertices.size() * sizeof(VertexData) > vboCapacity or indices.size() * indexSize > eboCapacity;
+		// Dans les autres dispositions, les attributs d'un sommet ne sont pas contigus.
+		needsFullUpload = needsFullUpload or (vertexLayout != VertexLayout::Interleaved and not vertexRanges.empty());
+		if (indexType == GL_UNSIGNED_SHORT) {
+			for (auto&& [begin, end] : indexRanges) {
+				for (size_t i = begin; i < std::min(end, indices.size()) and not needsFullUpload; i++)
+					needsFullUpload = indices[i] >= 0xFFFF;
+			}
+		}
+		if (needsFullUpload) {
+			updateBuffers(GL_DYNAMIC_DRAW);
+			return;
+		}
+
 		bindVao();
 		bindVbo();
+		bindEbo();
+
+		for (auto&& [begin, end] : vertexRanges) {
+			size_t last = std::min(end, vertices.size());
+			if (begin < last and not isStreaming())
+				glBufferSubData(GL_ARRAY_BUFFER, begin * sizeof(VertexData), (last - begin) * sizeof(VertexData), &vertices[begin]);
+		}
+		std::vector<GLushort> shortIndices;
+		for (auto&& [begin, end] : indexRanges) {
+			size_t last = std::min(end, indices.size());
+			if (begin >= last)
+				continue;
+			if (indexType == GL_UNSIGNED_SHORT) {
+				shortIndices.assign(indices.begin() + begin, indices.begin() + last);
+				glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, begin * sizeof(GLushort), shortIndices.size() * sizeof(GLushort), shortIndices.data());
+			} else {
+				glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, begin * sizeof(GLuint), (last - begin) * sizeof(GLuint), &indices[begin]);
+			}
+		}
+		dirtyVertices.clear();
+		dirtyIndices.clear();
+
+		unbindVao();
+	}
 
-		// Les données des sommets (positions, normales, coords de textures) sont placées ensembles dans le même tampon, de façon contigües. Les attributs sont configurés pour accéder à un membre de VertexData dans chaque élément.
-		SET_VEC_VERTEX_ATTRIB_FROM_STRUCT_MEM(0, VertexData, position);
-		SET_VEC_VERTEX_ATTRIB_FROM_STRUCT_MEM(1, VertexData, normal);
-		SET_VEC_VERTEX_ATTRIB_FROM_STRUCT_MEM(2, VertexData, texCoords);
+	// Passer en mode de diffusion (streaming) pour la géométrie entièrement recalculée à chaque trame : les sommets (au plus maxVertices) sont envoyés avec streamVertices() dans un tampon en anneau au lieu du VBO (voir StreamingRingBuffer). Les indices, s'il y en a, restent dans l'EBO et sont envoyés avec updateBuffers().
+	void setupStreaming(size_t maxVertices) {
+		if (vao == 0)
+			glGenVertexArrays(1, &vao);
+		if (ebo == 0)
+			glGenBuffers(1, &ebo);
+		streamingVbo.create(GL_ARRAY_BUFFER, std::max(maxVertices, size_t(1)) * sizeof(VertexData));
+		streamingBaseVertex = 0;
+		vertexLayout = VertexLayout::Interleaved;
+		// Les attributs pointent maintenant sur le tampon en anneau (voir bindVbo).
+		setupAttribs();
+	}
+
+	bool isStreaming() const { return streamingVbo.getBuffer() != 0; }
+
+	// Copier les sommets dans la prochaine région du tampon en anneau. À appeler une fois par trame, avant les tracés. Le tampon est recréé deux fois plus grand si les sommets n'y tiennent plus.
+	void streamVertices() {
+		size_t numBytes = vertices.size() * sizeof(VertexData);
+		if (not isStreaming() or numBytes > streamingVbo.getRegionSize())
+			setupStreaming(std::max(vertices.size(), 2 * streamingVbo.getRegionSize() / sizeof(VertexData)));
+		void* data = streamingVbo.beginWrite();
+		if (numBytes > 0)
+			std::memcpy(data, vertices.data(), numBytes);
+		streamingVbo.endWrite(numBytes);
+		streamingBaseVertex = GLint(streamingVbo.getRegionOffset() / sizeof(VertexData));
+	}
+
+	// Envoyer le tableau instances dans le tampon d'instances (créé et attaché au VAO au premier appel). Le tampon n'est agrandi que si les instances n'y tiennent plus. Il est rendu orphelin avant chaque envoi (voir uploadToBuffer) : on peut donc appeler updateInstances() plusieurs fois par trame, par exemple une fois par passe, sans attendre que le GPU ait fini de lire les instances de la passe précédente.
+	void updateInstances(GLenum usageMode = GL_DYNAMIC_DRAW) {
+		if (instanceVbo == 0)
+			glGenBuffers(1, &instanceVbo);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+		uploadToBuffer(GL_ARRAY_BUFFER, instances.data(), instances.size() * sizeof(InstanceData), instanceVboCapacity, usageMode);
+		if (instanceAttribsFirst == SIZE_MAX)
+			setupInstanceAttribs(0);
+	}
+
+	// Configurer les attributs d'instance (diviseur de 1 : ils avancent d'un élément par instance plutôt que par sommet) pour qu'ils commencent à l'instance firstInstance.
+	void setupInstanceAttribs(size_t firstInstance) {
+		bindVao();
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+		auto attribOffset = [&](size_t memberOffset) { return (const void*)(firstInstance * sizeof(InstanceData) + memberOffset); };
+		for (GLuint col = 0; col < 4; col++)
+			glVertexAttribPointer(instanceAttribLocation + col, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), attribOffset(offsetof(InstanceData, model) + col * sizeof(vec4)));
+		glVertexAttribPointer(instanceAttribLocation + 4, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), attribOffset(offsetof(InstanceData, color)));
+		glVertexAttribIPointer(instanceAttribLocation + 5, 1, GL_UNSIGNED_INT, sizeof(InstanceData), attribOffset(offsetof(InstanceData, id)));
+		glVertexAttribIPointer(instanceAttribLocation + 6, 1, GL_UNSIGNED_INT, sizeof(InstanceData), attribOffset(offsetof(InstanceData, textureLayer)));
+		for (GLuint i = 0; i < 7; i++) {
+			glEnableVertexAttribArray(instanceAttribLocation + i);
+			glVertexAttribDivisor(instanceAttribLocation + i, 1);
+		}
+		unbindVao();
+		instanceAttribsFirst = firstInstance;
+	}
+
+	void setupAttribs() {
+		bindVao();
+
+		// Les données des sommets (positions, normales, coords de textures) sont placées ensembles dans le même tampon, selon la disposition du mesh. Les attributs sont configurés à partir de la description de VertexData (voir VertexAttribList). Les flux utilisent les points de liaison à partir de 0 ; les attributs d'instance, configurés avec glVertexAttribPointer, utilisent implicitement les points de liaison de leurs localisations (4 et plus).
+		visitVertexLayout<VertexData>(vertexLayout, [&](auto format) {
+			format.setupAttribFormats();
+			format.bindVertexBuffer(isStreaming() ? streamingVbo.getBuffer() : vbo, vertices.size());
+		});
 
 		unbindVao();
 	}
@@ -141,15 +457,314 @@ struct Mesh
 		glDeleteBuffers(1, &vbo);
 		glDeleteBuffers(1, &ebo);
 		vao = vbo = ebo = 0;
+		vboCapacity = eboCapacity = 0;
+		streamingVbo.deleteObjects();
+		streamingBaseVertex = 0;
+		glDeleteBuffers(1, &instanceVbo);
+		instanceVbo = 0;
+		instanceVboCapacity = 0;
+		instanceAttribsFirst = SIZE_MAX;
+		glDeleteBuffers(1, &tangentVbo);
+		tangentVbo = 0;
+		tangentVboCapacity = 0;
 	}
 
 	void bindVao() { glBindVertexArray(vao); }
 	void unbindVao() { glBindVertexArray(0); }
-	void bindVbo() { glBindBuffer(GL_ARRAY_BUFFER, vbo); }
+	void bindVbo() { glBindBuffer(GL_ARRAY_BUFFER, isStreaming() ? streamingVbo.getBuffer() : vbo); }
 	void bindEbo() { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo); }
 
-	// Charge des mesh d'objets à partir d'un fichier Wavefront (il peut y avoir plusieurs objets dans le même fichier). Les données sont chargées par sommet sans tableau d'indices.
-	static std::vector<Mesh> loadFromWavefrontFile(std::string_view filename, bool setupOnLoad = true) {
+	// Calculer la boîte englobante du mesh et sa sphère englobante (centre de la boîte, rayon jusqu'au sommet le plus loin). Appelée par setup().
+	void computeBounds() {
+		if (vertices.empty()) {
+			boundsMin = boundsMax = boundsCenter = vec3(0);
+			boundsRadius = 0;
+			return;
+		}
+		boundsMin = vertices[0].position;
+		boundsMax = vertices[0].position;
+		for (auto&& v : vertices) {
+			boundsMin = min(boundsMin, v.position);
+			boundsMax = max(boundsMax, v.position);
+		}
+		boundsCenter = (boundsMin + boundsMax) * 0.5f;
+		float maxDistance2 = 0;
+		for (auto&& v : vertices)
+			maxDistance2 = std::max(maxDistance2, dot(v.position - boundsCenter, v.position - boundsCenter));
+		boundsRadius = std::sqrt(maxDistance2);
+	}
+
+	// Générer une chaîne de niveaux de détail par simplification (voir MeshSimplifier.hpp). Chaque niveau vise reductionPerLevel fois les triangles du précédent, et on arrête quand la simplification n'avance plus ou que l'erreur dépasserait maxRelativeError fois le rayon de l'objet. Les indices de chaque niveau sont réordonnés pour le cache de sommets.
+	// Les niveaux sont ajoutés à la suite du tableau d'indices, donc il faut appeler generateLods() après weldVertices() et optimize(), et avant setup() (ou appeler updateBuffers() après). Le mesh est soudé s'il n'a pas de tableau d'indices.
+	void generateLods(int maxLevels = 4, float reductionPerLevel = 0.5f, float maxRelativeError = 0.1f) {
+		if (indices.empty())
+			weldVertices();
+		dropLods();
+		computeBounds();
+
+		lods.push_back({0, (uint32_t)indices.size(), 0});
+		std::vector<GLuint> current = indices;
+		float maxError = maxRelativeError * boundsRadius;
+		for (int level = 1; level < maxLevels and lods.back().error < maxError; level++) {
+			size_t target = size_t(current.size() / 3 * reductionPerLevel) * 3;
+			float levelError = 0;
+			std::vector<GLuint> simplified = simplifyIndices(
+				current, vertices.size(),
+				[&](GLuint i) { return vertices[i].position; },
+				[&](GLuint i) { return vertices[i].normal; },
+				[&](GLuint i) { return vertices[i].texCoords; },
+				target, maxError - lods.back().error, levelError
+			);
+			// Pas assez de progrès : on a atteint la limite d'erreur ou de topologie.
+			if (simplified.empty() or simplified.size() > current.size() * 9 / 10)
+				break;
+
+			std::vector<size_t> hardBoundaries;
+			simplified = tipsifyIndices(simplified, vertices.size(), 16, hardBoundaries);
+			// L'erreur d'un niveau est bornée par la somme des erreurs des simplifications successives.
+			lods.push_back({(uint32_t)indices.size(), (uint32_t)simplified.size(), lods.back().error + levelError});
+			indices.insert(indices.end(), simplified.begin(), simplified.end());
+			current = std::move(simplified);
+		}
+	}
+
+	// Construire la BVH des triangles du mesh (GL_TRIANGLES, avec ou sans tableau d'indices; seulement le niveau de détail complet). Il faut la reconstruire si les sommets changent.
+	void buildBvh() {
+		size_t numCorners = not lods.empty() ? lods[0].numIndices : not indices.empty() ? indices.size() : vertices.size();
+		bvh.build(numCorners / 3, [&](size_t triangle, int corner) {
+			size_t i = 3 * triangle + corner;
+			return indices.empty() ? vertices[i].position : vertices[indices[i]].position;
+		});
+	}
+
+	// Lancer un rayon (en coordonnées du monde) sur le mesh transformé par la matrice de modélisation model. Retourne vrai si le rayon touche le mesh plus près que hit.distance, et met alors à jour hit (triangle, barycentriques et distance le long du rayon). On peut donc appeler raycast() sur plusieurs objets avec le même hit pour trouver le plus proche. buildBvh() doit avoir été appelée.
+	bool raycast(const Ray& ray, const mat4& model, RayHit& hit) const {
+		// Tester la boîte englobante avant de transformer le rayon.
+		vec3 center, extent;
+		getWorldBox(model, center, extent);
+		if (intersectBox(ray, 1.0f / ray.direction, center - extent, center + extent, hit.distance) >= hit.distance)
+			return false;
+		// Le rayon transformé dans le repère de l'objet garde les mêmes t, donc les distances restent comparables entre objets.
+		return bvh.intersect(ray.transformed(inverse(model)), hit);
+	}
+
+	// Enlever les niveaux de détail et leurs indices.
+	void dropLods() {
+		if (lods.empty())
+			return;
+		indices.resize(lods[0].numIndices);
+		lods.clear();
+	}
+
+	// Choisir le niveau de détail le plus simple dont l'erreur projetée à l'écran ne dépasse pas maxPixelError pixels. modelView et projection sont les matrices utilisées pour tracer l'objet (typiquement view * model et la projection d'un TransformStack), viewportHeight est la hauteur en pixels du viewport.
+	int selectLod(const mat4& modelView, const mat4& projection, float viewportHeight, float maxPixelError = 1.0f) const {
+		if (lods.size() <= 1)
+			return 0;
+
+		// La mise à l'échelle maximale de la matrice de modélisation agrandit la sphère englobante et les erreurs.
+		float scale = std::sqrt(std::max({
+			dot(vec3(modelView[0]), vec3(modelView[0])),
+			dot(vec3(modelView[1]), vec3(modelView[1])),
+			dot(vec3(modelView[2]), vec3(modelView[2]))
+		}));
+		float radius = boundsRadius * scale;
+		// Nombre de pixels par unité de distance à la profondeur du centre de l'objet. En perspective (w dépend de z), on divise par la distance. Si la caméra est dans la sphère, on prend le niveau complet.
+		float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+		if (projection[3][3] == 0) {
+			float distance = -vec3(modelView * vec4(boundsCenter, 1)).z;
+			if (distance <= radius)
+				return 0;
+			pixelsPerUnit /= distance;
+		}
+
+		int level = 0;
+		for (int i = 1; i < (int)lods.size(); i++) {
+			if (lods[i].error * scale * pixelsPerUnit <= maxPixelError)
+				level = i;
+		}
+		return level;
+	}
+
+	// Souder les sommets identiques (même position, normale et coordonnées de texture) avec une table de hachage et remplir le tableau d'indices en conséquence. Fonctionne sur un mesh avec ou sans tableau d'indices. Le mesh est alors tracé avec glDrawElements, ce qui réduit la taille du VBO et permet au GPU de réutiliser les résultats du nuanceur de sommets (cache post-transformation).
+	void weldVertices() {
+		dropLods();
+		// Les sommets sont renumérotés, les tangentes sont donc à refaire.
+		tangents.clear();
+		std::vector<VertexData> oldVertices = std::move(vertices);
+		std::vector<GLuint> oldIndices = std::move(indices);
+		size_t numCorners = oldIndices.empty() ? oldVertices.size() : oldIndices.size();
+
+		vertices.clear();
+		indices.clear();
+		indices.reserve(numCorners);
+		// Table de hachage des sommets déjà ajoutés (sommet -> index dans vertices).
+		std::unordered_map<VertexData, GLuint, VertexDataHash, VertexDataBitwiseEqual> vertexToIndex;
+		vertexToIndex.reserve(numCorners);
+
+		for (size_t i = 0; i < numCorners; i++) {
+			auto& data = oldIndices.empty() ? oldVertices[i] : oldVertices[oldIndices[i]];
+			// Si le sommet a déjà été vu, réutiliser son index. Sinon, l'ajouter à la fin du tableau de sommets.
+			auto [it, isNew] = vertexToIndex.try_emplace(data, (GLuint)vertices.size());
+			if (isNew)
+				vertices.push_back(data);
+			indices.push_back(it->second);
+		}
+	}
+
+	// Donner à chaque coin de triangle son propre sommet et vider le tableau d'indices (l'inverse de weldVertices).
+	void unweldVertices() {
+		dropLods();
+		tangents.clear();
+		if (indices.empty())
+			return;
+		std::vector<VertexData> newVertices(indices.size());
+		parallelFor(indices.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				newVertices[i] = vertices[indices[i]];
+		}, minMeshItemsPerThread);
+		vertices = std::move(newVertices);
+		indices.clear();
+	}
+
+	// Remplacer les normales par les normales des triangles (ombrage plat). Chaque triangle reçoit ses propres sommets, le mesh n'a donc plus de tableau d'indices (comme un mesh chargé avec indexed = false). Il faut l'appeler avant setup() (ou appeler updateBuffers() après), comme les autres fonctions de cette section.
+	void generateFlatNormals() {
+		unweldVertices();
+		std::vector<vec3> faceNormals;
+		std::vector<float> cornerAngles;
+		computeFaceNormalsAndAngles(vertices.size() / 3, [&](size_t c) { return vertices[c].position; }, faceNormals, cornerAngles);
+		// S'il reste des sommets après le dernier triangle complet, ils ne font partie d'aucun triangle et gardent leur normale.
+		parallelFor(faceNormals.size() * 3, [&](size_t begin, size_t end) {
+			for (size_t c = begin; c < end; c++)
+				vertices[c].normal = faceNormals[c / 3];
+		}, minMeshItemsPerThread);
+	}
+
+	// Remplacer les normales par des normales lissées, pondérées par les angles des coins. Les normales des triangles adjacents qui font un angle de plus de creaseAngle degrés ne sont pas moyennées, l'arête reste donc vive (le sommet est dédoublé). Les coins sont regroupés par position seulement, donc les normales sont aussi lissées à travers les coutures de texture. Le mesh est ensuite soudé (voir weldVertices).
+	void generateSmoothNormals(float creaseAngle = 60.0f) {
+		unweldVertices();
+		size_t numCorners = vertices.size() - vertices.size() % 3;
+		auto positionOf = [&](size_t c) { return vertices[c].position; };
+		std::vector<vec3> faceNormals;
+		std::vector<float> cornerAngles;
+		computeFaceNormalsAndAngles(numCorners / 3, positionOf, faceNormals, cornerAngles);
+		size_t numPositions = 0;
+		auto positionOfCorner = weldCornerPositions(numCorners, positionOf, numPositions);
+		auto positionGroups = groupCorners(positionOfCorner, numPositions);
+		auto normals = computeSmoothCornerNormals(faceNormals, cornerAngles, positionOfCorner, positionGroups, creaseAngle);
+		parallelFor(numCorners, [&](size_t begin, size_t end) {
+			for (size_t c = begin; c < end; c++)
+				vertices[c].normal = normals[c];
+		}, minMeshItemsPerThread);
+		weldVertices();
+	}
+
+	// Générer les tangentes des sommets à partir des positions, des normales et des coordonnées de texture, pour le placage de normales (normal mapping). Voir computeVertexTangents pour la convention et ses limites aux joints en miroir. À appeler après les opérations qui renumérotent les sommets (weldVertices, generateSmoothNormals), qui effacent les tangentes.
+	void generateTangents() {
+		dropLods();
+		size_t numCorners = indices.empty() ? vertices.size() : indices.size();
+		numCorners -= numCorners % 3;
+		auto vertexOf = [&](size_t c) { return indices.empty() ? (GLuint)c : indices[c]; };
+		auto positionOf = [&](size_t c) { return vertices[vertexOf(c)].position; };
+		auto texCoordsOf = [&](size_t c) { return vertices[vertexOf(c)].texCoords; };
+
+		std::vector<vec3> faceNormals;
+		std::vector<float> cornerAngles;
+		computeFaceNormalsAndAngles(numCorners / 3, positionOf, faceNormals, cornerAngles);
+		std::vector<vec3> faceTangents, faceBitangents;
+		computeFaceTangents(numCorners / 3, positionOf, texCoordsOf, faceTangents, faceBitangents);
+
+		std::vector<GLuint> vertexOfCorner(numCorners);
+		for (size_t c = 0; c < numCorners; c++)
+			vertexOfCorner[c] = vertexOf(c);
+		auto vertexGroups = groupCorners(vertexOfCorner, vertices.size());
+		tangents = computeVertexTangents(vertexGroups, [&](size_t v) { return vertices[v].normal; }, faceTangents, faceBitangents, cornerAngles);
+	}
+
+	// Réordonner les triangles et les sommets d'un mesh de triangles (GL_TRIANGLES) pour qu'il soit tracé plus efficacement (voir MeshOptimizer.hpp) :
+	//   1. Les triangles sont réordonnés pour la localité dans le cache post-transformation (Tipsify), donc moins d'exécutions du nuanceur de sommets.
+	//   2. Les grappes de triangles obtenues sont réordonnées pour réduire le surdessinage, donc moins d'exécutions du nuanceur de fragments.
+	//   3. Les sommets sont renumérotés dans l'ordre d'utilisation pour que les lectures du VBO soient séquentielles.
+	// Si le mesh n'a pas de tableau d'indices, les sommets sont d'abord soudés. Il faut appeler optimize() avant setup() (ou appeler updateBuffers() après). Retourne (et affiche si printStats est vrai) l'ACMR et l'ATVR avant et après.
+	std::pair<VertexCacheStats, VertexCacheStats> optimize(int cacheSize = 16, bool printStats = true) {
+		if (indices.empty())
+			weldVertices();
+		dropLods();
+
+		VertexCacheStats before = simulateVertexCache(indices, vertices.size(), cacheSize);
+
+		std::vector<size_t> hardBoundaries;
+		indices = tipsifyIndices(indices, vertices.size(), cacheSize, hardBoundaries);
+		reorderTrianglesForOverdraw(indices, [&](GLuint i) { return vertices[i].position; }, hardBoundaries, cacheSize);
+
+		auto newToOld = reorderVerticesForFetch(indices, vertices.size());
+		std::vector<VertexData> newVertices(newToOld.size());
+		for (size_t i = 0; i < newToOld.size(); i++)
+			newVertices[i] = vertices[newToOld[i]];
+		vertices = std::move(newVertices);
+		if (tangents.size() == newToOld.size()) {
+			std::vector<vec4> newTangents(newToOld.size());
+			for (size_t i = 0; i < newToOld.size(); i++)
+				newTangents[i] = tangents[newToOld[i]];
+			tangents = std::move(newTangents);
+		}
+
+		VertexCacheStats after = simulateVertexCache(indices, vertices.size(), cacheSize);
+		if (printStats) {
+			std::cout << std::format(
+				"Mesh::optimize: {} triangles, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+				indices.size() / 3, before.acmr, after.acmr, before.atvr, after.atvr
+			) << "\n";
+		}
+		return {before, after};
+	}
+
+	// Charge des mesh d'objets à partir d'un fichier Wavefront (il peut y avoir plusieurs objets dans le même fichier).
+	// Si indexed est faux, les données sont chargées par sommet de face sans tableau d'indices (chaque triangle a ses trois sommets à lui).
+	// Si indexed est vrai, les sommets identiques sont soudés et le tableau d'indices est rempli (voir weldVertices).
+	// Le fichier est lu avec notre propre analyseur (voir WavefrontParser.hpp) qui écrit directement dans des tableaux dimensionnés d'avance et répartit le travail sur plusieurs fils pour les gros fichiers.
+	static std::vector<Mesh> loadFromWavefrontFile(std::string_view filename, bool setupOnLoad = true, bool indexed = false) {
+		WavefrontData data;
+		if (not parseWavefrontFile(filename, data)) {
+			std::cerr << std::format("ERROR WavefrontParser: {}: {}", filename, data.error) << "\n";
+			return {};
+		}
+
+		std::vector<Mesh> result;
+		result.reserve(data.objects.size());
+
+		// Pour chaque objet défini dans le fichier:
+		for (auto&& object : data.objects) {
+			Mesh mesh;
+			// Chaque coin de triangle devient un sommet. Le tableau est dimensionné d'avance, ce qui permet de remplir des plages disjointes en parallèle.
+			mesh.vertices.resize(object.numCorners);
+			parallelFor(object.numCorners, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					auto& corner = data.corners[object.firstCorner + i];
+					VertexData& vertex = mesh.vertices[i];
+					vertex = {};
+					// Copier la position.
+					vertex.position = data.positions[corner.x];
+					// Copier les coordonnées de texture si l'index est positif.
+					if (corner.y >= 0)
+						vertex.texCoords = data.texCoords[corner.y];
+					// Copier la normale si l'index de normales est positif.
+					if (corner.z >= 0)
+						vertex.normal = normalize(data.normals[corner.z]);
+				}
+			}, 1 << 16);
+
+			if (indexed)
+				mesh.weldVertices();
+			if (setupOnLoad)
+				mesh.setup();
+			result.push_back(std::move(mesh));
+		}
+
+		return result;
+	}
+
+	// Même chose que loadFromWavefrontFile, mais avec tinyobjloader. Plus lent sur les gros fichiers, mais on le garde comme référence et pour les fichiers que notre analyseur ne supporte pas.
+	static std::vector<Mesh> loadFromWavefrontFileWithTinyObj(std::string_view filename, bool setupOnLoad = true, bool indexed = false) {
 		// Code inspiré de l'exemple https://github.com/tinyobjloader/tinyobjloader/tree/release#example-code-new-object-oriented-api
 
 		// Lire le fichier et vérifier les erreurs. On le charge en spécifiant à tinyobjloader de faire la séparation en triangles des faces non triangulaires (des quadrilatères par exemple).
@@ -163,11 +778,14 @@ struct Mesh
 		if (not reader.Warning().empty())
 			std::cerr << "WARNING tinyobj::ObjReader: " << reader.Warning();
 
+		auto& attribs = reader.GetAttrib();
 		std::vector<Mesh> result;
 
 		// Pour chaque objet défini dans le fichier:
 		for (auto&& shape : reader.GetShapes()) {
 			Mesh mesh;
+			// On connait le nombre de coins de faces, donc on peut réserver la mémoire d'avance.
+			mesh.vertices.reserve(shape.mesh.indices.size());
 
 			size_t index_offset = 0;
 			// Pour chaque face:
@@ -177,7 +795,6 @@ struct Mesh
 					VertexData data = {};
 					// Obtenir les indices des éléments du sommet.
 					tinyobj::index_t idx = shape.mesh.indices[index_offset + v];
-					auto& attribs = reader.GetAttrib();
 
 					// Copier la position.
 					data.position = *(const vec3*)&attribs.vertices[3 * size_t(idx.vertex_index)];
@@ -194,6 +811,8 @@ struct Mesh
 				index_offset += numVertices;
 			}
 
+			if (indexed)
+				mesh.weldVertices();
 			if (setupOnLoad)
 				mesh.setup();
 			result.push_back(std::move(mesh));
@@ -201,5 +820,144 @@ struct Mesh
 
 		return result;
 	}
-};
 
+	// Comme loadFromWavefrontFile, mais passe par un cache binaire enregistré à côté du fichier source (avec l'extension .meshcache ajoutée). Au premier chargement, le fichier Wavefront est lu normalement et le cache est écrit. Aux chargements suivants, le cache est projeté en mémoire et les tableaux sont copiés directement, sans aucune analyse de texte. Si le fichier source change (son hash ne correspond plus), on revient automatiquement au chargement normal et le cache est réécrit.
+	// Si maxLods est plus grand que 1, les mesh sont chargés en mode indexé et une chaîne d'au plus maxLods niveaux de détail est générée (voir generateLods) puis enregistrée dans le cache avec le reste.
+	static std::vector<Mesh> loadFromWavefrontFileCached(std::string_view filename, bool setupOnLoad = true, bool indexed = false, int maxLods = 0) {
+		std::string cacheFilename = std::string(filename) + ".meshcache";
+
+		maxLods = std::max(maxLods, 0);
+		if (maxLods > 1)
+			indexed = true;
+
+		// Hacher le fichier source. S'il est impossible de l'ouvrir, on laisse le chargement normal rapporter l'erreur.
+		MappedFile source(filename);
+		if (not source.isOpen())
+			return loadFromWavefrontFile(filename, setupOnLoad, indexed);
+		uint64_t sourceHash = hashBytes(source.data(), source.size());
+		source.close();
+
+		std::vector<Mesh> result;
+		if (loadFromBinaryCache(cacheFilename, sourceHash, indexed, maxLods, result)) {
+			if (setupOnLoad) {
+				for (auto& mesh : result)
+					mesh.setup();
+			}
+			return result;
+		}
+
+		// Cache absent ou périmé : charger le fichier source sans faire le setup tout de suite, écrire le cache, puis faire le setup.
+		result = loadFromWavefrontFile(filename, false, indexed);
+		if (maxLods > 1) {
+			for (auto& mesh : result)
+				mesh.generateLods(maxLods);
+		}
+		if (not saveToBinaryCache(cacheFilename, sourceHash, indexed, maxLods, result))
+			std::cerr << std::format("WARNING Mesh: could not write cache file {}", cacheFilename) << "\n";
+		if (setupOnLoad) {
+			for (auto& mesh : result)
+				mesh.setup();
+		}
+		return result;
+	}
+
+	// Lire un cache binaire. Retourne faux si le cache est absent, corrompu, d'une autre version ou généré à partir d'une source différente.
+	static bool loadFromBinaryCache(std::string_view cacheFilename, uint64_t sourceHash, bool indexed, int maxLods, std::vector<Mesh>& result) {
+		MappedFile cache(cacheFilename);
+		if (not cache.isOpen() or cache.size() < sizeof(MeshCacheHeader))
+			return false;
+
+		// Valider l'entête. On copie avec memcpy plutôt que de faire un cast de pointeur, pour ne pas dépendre de l'alignement des données projetées.
+		MeshCacheHeader header = {};
+		std::memcpy(&header, cache.data(), sizeof(header));
+		bool isValid = std::memcmp(header.magic, meshCacheMagic, sizeof(header.magic)) == 0 and
+		               header.version == meshCacheVersion and
+		               header.sourceHash == sourceHash and
+		               header.indexed == (uint32_t)indexed and
+		               header.maxLods == (uint32_t)maxLods;
+		if (not isValid)
+			return false;
+
+		// Valider la table des entrées et la taille totale avant de toucher aux données. Les tailles sont soustraites de ce qui reste dans le fichier plutôt qu'additionnées, pour qu'un cache corrompu ne puisse pas faire déborder le calcul.
+		size_t offset = sizeof(MeshCacheHeader);
+		size_t remaining = cache.size() - offset;
+		if (header.numMeshes > remaining / sizeof(MeshCacheEntry))
+			return false;
+		size_t entriesSize = header.numMeshes * sizeof(MeshCacheEntry);
+		std::vector<MeshCacheEntry> entries(header.numMeshes);
+		std::memcpy(entries.data(), cache.data() + offset, entriesSize);
+		offset += entriesSize;
+		remaining -= entriesSize;
+		auto consume = [&](uint64_t count, size_t elementSize) {
+			if (count > remaining / elementSize)
+				return false;
+			remaining -= count * elementSize;
+			return true;
+		};
+		for (auto&& entry : entries) {
+			if (not consume(entry.numVertices, sizeof(VertexData)) or not consume(entry.numIndices, sizeof(GLuint)) or not consume(entry.numLods, sizeof(MeshLod)))
+				return false;
+		}
+		if (remaining != 0)
+			return false;
+
+		// Copier les blocs de données directement dans les tableaux des mesh.
+		result.clear();
+		result.resize(header.numMeshes);
+		for (size_t i = 0; i < entries.size(); i++) {
+			auto& mesh = result[i];
+			mesh.vertices.resize(entries[i].numVertices);
+			std::memcpy(mesh.vertices.data(), cache.data() + offset, mesh.vertices.size() * sizeof(VertexData));
+			offset += mesh.vertices.size() * sizeof(VertexData);
+			mesh.indices.resize(entries[i].numIndices);
+			std::memcpy(mesh.indices.data(), cache.data() + offset, mesh.indices.size() * sizeof(GLuint));
+			offset += mesh.indices.size() * sizeof(GLuint);
+			mesh.lods.resize(entries[i].numLods);
+			std::memcpy(mesh.lods.data(), cache.data() + offset, mesh.lods.size() * sizeof(MeshLod));
+			offset += mesh.lods.size() * sizeof(MeshLod);
+			// Des indices ou des niveaux de détail hors des tableaux feraient lire le GPU hors des tampons.
+			if (not mesh.isCachedDataConsistent()) {
+				result.clear();
+				return false;
+			}
+			mesh.computeBounds();
+		}
+		return true;
+	}
+
+	bool isCachedDataConsistent() const {
+		for (auto&& index : indices) {
+			if (index >= vertices.size())
+				return false;
+		}
+		for (auto&& lod : lods) {
+			if (lod.firstIndex > indices.size() or lod.numIndices > indices.size() - lod.firstIndex)
+				return false;
+		}
+		return true;
+	}
+
+	// Écrire un cache binaire pour les mesh donnés.
+	// Le fichier est écrit sous un nom temporaire puis renommé (voir writeFileAtomically) : un autre fil ou un autre processus qui lit le cache en même temps ne voit jamais un fichier tronqué.
+	static bool saveToBinaryCache(std::string_view cacheFilename, uint64_t sourceHash, bool indexed, int maxLods, const std::vector<Mesh>& meshes) {
+		MeshCacheHeader header = {};
+		std::memcpy(header.magic, meshCacheMagic, sizeof(header.magic));
+		header.version = meshCacheVersion;
+		header.sourceHash = sourceHash;
+		header.numMeshes = (uint32_t)meshes.size();
+		header.indexed = (uint32_t)indexed;
+		header.maxLods = (uint32_t)maxLods;
+		return writeFileAtomically(std::string(cacheFilename), [&](std::ofstream& file) {
+			file.write((const char*)&header, sizeof(header));
+			for (auto&& mesh : meshes) {
+				MeshCacheEntry entry = {mesh.vertices.size(), mesh.indices.size(), mesh.lods.size()};
+				file.write((const char*)&entry, sizeof(entry));
+			}
+			for (auto&& mesh : meshes) {
+				file.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(VertexData));
+				file.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
+				file.write((const char*)mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+			}
+		});
+	}
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "utils.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Génération des normales et des tangentes d'un mesh de triangles (GL_TRIANGLES). Les fonctions travaillent par coin de triangle : le coin c est le sommet c % 3 du triangle c / 3. Le travail est réparti sur plusieurs fils avec parallelFor. Pour éviter les opérations atomiques, chaque fil écrit seulement ses propres éléments : plutôt que d'additionner la contribution de chaque triangle dans ses sommets (plusieurs fils écriraient dans le même sommet), chaque sommet va lire les triangles qui le touchent grâce à des groupes de coins (CornerGroups).
+
+
+// Nombre minimal d'éléments par fil, pour ne pas créer de fils pour des petits meshes.
+inline constexpr size_t minMeshItemsPerThread = 4096;
+
+// Les coins regroupés par clé (position ou index de sommet), en format compact (CSR) : les coins du groupe g sont corners[offsets[g]] à corners[offsets[g + 1] - 1].
+struct CornerGroups
+{
+	std::vector<GLuint> offsets;
+	std::vector<GLuint> corners;
+
+	size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+};
+
+// Le nombre de paquets pour regrouper numCorners coins en parallèle : un paquet par tranche de minMeshItemsPerThread coins (donc un seul pour un petit mesh), au plus maxCornerBuckets. Assez de paquets pour bien répartir le travail entre les fils, assez peu pour que chaque tranche de coins garde un compteur par paquet.
+inline constexpr size_t maxCornerBuckets = 64;
+
+inline size_t getNumCornerBuckets(size_t numCorners) {
+	return std::clamp<size_t>(numCorners / minMeshItemsPerThread, 1, maxCornerBuckets);
+}
+
+// Répartir les coins dans numBuckets paquets (bucketOf(c) de 0 à numBuckets - 1), en parallèle. Les coins sont découpés en numBuckets tranches fixes : chaque tranche compte ses coins par paquet, puis les recopie à sa place. Les coins gardent leur ordre dans chaque paquet.
+template <typename BucketFunc>
+inline CornerGroups partitionCorners(size_t numCorners, size_t numBuckets, BucketFunc&& bucketOf) {
+	size_t numChunks = numBuckets;
+	auto chunkBegin = [&](size_t k) { return numCorners * k / numChunks; };
+	std::vector<GLuint> bucketOfCorner(numCorners);
+	// Le nombre de coins de chaque tranche dans chaque paquet, puis où la tranche écrit ses coins du paquet.
+	std::vector<GLuint> chunkPositions(numChunks * numBuckets, 0);
+	parallelFor(numChunks, [&](size_t begin, size_t end) {
+		for (size_t k = begin; k < end; k++) {
+			for (size_t c = chunkBegin(k); c < chunkBegin(k + 1); c++) {
+				GLuint b = bucketOfCorner[c] = (GLuint)bucketOf(c);
+				chunkPositions[k * numBuckets + b]++;
+			}
+		}
+	});
+
+	// Les coins sont placés paquet par paquet, et tranche par tranche dans chaque paquet.
+	CornerGroups result;
+	result.offsets.resize(numBuckets + 1);
+	GLuint position = 0;
+	for (size_t b = 0; b < numBuckets; b++) {
+		result.offsets[b] = position;
+		for (size_t k = 0; k < numChunks; k++) {
+			GLuint count = chunkPositions[k * numBuckets + b];
+			chunkPositions[k * numBuckets + b] = position;
+			position += count;
+		}
+	}
+	result.offsets[numBuckets] = position;
+
+	result.corners.resize(numCorners);
+	parallelFor(numChunks, [&](size_t begin, size_t end) {
+		for (size_t k = begin; k < end; k++) {
+			for (size_t c = chunkBegin(k); c < chunkBegin(k + 1); c++)
+				result.corners[chunkPositions[k * numBuckets + bucketOfCorner[c]]++] = (GLuint)c;
+		}
+	});
+	return result;
+}
+
+// Regrouper les coins selon groupOfCorner (des valeurs de 0 à numGroups - 1) avec un tri par dénombrement. Les groupes sont répartis en paquets de groupes consécutifs (voir partitionCorners) : les coins d'un paquet occupent donc une tranche contiguë du résultat, que le fil du paquet remplit seul. Les coins de chaque groupe sont en ordre croissant.
+inline CornerGroups groupCorners(const std::vector<GLuint>& groupOfCorner, size_t numGroups) {
+	CornerGroups result;
+	result.offsets.assign(numGroups + 1, 0);
+	result.corners.resize(groupOfCorner.size());
+	if (numGroups == 0)
+		return result;
+
+	size_t numBuckets = std::min(numGroups, getNumCornerBuckets(groupOfCorner.size()));
+	size_t groupsPerBucket = (numGroups + numBuckets - 1) / numBuckets;
+	auto buckets = partitionCorners(groupOfCorner.size(), numBuckets, [&](size_t c) { return groupOfCorner[c] / groupsPerBucket; });
+	parallelFor(numBuckets, [&](size_t begin, size_t end) {
+		std::vector<GLuint> next;
+		for (size_t b = begin; b < end; b++) {
+			size_t firstGroup = b * groupsPerBucket;
+			size_t lastGroup = std::min(numGroups, firstGroup + groupsPerBucket);
+			if (firstGroup >= lastGroup)
+				continue;
+			next.assign(lastGroup - firstGroup, 0);
+			for (GLuint i = buckets.offsets[b]; i < buckets.offsets[b + 1]; i++)
+				next[groupOfCorner[buckets.corners[i]] - firstGroup]++;
+			GLuint offset = buckets.offsets[b];
+			for (size_t g = firstGroup; g < lastGroup; g++) {
+				GLuint count = next[g - firstGroup];
+				result.offsets[g] = next[g - firstGroup] = offset;
+				offset += count;
+			}
+			for (GLuint i = buckets.offsets[b]; i < buckets.offsets[b + 1]; i++) {
+				GLuint c = buckets.corners[i];
+				result.corners[next[groupOfCorner[c] - firstGroup]++] = c;
+			}
+		}
+	});
+	result.offsets[numGroups] = (GLuint)groupOfCorner.size();
+	return result;
+}
+
+// Numéroter les positions distinctes des coins (les coins à la même position reçoivent le même numéro), peu importe leurs autres attributs. numPositions reçoit le nombre de positions distinctes.
+// Les coins sont répartis en paquets selon le hash de leur position : deux coins à la même position sont dans le même paquet, donc chaque paquet peut être numéroté par son propre fil avec sa propre table de hachage. Les numéros d'un paquet sont ensuite décalés après ceux des paquets précédents.
+template <typename PositionFunc>
+inline std::vector<GLuint> weldCornerPositions(size_t numCorners, PositionFunc&& positionOf, size_t& numPositions) {
+	struct PositionHash
+	{
+		size_t operator() (const vec3& p) const { return std::hash<std::string_view>()(std::string_view((const char*)&p, sizeof(vec3))); }
+	};
+	struct PositionEqual
+	{
+		bool operator() (const vec3& a, const vec3& b) const { return std::memcmp(&a, &b, sizeof(vec3)) == 0; }
+	};
+
+	// Le paquet vient des bits du haut du hash mélangé : les tables de hachage utilisent les bits du bas, qui seraient alors les mêmes pour toutes les positions d'un paquet.
+	size_t numBuckets = getNumCornerBuckets(numCorners);
+	auto buckets = partitionCorners(numCorners, numBuckets, [&](size_t c) {
+		return (size_t)(((uint64_t)PositionHash()(positionOf(c)) * 0x9E3779B97F4A7C15ull) >> 40) % numBuckets;
+	});
+
+	std::vector<GLuint> result(numCorners);
+	std::vector<GLuint> firstPositionOfBucket(numBuckets + 1, 0);
+	parallelFor(numBuckets, [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; b++) {
+			std::unordered_map<vec3, GLuint, PositionHash, PositionEqual> positionToIndex;
+			positionToIndex.reserve(buckets.offsets[b + 1] - buckets.offsets[b]);
+			for (GLuint i = buckets.offsets[b]; i < buckets.offsets[b + 1]; i++) {
+				GLuint c = buckets.corners[i];
+				result[c] = positionToIndex.try_emplace(positionOf(c), (GLuint)positionToIndex.size()).first->second;
+			}
+			firstPositionOfBucket[b + 1] = (GLuint)positionToIndex.size();
+		}
+	});
+	for (size_t b = 0; b < numBuckets; b++)
+		firstPositionOfBucket[b + 1] += firstPositionOfBucket[b];
+	numPositions = firstPositionOfBucket[numBuckets];
+
+	parallelFor(numBuckets, [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; b++) {
+			for (GLuint i = buckets.offsets[b]; i < buckets.offsets[b + 1]; i++)
+				result[buckets.corners[i]] += firstPositionOfBucket[b];
+		}
+	});
+	return result;
+}
+
+// Calculer la normale unitaire de chaque triangle et l'angle (en radians) de chaque coin. L'angle sert de poids : un triangle mince qui touche un sommet par un coin aigu compte moins qu'un triangle qui l'entoure, ce qui rend la normale indépendante de la triangulation. Les triangles dégénérés ont une normale et des angles nuls.
+template <typename PositionFunc>
+inline void computeFaceNormalsAndAngles(size_t numTriangles, PositionFunc&& positionOf, std::vector<vec3>& faceNormals, std::vector<float>& cornerAngles) {
+	faceNormals.resize(numTriangles);
+	cornerAngles.resize(numTriangles * 3);
+	parallelFor(numTriangles, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; t++) {
+			vec3 p[3] = {positionOf(t * 3 + 0), positionOf(t * 3 + 1), positionOf(t * 3 + 2)};
+			vec3 n = cross(p[1] - p[0], p[2] - p[0]);
+			float area = length(n);
+			faceNormals[t] = area > 0 ? n / area : vec3(0);
+			for (int k = 0; k < 3; k++) {
+				vec3 e1 = p[(k + 1) % 3] - p[k];
+				vec3 e2 = p[(k + 2) % 3] - p[k];
+				float l1 = length(e1), l2 = length(e2);
+				cornerAngles[t * 3 + k] = (area > 0 and l1 > 0 and l2 > 0) ? std::acos(std::clamp(dot(e1, e2) / (l1 * l2), -1.0f, 1.0f)) : 0.0f;
+			}
+		}
+	}, minMeshItemsPerThread);
+}
+
+// Calculer la normale lissée de chaque coin : la moyenne pondérée par les angles des normales des triangles qui touchent la même position, mais seulement ceux dont la normale fait un angle d'au plus creaseAngle (en degrés) avec celle du triangle du coin. Les arêtes plus vives restent donc vives (comme les arêtes d'un cube).
+inline std::vector<vec3> computeSmoothCornerNormals(const std::vector<vec3>& faceNormals, const std::vector<float>& cornerAngles, const std::vector<GLuint>& positionOfCorner, const CornerGroups& positionGroups, float creaseAngle) {
+	float minDot = std::cos(radians(creaseAngle));
+	std::vector<vec3> result(cornerAngles.size());
+	parallelFor(result.size(), [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; c++) {
+			const vec3& faceNormal = faceNormals[c / 3];
+			GLuint group = positionOfCorner[c];
+			vec3 sum = vec3(0);
+			for (GLuint i = positionGroups.offsets[group]; i < positionGroups.offsets[group + 1]; i++) {
+				GLuint other = positionGroups.corners[i];
+				const vec3& otherNormal = faceNormals[other / 3];
+				if (dot(faceNormal, otherNormal) >= minDot)
+					sum += otherNormal * cornerAngles[other];
+			}
+			float len = length(sum);
+			result[c] = len > 0 ? sum / len : faceNormal;
+		}
+	}, minMeshItemsPerThread);
+	return result;
+}
+
+// Calculer la tangente et la bitangente (non normalisées) de chaque triangle à partir des dérivées des coordonnées de texture. Les triangles sans étendue en coordonnées de texture ont des vecteurs nuls.
+template <typename PositionFunc, typename TexCoordsFunc>
+inline void computeFaceTangents(size_t numTriangles, PositionFunc&& positionOf, TexCoordsFunc&& texCoordsOf, std::vector<vec3>& faceTangents, std::vector<vec3>& faceBitangents) {
+	faceTangents.resize(numTriangles);
+	faceBitangents.resize(numTriangles);
+	parallelFor(numTriangles, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; t++) {
+			vec3 p0 = positionOf(t * 3 + 0);
+			vec2 uv0 = texCoordsOf(t * 3 + 0);
+			vec3 e1 = positionOf(t * 3 + 1) - p0;
+			vec3 e2 = positionOf(t * 3 + 2) - p0;
+			vec2 d1 = texCoordsOf(t * 3 + 1) - uv0;
+			vec2 d2 = texCoordsOf(t * 3 + 2) - uv0;
+			float det = d1.x * d2.y - d2.x * d1.y;
+			if (std::abs(det) < 1e-12f) {
+				faceTangents[t] = faceBitangents[t] = vec3(0);
+				continue;
+			}
+			// Le signe du déterminant donne l'orientation (miroir ou non) de la texture sur le triangle.
+			float r = 1.0f / det;
+			faceTangents[t] = (e1 * d2.y - e2 * d1.y) * r;
+			faceBitangents[t] = (e2 * d1.x - e1 * d2.x) * r;
+		}
+	}, minMeshItemsPerThread);
+}
+
+// Un vecteur unitaire quelconque perpendiculaire à n, pour les sommets sans tangente définie.
+inline vec3 anyPerpendicular(const vec3& n) {
+	if (dot(n, n) == 0)
+		return vec3(1, 0, 0);
+	vec3 axis = std::abs(n.x) < 0.9f ? vec3(1, 0, 0) : vec3(0, 1, 0);
+	return normalize(cross(n, axis));
+}
+
+// Calculer la tangente de chaque sommet : les tangentes des triangles sont projetées dans le plan de la normale du sommet, normalisées et moyennées avec les angles des coins comme poids. La composante w (1 ou -1) donne l'orientation de la bitangente, que le nuanceur reconstruit avec :
+//     vec3 bitangent = tangent.w * cross(normal, tangent.xyz);
+// Les sommets ne sont pas séparés : un sommet partagé par des triangles d'orientations opposées (coordonnées de texture en miroir) reçoit l'orientation de la somme de leurs bitangentes. Le résultat n'est donc pas identique à celui de MikkTSpace, qui sépare ces sommets, et une carte de normales cuite avec MikkTSpace peut montrer un joint le long des miroirs.
+// vertexGroups regroupe les coins par sommet (voir groupCorners).
+template <typename NormalFunc>
+inline std::vector<vec4> computeVertexTangents(const CornerGroups& vertexGroups, NormalFunc&& normalOfVertex, const std::vector<vec3>& faceTangents, const std::vector<vec3>& faceBitangents, const std::vector<float>& cornerAngles) {
+	std::vector<vec4> result(vertexGroups.size());
+	parallelFor(result.size(), [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			vec3 n = normalOfVertex(v);
+			vec3 tangentSum = vec3(0);
+			vec3 bitangentSum = vec3(0);
+			for (GLuint i = vertexGroups.offsets[v]; i < vertexGroups.offsets[v + 1]; i++) {
+				GLuint corner = vertexGroups.corners[i];
+				const vec3& t = faceTangents[corner / 3];
+				const vec3& b = faceBitangents[corner / 3];
+				vec3 projectedT = t - n * dot(n, t);
+				vec3 projectedB = b - n * dot(n, b);
+				float lt = length(projectedT), lb = length(projectedB);
+				if (lt > 0)
+					tangentSum += projectedT * (cornerAngles[corner] / lt);
+				if (lb > 0)
+					bitangentSum += projectedB * (cornerAngles[corner] / lb);
+			}
+			float len = length(tangentSum);
+			vec3 tangent = len > 0 ? tangentSum / len : anyPerpendicular(n);
+			float handedness = dot(cross(n, tangent), bitangentSum) < 0 ? -1.0f : 1.0f;
+			result[v] = vec4(tangent, handedness);
+		}
+	}, minMeshItemsPerThread);
+	return result;
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Optimisations de l'ordre des triangles et des sommets d'un mesh indexé (GL_TRIANGLES). Les fonctions travaillent seulement sur les tableaux d'indices, elles ne connaissent pas le format des sommets.
+// Référence : Sander, Nehab et Barczak, « Fast Triangle Reordering for Vertex Locality and Reduced Overdraw », SIGGRAPH 2007 (algorithme Tipsify).
+
+
+// Efficacité du cache post-transformation pour un tableau d'indices donné.
+struct VertexCacheStats
+{
+	float acmr = 0; // Average Cache Miss Ratio : nombre d'exécutions du nuanceur de sommets par triangle (entre 0.5 et 3, plus bas = mieux).
+	float atvr = 0; // Average Transform to Vertex Ratio : nombre d'exécutions du nuanceur de sommets par sommet (1 = optimal).
+};
+
+// Simuler un cache FIFO de cacheSize sommets (un modèle simple, mais représentatif, du cache post-transformation des GPU).
+inline VertexCacheStats simulateVertexCache(const std::vector<GLuint>& indices, size_t numVertices, int cacheSize = 16) {
+	// Sans triangle complet, les ratios n'ont pas de sens (et l'ACMR diviserait par 0).
+	size_t numTriangles = indices.size() / 3;
+	if (numTriangles == 0)
+		return {};
+
+	// Un sommet est dans le cache s'il y a été ajouté il y a moins de cacheSize ajouts.
+	std::vector<long long> insertionTime(numVertices, -(long long)cacheSize - 1);
+	std::vector<bool> isUsed(numVertices, false);
+	long long time = 0;
+	size_t numMisses = 0;
+	size_t numUsed = 0;
+	for (auto&& v : indices) {
+		if (time - insertionTime[v] > cacheSize) {
+			insertionTime[v] = time++;
+			numMisses++;
+		}
+		if (not isUsed[v]) {
+			isUsed[v] = true;
+			numUsed++;
+		}
+	}
+
+	return {(float)numMisses / numTriangles, (float)numMisses / numUsed};
+}
+
+// Réordonner les triangles pour la localité dans le cache de sommets (Tipsify). On « éventaille » les triangles autour d'un sommet, puis on choisit le prochain sommet parmi ceux qui viennent d'être émis en favorisant ceux qui resteront dans le cache. Temps linéaire.
+// hardBoundaries reçoit les indices de triangles (dans le résultat) où l'algorithme a dû sauter vers un sommet non voisin. Ce sont des bonnes frontières de grappes pour reorderTrianglesForOverdraw.
+inline std::vector<GLuint> tipsifyIndices(const std::vector<GLuint>& indices, size_t numVertices, int cacheSize, std::vector<size_t>& hardBoundaries) {
+	size_t numTriangles = indices.size() / 3;
+	hardBoundaries.clear();
+
+	// Construire la liste des triangles adjacents à chaque sommet (format compact : décalages + tableau).
+	std::vector<int> liveCount(numVertices, 0);
+	for (auto&& v : indices)
+		liveCount[v]++;
+	std::vector<size_t> adjacencyOffsets(numVertices + 1, 0);
+	for (size_t v = 0; v < numVertices; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveCount[v];
+	std::vector<GLuint> adjacency(indices.size());
+	{
+		std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = GLuint(i / 3);
+	}
+
+	std::vector<int> cacheTime(numVertices, 0);
+	int time = cacheSize + 1;
+	std::vector<bool> isEmitted(numTriangles, false);
+	std::vector<GLuint> deadEndStack;
+	deadEndStack.reserve(indices.size());
+	std::vector<GLuint> candidates;
+	size_t cursor = 0;
+
+	// Trouver un sommet qui a encore des triangles à émettre : d'abord les sommets émis récemment (pile des culs-de-sac), sinon le prochain dans l'ordre d'entrée.
+	auto skipDeadEnd = [&]() -> long long {
+		while (not deadEndStack.empty()) {
+			GLuint v = deadEndStack.back();
+			deadEndStack.pop_back();
+			if (liveCount[v] > 0)
+				return v;
+		}
+		for (; cursor < numVertices; cursor++) {
+			if (liveCount[cursor] > 0)
+				return (long long)cursor;
+		}
+		return -1;
+	};
+
+	std::vector<GLuint> result;
+	result.reserve(numTriangles * 3);
+	long long fanning = skipDeadEnd();
+	while (fanning >= 0) {
+		candidates.clear();
+		// Émettre tous les triangles pas encore émis autour du sommet courant.
+		for (size_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++) {
+			GLuint t = adjacency[a];
+			if (isEmitted[t])
+				continue;
+			for (int c = 0; c < 3; c++) {
+				GLuint v = indices[3 * t + c];
+				result.push_back(v);
+				deadEndStack.push_back(v);
+				candidates.push_back(v);
+				liveCount[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			isEmitted[t] = true;
+		}
+
+		// Choisir le prochain sommet : celui qui est le plus vieux dans le cache tout en étant sûr d'y être encore après l'émission de ses triangles.
+		long long best = -1;
+		int bestPriority = -1;
+		for (auto&& v : candidates) {
+			if (liveCount[v] <= 0)
+				continue;
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * liveCount[v] <= cacheSize)
+				priority = time - cacheTime[v];
+			if (priority > bestPriority) {
+				best = v;
+				bestPriority = priority;
+			}
+		}
+		if (best < 0) {
+			best = skipDeadEnd();
+			if (best >= 0)
+				hardBoundaries.push_back(result.size() / 3);
+		}
+		fanning = best;
+	}
+
+	return result;
+}
+
+// Réordonner des grappes de triangles pour réduire le surdessinage (overdraw), en gardant l'ordre à l'intérieur de chaque grappe (donc la localité dans le cache). Les grappes sont coupées aux frontières de Tipsify, et aussi dès que l'ACMR de la grappe courante passe sous acmrThreshold.
+// Les grappes qui pointent vers l'extérieur du mesh sont tracées en premier : vues de n'importe où, elles ont plus de chances d'en cacher d'autres que d'être cachées. Comme ça, le test de profondeur rejette plus de fragments avant le nuanceur de fragments.
+// positionOf(index) doit retourner la position (vec3) du sommet donné.
+template <typename PositionFunc>
+inline void reorderTrianglesForOverdraw(std::vector<GLuint>& indices, PositionFunc&& positionOf, const std::vector<size_t>& hardBoundaries, int cacheSize = 16, float acmrThreshold = 0.75f) {
+	size_t numTriangles = indices.size() / 3;
+	if (numTriangles == 0)
+		return;
+
+	// Découper en grappes en simulant le cache.
+	std::vector<size_t> clusterStarts = {0};
+	{
+		size_t numVertices = *std::max_element(indices.begin(), indices.end()) + size_t(1);
+		std::vector<long long> insertionTime(numVertices, -(long long)cacheSize - 1);
+		long long time = 0;
+		size_t clusterMisses = 0;
+		size_t boundary = 0;
+		for (size_t t = 0; t < numTriangles; t++) {
+			size_t clusterSize = t - clusterStarts.back();
+			bool isHardBoundary = boundary < hardBoundaries.size() and hardBoundaries[boundary] == t;
+			if (isHardBoundary)
+				boundary++;
+			bool isSoftBoundary = clusterSize > 0 and (float)clusterMisses / clusterSize < acmrThreshold;
+			if (clusterSize > 0 and (isHardBoundary or isSoftBoundary)) {
+				clusterStarts.push_back(t);
+				clusterMisses = 0;
+			}
+			for (int c = 0; c < 3; c++) {
+				GLuint v = indices[3 * t + c];
+				if (time - insertionTime[v] > cacheSize) {
+					insertionTime[v] = time++;
+					clusterMisses++;
+				}
+			}
+		}
+	}
+	clusterStarts.push_back(numTriangles);
+	size_t numClusters = clusterStarts.size() - 1;
+
+	// Calculer le centroïde et la normale moyenne (pondérés par l'aire) de chaque grappe, et le centroïde du mesh.
+	std::vector<vec3> clusterCentroids(numClusters, vec3(0));
+	std::vector<vec3> clusterNormals(numClusters, vec3(0));
+	vec3 meshCentroid(0);
+	float meshArea = 0;
+	for (size_t k = 0; k < numClusters; k++) {
+		float clusterArea = 0;
+		for (size_t t = clusterStarts[k]; t < clusterStarts[k + 1]; t++) {
+			vec3 p0 = positionOf(indices[3 * t + 0]);
+			vec3 p1 = positionOf(indices[3 * t + 1]);
+			vec3 p2 = positionOf(indices[3 * t + 2]);
+			vec3 areaNormal = cross(p1 - p0, p2 - p0);
+			float area = length(areaNormal);
+			vec3 centroid = (p0 + p1 + p2) / 3.0f;
+			clusterCentroids[k] += centroid * area;
+			clusterNormals[k] += areaNormal;
+			clusterArea += area;
+		}
+		meshCentroid += clusterCentroids[k];
+		meshArea += clusterArea;
+		if (clusterArea > 0)
+			clusterCentroids[k] /= clusterArea;
+	}
+	if (meshArea > 0)
+		meshCentroid /= meshArea;
+
+	// Trier les grappes de la plus tournée vers l'extérieur à la plus tournée vers l'intérieur.
+	std::vector<float> sortKeys(numClusters, 0);
+	for (size_t k = 0; k < numClusters; k++) {
+		float normalLength = length(clusterNormals[k]);
+		if (normalLength > 0)
+			sortKeys[k] = dot(clusterCentroids[k] - meshCentroid, clusterNormals[k] / normalLength);
+	}
+	std::vector<size_t> order(numClusters);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+	for (auto&& k : order)
+		result.insert(result.end(), indices.begin() + 3 * clusterStarts[k], indices.begin() + 3 * clusterStarts[k + 1]);
+	indices = std::move(result);
+}
+
+// Renuméroter les sommets dans l'ordre de leur première utilisation dans le tableau d'indices, pour que les lectures du VBO soient les plus séquentielles possible. Les indices sont modifiés sur place. Retourne, pour chaque nouveau sommet, l'index de l'ancien sommet correspondant. Les sommets inutilisés sont éliminés.
+inline std::vector<GLuint> reorderVerticesForFetch(std::vector<GLuint>& indices, size_t numVertices) {
+	constexpr GLuint unassigned = ~GLuint(0);
+	std::vector<GLuint> oldToNew(numVertices, unassigned);
+	std::vector<GLuint> newToOld;
+	newToOld.reserve(numVertices);
+	for (auto& v : indices) {
+		if (oldToNew[v] == unassigned) {
+			oldToNew[v] = (GLuint)newToOld.size();
+			newToOld.push_back(v);
+		}
+		v = oldToNew[v];
+	}
+	return newToOld;
+}
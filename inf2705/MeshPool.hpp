@@ -0,0 +1,282 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+#include "Mesh.hpp"
+
+
+using namespace gl;
+
+
+// Allocateur de plages dans un tableau de taille fixe. Les blocs libres sont gardés triés par position dans une liste : on prend le premier bloc assez grand, et un bloc libéré est fusionné avec ses voisins libres pour limiter la fragmentation.
+class RangeAllocator
+{
+public:
+	static constexpr size_t invalidOffset = SIZE_MAX;
+
+	size_t getCapacity() const { return capacity_; }
+	size_t getUsedSize() const { return usedSize_; }
+	size_t getNumFreeBlocks() const { return freeBlocks_.size(); }
+
+	void reset(size_t capacity) {
+		capacity_ = capacity;
+		usedSize_ = 0;
+		freeBlocks_.clear();
+		if (capacity != 0)
+			freeBlocks_.push_back({0, capacity});
+	}
+
+	// Réserver size éléments contigus. Retourne la position du début, ou invalidOffset s'il n'y a pas de bloc libre assez grand.
+	size_t allocate(size_t size) {
+		if (size == 0)
+			return 0;
+		for (auto it = freeBlocks_.begin(); it != freeBlocks_.end(); ++it) {
+			if (it->size < size)
+				continue;
+			size_t offset = it->offset;
+			it->offset += size;
+			it->size -= size;
+			if (it->size == 0)
+				freeBlocks_.erase(it);
+			usedSize_ += size;
+			return offset;
+		}
+		return invalidOffset;
+	}
+
+	void free(size_t offset, size_t size) {
+		if (size == 0)
+			return;
+		usedSize_ -= size;
+		addFreeBlock(offset, size);
+	}
+
+	// Agrandir le tableau. L'espace ajouté à la fin est libre.
+	void grow(size_t newCapacity) {
+		if (newCapacity <= capacity_)
+			return;
+		addFreeBlock(capacity_, newCapacity - capacity_);
+		capacity_ = newCapacity;
+	}
+
+private:
+	struct Block
+	{
+		size_t offset;
+		size_t size;
+	};
+
+	void addFreeBlock(size_t offset, size_t size) {
+		auto it = std::lower_bound(freeBlocks_.begin(), freeBlocks_.end(), offset, [](const Block& b, size_t o) { return b.offset < o; });
+		it = freeBlocks_.insert(it, {offset, size});
+		// Fusionner avec le bloc suivant, puis avec le précédent.
+		auto next = it + 1;
+		if (next != freeBlocks_.end() and it->offset + it->size == next->offset) {
+			it->size += next->size;
+			it = freeBlocks_.erase(next) - 1;
+		}
+		if (it != freeBlocks_.begin()) {
+			auto prev = it - 1;
+			if (prev->offset + prev->size == it->offset) {
+				prev->size += it->size;
+				freeBlocks_.erase(it);
+			}
+		}
+	}
+
+	size_t capacity_ = 0;
+	size_t usedSize_ = 0;
+	std::vector<Block> freeBlocks_;
+};
+
+
+// Un mesh placé dans un MeshPool : ses plages dans les tampons partagés. Les indices sont relatifs au premier sommet du mesh, qui est passé comme sommet de base au tracé.
+struct PooledMesh
+{
+	uint32_t firstVertex = 0;
+	uint32_t numVertices = 0;
+	uint32_t firstIndex = 0;
+	uint32_t numIndices = 0; // 0 si le mesh n'est pas indexé.
+	std::vector<MeshLod> lods; // Comme Mesh::lods, relatifs à firstIndex.
+	vec3 boundsMin = vec3(0); // Comme Mesh::boundsMin et Mesh::boundsMax, pour l'élimination hors champ.
+	vec3 boundsMax = vec3(0);
+
+	// Comme Mesh::getWorldBox.
+	void getWorldBox(const mat4& model, vec3& center, vec3& extent) const {
+		transformBox(model, (boundsMin + boundsMax) * 0.5f, (boundsMax - boundsMin) * 0.5f, center, extent);
+	}
+
+	bool isValid() const { return numVertices != 0; }
+};
+
+// Un ensemble de meshes statiques qui partagent un seul VAO, un seul tampon de sommets (VertexData) et un seul tampon d'indices. Chaque mesh ajouté reçoit une plage dans chacun des tampons, et on le trace avec glDrawElementsBaseVertex sans changer de VAO ni de tampon : on appelle bind() une fois, puis draw() pour chaque objet.
+// Les tampons grandissent au besoin (copiés sur le GPU avec glCopyBufferSubData), et l'espace d'un mesh retiré est réutilisé par les prochains ajouts.
+class MeshPool
+{
+public:
+	GLuint getVao() const { return vao_; }
+	GLuint getVertexBuffer() const { return vbo_; }
+	GLuint getIndexBuffer() const { return ebo_; }
+	GLenum getIndexType() const { return indexType_; }
+	size_t getIndexSize() const { return indexType_ == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+	const RangeAllocator& getVertexAllocator() const { return vertexAllocator_; }
+	const RangeAllocator& getIndexAllocator() const { return indexAllocator_; }
+
+	// Créer les tampons avec de la place pour maxVertices sommets et maxIndices indices. Avec GL_UNSIGNED_SHORT, les indices prennent deux fois moins de place, mais chaque mesh doit avoir moins de 65535 sommets (les indices sont relatifs au mesh, pas au tampon).
+	void create(size_t maxVertices, size_t maxIndices, GLenum indexType = GL_UNSIGNED_INT) {
+		deleteObjects();
+		indexType_ = indexType;
+		glGenVertexArrays(1, &vao_);
+		glBindVertexArray(vao_);
+		VertexFormat<VertexData>::setupAttribFormats();
+		glBindVertexArray(0);
+		vertexAllocator_.reset(0);
+		indexAllocator_.reset(0);
+		growVertices(std::max(maxVertices, size_t(1)));
+		growIndices(std::max(maxIndices, size_t(1)));
+	}
+
+	// Copier les sommets et les indices (incluant les niveaux de détail) d'un mesh dans les tampons partagés. Le mesh n'a pas besoin d'avoir été configuré avec setup(). Retourne un PooledMesh invalide en cas d'erreur.
+	PooledMesh add(const Mesh& mesh) {
+		PooledMesh result;
+		if (mesh.vertices.empty())
+			return result;
+		if (indexType_ == GL_UNSIGNED_SHORT and mesh.vertices.size() >= 0xFFFF) {
+			std::cerr << std::format("MeshPool: {} sommets ne tiennent pas dans des indices de 16 bits", mesh.vertices.size()) << std::endl;
+			return result;
+		}
+
+		size_t firstVertex = allocateOrGrow(vertexAllocator_, mesh.vertices.size(), &MeshPool::growVertices);
+		size_t firstIndex = allocateOrGrow(indexAllocator_, mesh.indices.size(), &MeshPool::growIndices);
+		result.firstVertex = (uint32_t)firstVertex;
+		result.numVertices = (uint32_t)mesh.vertices.size();
+		result.firstIndex = (uint32_t)firstIndex;
+		result.numIndices = (uint32_t)mesh.indices.size();
+		result.lods = mesh.lods;
+		result.boundsMin = mesh.boundsMin;
+		result.boundsMax = mesh.boundsMax;
+
+		// On passe par GL_COPY_WRITE_BUFFER pour ne pas toucher au tampon d'indices lié au VAO courant.
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * sizeof(VertexData), mesh.vertices.size() * sizeof(VertexData), mesh.vertices.data());
+		if (not mesh.indices.empty()) {
+			glBindBuffer(GL_COPY_WRITE_BUFFER, ebo_);
+			if (indexType_ == GL_UNSIGNED_SHORT) {
+				std::vector<GLushort> shortIndices(mesh.indices.begin(), mesh.indices.end());
+				glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(GLushort), shortIndices.size() * sizeof(GLushort), shortIndices.data());
+			} else {
+				glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(GLuint), mesh.indices.size() * sizeof(GLuint), mesh.indices.data());
+			}
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return result;
+	}
+
+	// Libérer les plages d'un mesh. Elles seront réutilisées par les prochains ajouts.
+	void remove(PooledMesh& mesh) {
+		if (not mesh.isValid())
+			return;
+		vertexAllocator_.free(mesh.firstVertex, mesh.numVertices);
+		indexAllocator_.free(mesh.firstIndex, mesh.numIndices);
+		mesh = {};
+	}
+
+	void bind() const { glBindVertexArray(vao_); }
+	void unbind() const { glBindVertexArray(0); }
+
+	// Tracer un mesh du pool. Le VAO du pool doit être lié avec bind(). S'il y a des niveaux de détail, seul le niveau complet est tracé.
+	void draw(const PooledMesh& mesh, GLenum drawMode = GL_TRIANGLES) const {
+		if (not mesh.isValid())
+			return;
+		if (mesh.numIndices == 0)
+			glDrawArrays(drawMode, (GLint)mesh.firstVertex, (GLsizei)mesh.numVertices);
+		else if (not mesh.lods.empty())
+			drawIndexRange(mesh, mesh.lods[0].firstIndex, mesh.lods[0].numIndices, drawMode);
+		else
+			drawIndexRange(mesh, 0, mesh.numIndices, drawMode);
+	}
+
+	// Tracer un niveau de détail d'un mesh du pool (voir Mesh::generateLods et Mesh::selectLod).
+	void drawLod(const PooledMesh& mesh, int level, GLenum drawMode = GL_TRIANGLES) const {
+		if (mesh.lods.empty()) {
+			draw(mesh, drawMode);
+			return;
+		}
+		auto& lod = mesh.lods[std::clamp(level, 0, (int)mesh.lods.size() - 1)];
+		drawIndexRange(mesh, lod.firstIndex, lod.numIndices, drawMode);
+	}
+
+	void deleteObjects() {
+		glDeleteVertexArrays(1, &vao_);
+		glDeleteBuffers(1, &vbo_);
+		glDeleteBuffers(1, &ebo_);
+		vao_ = vbo_ = ebo_ = 0;
+		vertexAllocator_.reset(0);
+		indexAllocator_.reset(0);
+	}
+
+private:
+	void drawIndexRange(const PooledMesh& mesh, uint32_t first, uint32_t count, GLenum drawMode) const {
+		auto offset = (const void*)((mesh.firstIndex + first) * getIndexSize());
+		glDrawElementsBaseVertex(drawMode, (GLsizei)count, indexType_, offset, (GLint)mesh.firstVertex);
+	}
+
+	// Réserver size éléments, en agrandissant le tampon (au moins du double) s'il n'y a pas de bloc libre assez grand.
+	size_t allocateOrGrow(RangeAllocator& allocator, size_t size, void (MeshPool::*grow)(size_t)) {
+		size_t offset = allocator.allocate(size);
+		if (offset == RangeAllocator::invalidOffset) {
+			(this->*grow)(std::max(allocator.getCapacity() * 2, allocator.getCapacity() + size));
+			offset = allocator.allocate(size);
+		}
+		return offset;
+	}
+
+	// Remplacer un tampon par un plus grand en copiant son contenu sur le GPU.
+	static GLuint reallocateBuffer(GLuint oldBuffer, size_t oldSize, size_t newSize) {
+		GLuint newBuffer = 0;
+		glGenBuffers(1, &newBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+		if (oldBuffer != 0) {
+			glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			glDeleteBuffers(1, &oldBuffer);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return newBuffer;
+	}
+
+	void growVertices(size_t newCapacity) {
+		vbo_ = reallocateBuffer(vbo_, vertexAllocator_.getCapacity() * sizeof(VertexData), newCapacity * sizeof(VertexData));
+		vertexAllocator_.grow(newCapacity);
+		// Les attributs gardent le tampon qui était lié au moment de leur configuration, donc il faut lier le nouveau.
+		glBindVertexArray(vao_);
+		VertexFormat<VertexData>::bindVertexBuffer(vbo_);
+		glBindVertexArray(0);
+	}
+
+	void growIndices(size_t newCapacity) {
+		ebo_ = reallocateBuffer(ebo_, indexAllocator_.getCapacity() * getIndexSize(), newCapacity * getIndexSize());
+		indexAllocator_.grow(newCapacity);
+		glBindVertexArray(vao_);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+		glBindVertexArray(0);
+	}
+
+	GLuint vao_ = 0;
+	GLuint vbo_ = 0;
+	GLuint ebo_ = 0;
+	GLenum indexType_ = GL_UNSIGNED_INT;
+	RangeAllocator vertexAllocator_;
+	RangeAllocator indexAllocator_;
+};
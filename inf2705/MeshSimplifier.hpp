@@ -0,0 +1,317 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Simplification de mesh indexé (GL_TRIANGLES) par fusion d'arêtes guidée par les quadriques d'erreur.
+// Référence : Garland et Heckbert, « Surface Simplification Using Quadric Error Metrics », SIGGRAPH 1997.
+// On fait des fusions de demi-arêtes : la position u est remplacée par une position v existante, et chaque sommet à la position u par un sommet existant à la position v, jamais par un nouveau sommet. Les niveaux simplifiés réutilisent donc le même tableau de sommets (et le même VBO) que le mesh d'origine, seuls les indices changent. Ça garde aussi les coordonnées de texture et les normales exactes aux sommets restants.
+
+
+namespace simplifier_detail
+{
+	// Quadrique d'erreur : somme pondérée par l'aire des carrés des distances à des plans (ax + by + cz + d = 0). Matrice 4x4 symétrique, donc 10 coefficients. On garde l'aire totale pour normaliser l'erreur en une distance.
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0;
+		double b2 = 0, bc = 0, bd = 0;
+		double c2 = 0, cd = 0;
+		double d2 = 0;
+		double area = 0;
+
+		void addPlane(dvec3 n, double d, double weight) {
+			a2 += weight * n.x * n.x; ab += weight * n.x * n.y; ac += weight * n.x * n.z; ad += weight * n.x * d;
+			b2 += weight * n.y * n.y; bc += weight * n.y * n.z; bd += weight * n.y * d;
+			c2 += weight * n.z * n.z; cd += weight * n.z * d;
+			d2 += weight * d * d;
+			area += weight;
+		}
+
+		Quadric& operator+= (const Quadric& other) {
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+			b2 += other.b2; bc += other.bc; bd += other.bd;
+			c2 += other.c2; cd += other.cd;
+			d2 += other.d2;
+			area += other.area;
+			return *this;
+		}
+
+		// Carré de la distance moyenne (pondérée par l'aire) entre p et les plans de la quadrique.
+		double evaluate(dvec3 p) const {
+			double sum = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+			           + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+			           + c2 * p.z * p.z + 2 * cd * p.z
+			           + d2;
+			return area > 0 ? std::max(sum, 0.0) / area : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		double cost; // Carré de l'erreur.
+		GLuint from;
+		GLuint to;
+	};
+
+	inline uint64_t edgeKey(GLuint a, GLuint b) {
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+}
+
+
+// Simplifier un tableau d'indices jusqu'à targetIndexCount indices (ou jusqu'à ce qu'aucune fusion ne respecte maxError). positionOf(i), normalOf(i) et texCoordsOf(i) doivent retourner la position (vec3), la normale (vec3) et les coordonnées de texture (vec2) du sommet i.
+// Les fusions se font entre positions : tous les sommets à la position u (il y en a plusieurs sur une couture ou une arête vive) sont déplacés vers des sommets à la position v. Chaque sommet de u est associé au sommet de v avec lequel il partage un triangle fusionné, sinon à celui dont les attributs sont les plus proches. Pour préserver l'apparence, une fusion est refusée si :
+//   - un des sommets de u est associé à un sommet de v dont la normale diffère de plus que minNormalDot (cosinus de l'angle). Les arêtes vives et les faces plates gardent leurs normales.
+//   - un sommet de u est associé à un sommet de v dont les coordonnées de texture font un saut (plus du double de l'écart observé dans les triangles fusionnés). Les coutures UV restent donc intactes.
+//   - elle retourne un triangle, ou u est sur une bordure de la surface.
+// resultError reçoit l'erreur géométrique maximale des fusions faites, en distance (mêmes unités que les positions).
+template <typename PositionFunc, typename NormalFunc, typename TexCoordsFunc>
+inline std::vector<GLuint> simplifyIndices(const std::vector<GLuint>& indices, size_t numVertices, PositionFunc&& positionOf, NormalFunc&& normalOf, TexCoordsFunc&& texCoordsOf, size_t targetIndexCount, float maxError, float& resultError, float minNormalDot = 0.7f) {
+	using namespace simplifier_detail;
+
+	resultError = 0;
+	if (indices.size() <= targetIndexCount)
+		return indices;
+
+	// Regrouper les sommets par position. Le groupe d'un sommet est le premier sommet à avoir la même position. La topologie et les quadriques sont manipulées par groupe, le tableau d'indices par sommet.
+	std::vector<GLuint> group(numVertices);
+	{
+		struct PositionHash { size_t operator() (const vec3& p) const { return std::hash<std::string_view>()(std::string_view((const char*)&p, sizeof(p))); } };
+		struct PositionEqual { bool operator() (const vec3& a, const vec3& b) const { return std::memcmp(&a, &b, sizeof(vec3)) == 0; } };
+		std::unordered_map<vec3, GLuint, PositionHash, PositionEqual> firstWithPosition;
+		firstWithPosition.reserve(numVertices);
+		for (GLuint v = 0; v < numVertices; v++)
+			group[v] = firstWithPosition.try_emplace(positionOf(v), v).first->second;
+	}
+
+	// Garder seulement les triangles qui ont trois positions différentes.
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		GLuint a = group[indices[i + 0]], b = group[indices[i + 1]], c = group[indices[i + 2]];
+		if (a != b and b != c and c != a)
+			result.insert(result.end(), {indices[i + 0], indices[i + 1], indices[i + 2]});
+	}
+
+	// Une arête entre deux positions qui n'est pas partagée par exactement deux triangles est une bordure. Ses positions sont verrouillées.
+	std::vector<bool> isLocked(numVertices, false);
+	{
+		std::unordered_map<uint64_t, int> edgeCount;
+		edgeCount.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int c = 0; c < 3; c++)
+				edgeCount[edgeKey(group[result[i + c]], group[result[i + (c + 1) % 3]])]++;
+		}
+		for (auto&& [key, count] : edgeCount) {
+			if (count != 2) {
+				isLocked[key >> 32] = true;
+				isLocked[key & 0xFFFFFFFF] = true;
+			}
+		}
+	}
+
+	// Accumuler dans chaque groupe la quadrique des plans des triangles adjacents.
+	std::vector<Quadric> quadrics(numVertices);
+	for (size_t i = 0; i < result.size(); i += 3) {
+		dvec3 p0(positionOf(result[i + 0]));
+		dvec3 p1(positionOf(result[i + 1]));
+		dvec3 p2(positionOf(result[i + 2]));
+		dvec3 areaNormal = cross(p1 - p0, p2 - p0);
+		double doubleArea = length(areaNormal);
+		if (doubleArea <= 0)
+			continue;
+		dvec3 n = areaNormal / doubleArea;
+		Quadric q;
+		q.addPlane(n, -dot(n, p0), doubleArea * 0.5);
+		for (int c = 0; c < 3; c++)
+			quadrics[group[result[i + c]]] += q;
+	}
+
+	// Les normales nulles (mesh sans normales) ne bloquent pas les fusions.
+	auto areNormalsClose = [&](GLuint a, GLuint b) {
+		vec3 na = normalOf(a);
+		vec3 nb = normalOf(b);
+		return dot(na, nb) >= minNormalDot * length(na) * length(nb);
+	};
+	// Le sommet du triangle donné qui est dans le groupe g, ou numVertices s'il n'y en a pas.
+	auto cornerInGroup = [&](const GLuint* tri, GLuint g) -> GLuint {
+		for (int c = 0; c < 3; c++) {
+			if (group[tri[c]] == g)
+				return tri[c];
+		}
+		return (GLuint)numVertices;
+	};
+
+	double maxCost = double(maxError) * maxError;
+	std::vector<int> adjacencyCount(numVertices);
+	std::vector<size_t> adjacencyOffsets(numVertices + 1);
+	std::vector<GLuint> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<GLuint> remap(numVertices);
+	std::vector<bool> isDirty(numVertices);
+	std::vector<std::pair<GLuint, GLuint>> wedgePairs;
+	std::vector<GLuint> targetWedges;
+
+	// Chaque passe fait un ensemble de fusions indépendantes (qui ne touchent pas les mêmes triangles), de la moins chère à la plus chère, puis reconstruit l'adjacence.
+	while (result.size() > targetIndexCount) {
+		size_t numTriangles = result.size() / 3;
+		size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+
+		// Liste compacte des triangles adjacents à chaque groupe.
+		std::fill(adjacencyCount.begin(), adjacencyCount.end(), 0);
+		for (auto&& v : result)
+			adjacencyCount[group[v]]++;
+		adjacencyOffsets[0] = 0;
+		for (size_t g = 0; g < numVertices; g++)
+			adjacencyOffsets[g + 1] = adjacencyOffsets[g] + adjacencyCount[g];
+		adjacency.resize(result.size());
+		{
+			std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < result.size(); i++)
+				adjacency[fill[group[result[i]]]++] = GLuint(i / 3);
+		}
+
+		// Évaluer chaque arête une fois (dans le triangle où elle va du plus petit au plus grand groupe), dans le sens de fusion le moins cher.
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int c = 0; c < 3; c++) {
+				GLuint a = group[result[i + c]];
+				GLuint b = group[result[i + (c + 1) % 3]];
+				if (a > b)
+					continue;
+				Collapse best = {maxCost, 0, 0};
+				bool found = false;
+				for (auto [from, to] : {std::pair{a, b}, std::pair{b, a}}) {
+					if (isLocked[from])
+						continue;
+					double cost = quadrics[from].evaluate(dvec3(positionOf(to)));
+					if (cost <= best.cost) {
+						best = {cost, from, to};
+						found = true;
+					}
+				}
+				if (found)
+					collapses.push_back(best);
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		for (GLuint v = 0; v < numVertices; v++)
+			remap[v] = v;
+		std::fill(isDirty.begin(), isDirty.end(), false);
+		size_t numRemoved = 0;
+		size_t numCollapses = 0;
+		for (auto&& [cost, u, v] : collapses) {
+			if (numRemoved >= trianglesToRemove)
+				break;
+			if (isDirty[u] or isDirty[v])
+				continue;
+
+			// Associer les sommets de u aux sommets de v qui partagent un triangle fusionné, en vérifiant que les triangles qui restent ne se retournent pas et ne deviennent pas dégénérés.
+			bool isValid = true;
+			size_t numCollapsedTriangles = 0;
+			float maxTexCoordsDelta = 0;
+			wedgePairs.clear();
+			for (size_t a = adjacencyOffsets[u]; a < adjacencyOffsets[u + 1] and isValid; a++) {
+				const GLuint* tri = &result[3 * adjacency[a]];
+				GLuint from = cornerInGroup(tri, u);
+				GLuint to = cornerInGroup(tri, v);
+				if (to != numVertices) {
+					numCollapsedTriangles++;
+					isValid = areNormalsClose(from, to);
+					maxTexCoordsDelta = std::max(maxTexCoordsDelta, length(texCoordsOf(from) - texCoordsOf(to)));
+					if (std::none_of(wedgePairs.begin(), wedgePairs.end(), [&](auto& pair) { return pair.first == from; }))
+						wedgePairs.push_back({from, to});
+					continue;
+				}
+				vec3 p[3], q[3];
+				for (int c = 0; c < 3; c++) {
+					p[c] = positionOf(tri[c]);
+					q[c] = group[tri[c]] == u ? positionOf(v) : p[c];
+				}
+				vec3 oldNormal = cross(p[1] - p[0], p[2] - p[0]);
+				vec3 newNormal = cross(q[1] - q[0], q[2] - q[0]);
+				float oldLength = length(oldNormal);
+				float newLength = length(newNormal);
+				isValid = newLength > 1e-12f and dot(oldNormal, newNormal) > 0.25f * oldLength * newLength;
+			}
+			if (not isValid or numCollapsedTriangles == 0)
+				continue;
+
+			// Les sommets de u qui ne touchent pas l'arête fusionnée prennent le sommet de v aux attributs les plus proches, s'il est assez proche.
+			targetWedges.clear();
+			for (size_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++) {
+				GLuint to = cornerInGroup(&result[3 * adjacency[a]], v);
+				if (std::find(targetWedges.begin(), targetWedges.end(), to) == targetWedges.end())
+					targetWedges.push_back(to);
+			}
+			for (size_t a = adjacencyOffsets[u]; a < adjacencyOffsets[u + 1] and isValid; a++) {
+				GLuint from = cornerInGroup(&result[3 * adjacency[a]], u);
+				if (std::any_of(wedgePairs.begin(), wedgePairs.end(), [&](auto& pair) { return pair.first == from; }))
+					continue;
+				GLuint bestTo = (GLuint)numVertices;
+				float bestDistance = 0;
+				for (auto&& to : targetWedges) {
+					float distance = length(texCoordsOf(from) - texCoordsOf(to)) + (1 - dot(normalOf(from), normalOf(to)));
+					if (bestTo == numVertices or distance < bestDistance) {
+						bestTo = to;
+						bestDistance = distance;
+					}
+				}
+				isValid = bestTo != numVertices and areNormalsClose(from, bestTo) and
+				          length(texCoordsOf(from) - texCoordsOf(bestTo)) <= 2 * maxTexCoordsDelta + 1e-6f;
+				wedgePairs.push_back({from, bestTo});
+			}
+			if (not isValid)
+				continue;
+
+			for (auto&& [from, to] : wedgePairs)
+				remap[from] = to;
+			quadrics[v] += quadrics[u];
+			// Les triangles autour de u changent, donc leurs positions ne peuvent plus participer à une autre fusion dans cette passe.
+			for (size_t a = adjacencyOffsets[u]; a < adjacencyOffsets[u + 1]; a++) {
+				for (int c = 0; c < 3; c++)
+					isDirty[group[result[3 * adjacency[a] + c]]] = true;
+			}
+			isDirty[v] = true;
+			numRemoved += numCollapsedTriangles;
+			numCollapses++;
+			resultError = std::max(resultError, (float)std::sqrt(cost));
+		}
+		if (numCollapses == 0)
+			break;
+
+		// Appliquer les fusions et enlever les triangles dégénérés.
+		size_t numKept = 0;
+		for (size_t t = 0; t < numTriangles; t++) {
+			GLuint a = remap[result[3 * t + 0]];
+			GLuint b = remap[result[3 * t + 1]];
+			GLuint c = remap[result[3 * t + 2]];
+			if (group[a] == group[b] or group[b] == group[c] or group[c] == group[a])
+				continue;
+			result[3 * numKept + 0] = a;
+			result[3 * numKept + 1] = b;
+			result[3 * numKept + 2] = c;
+			numKept++;
+		}
+		result.resize(3 * numKept);
+	}
+
+	return result;
+}
@@ -0,0 +1,364 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <numbers>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <SFML/Graphics.hpp>
+
+#include "utils.hpp"
+
+
+using namespace glm;
+
+
+// Génération des mipmaps sur le CPU pour les images RGBA 8 bits, plutôt qu'avec glGenerateMipmap dont l'algorithme n'est pas spécifié par le standard (le résultat change d'un pilote à l'autre) et qui peut être très lent sur les implémentations logicielles d'OpenGL.
+// Le filtrage se fait dans l'espace linéaire : les composantes RGB des images sont encodées en sRGB (la courbe gamma des écrans), et faire la moyenne directement sur les valeurs encodées assombrit les niveaux réduits. On décode donc en linéaire avec une table, on filtre, puis on réencode. L'alpha est déjà linéaire.
+// Chaque niveau est calculé à partir du précédent, rangée par rangée, et les rangées sont réparties sur plusieurs fils avec parallelFor. Les boucles internes travaillent sur des vec4 (un pixel à la fois, 4 composantes), que le compilateur vectorise.
+
+
+enum class MipmapFilter : uint32_t
+{
+	Box,    // Moyenne de 2x2 pixels. Rapide, un peu flou.
+	Kaiser, // Sinus cardinal fenêtré (fenêtre de Kaiser) de 8x8 pixels. Plus net, au prix de 4 fois plus de calculs.
+};
+
+// Une chaîne de niveaux de détail, du niveau 0 (l'image complète) au plus petit.
+struct MipChain
+{
+	std::vector<ivec2> sizes;
+	std::vector<std::vector<uint8_t>> levels; // Pixels RGBA 8 bits, rangée par rangée.
+
+	int getNumLevels() const { return (int)levels.size(); }
+};
+
+// Le nombre de niveaux d'une chaîne complète (jusqu'à 1x1).
+inline int getMaxMipLevels(ivec2 size) {
+	int numLevels = 1;
+	for (int s = std::max(size.x, size.y); s > 1; s /= 2)
+		numLevels++;
+	return numLevels;
+}
+
+// La taille du niveau suivant, selon la règle d'OpenGL (division entière, au moins 1).
+inline ivec2 getNextMipSize(ivec2 size) {
+	return {std::max(size.x / 2, 1), std::max(size.y / 2, 1)};
+}
+
+// Nombre minimal de rangées par fil.
+inline constexpr size_t minMipRowsPerThread = 16;
+
+namespace mipmaps_detail {
+
+// Décodage sRGB vers linéaire pour les 256 valeurs possibles.
+inline const std::array<float, 256>& getSrgbToLinearTable() {
+	static const std::array<float, 256> table = [] {
+		std::array<float, 256> result = {};
+		for (int i = 0; i < 256; i++) {
+			float c = i / 255.0f;
+			result[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return result;
+	}();
+	return table;
+}
+
+// Encodage linéaire vers sRGB. La table est assez fine pour que l'erreur reste sous un demi-niveau, même dans les tons foncés où la courbe est raide.
+inline constexpr int linearToSrgbTableSize = 1 << 14;
+
+inline const std::vector<uint8_t>& getLinearToSrgbTable() {
+	static const std::vector<uint8_t> table = [] {
+		std::vector<uint8_t> result(linearToSrgbTableSize);
+		for (int i = 0; i < linearToSrgbTableSize; i++) {
+			float c = (i + 0.5f) / linearToSrgbTableSize;
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1 / 2.4f) - 0.055f;
+			result[i] = (uint8_t)std::clamp((int)std::lround(s * 255), 0, 255);
+		}
+		return result;
+	}();
+	return table;
+}
+
+inline vec4 decodePixel(const uint8_t* p, bool gammaCorrect, const std::array<float, 256>& toLinear) {
+	if (not gammaCorrect)
+		return vec4(p[0], p[1], p[2], p[3]) / 255.0f;
+	return vec4(toLinear[p[0]], toLinear[p[1]], toLinear[p[2]], p[3] / 255.0f);
+}
+
+inline void encodePixel(vec4 c, uint8_t* p, bool gammaCorrect, const std::vector<uint8_t>& toSrgb) {
+	c = clamp(c, vec4(0), vec4(1));
+	for (int k = 0; k < 3; k++)
+		p[k] = gammaCorrect ? toSrgb[std::min((int)(c[k] * linearToSrgbTableSize), linearToSrgbTableSize - 1)] : (uint8_t)std::lround(c[k] * 255);
+	p[3] = (uint8_t)std::lround(c[3] * 255);
+}
+
+// Le noyau de Kaiser pour une réduction de moitié : 8 poids pour les pixels source 2x-3 à 2x+4 du pixel destination x (dont le centre est entre les pixels source 2x et 2x+1).
+inline constexpr int kaiserNumTaps = 8;
+
+inline const std::array<float, kaiserNumTaps>& getKaiserWeights() {
+	static const std::array<float, kaiserNumTaps> weights = [] {
+		// Fonction de Bessel modifiée de premier type d'ordre 0, par sa série.
+		auto besselI0 = [](double x) {
+			double sum = 1, term = 1;
+			for (int k = 1; k < 32; k++) {
+				term *= (x / (2 * k)) * (x / (2 * k));
+				sum += term;
+			}
+			return sum;
+		};
+		constexpr double alpha = 4; // Compromis entre netteté et oscillations (ringing).
+		constexpr double radius = kaiserNumTaps / 4.0; // En pixels destination.
+		std::array<float, kaiserNumTaps> result = {};
+		double total = 0;
+		for (int i = 0; i < kaiserNumTaps; i++) {
+			// Distance entre le pixel source et le centre du pixel destination, en pixels destination.
+			double d = (i - kaiserNumTaps / 2 + 0.5) / 2;
+			double sinc = d == 0 ? 1 : std::sin(std::numbers::pi * d) / (std::numbers::pi * d);
+			double r = d / radius;
+			double window = besselI0(alpha * std::sqrt(std::max(0.0, 1 - r * r))) / besselI0(alpha);
+			result[i] = (float)(sinc * window);
+			total += result[i];
+		}
+		for (auto& w : result)
+			w = (float)(w / total);
+		return result;
+	}();
+	return weights;
+}
+
+inline void downsampleBox(const uint8_t* src, ivec2 srcSize, uint8_t* dst, ivec2 dstSize, bool gammaCorrect) {
+	auto& toLinear = getSrgbToLinearTable();
+	auto& toSrgb = getLinearToSrgbTable();
+	parallelFor(dstSize.y, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++) {
+			// Quand la dimension source est 1 (l'autre est encore réduite), les deux pixels de la moyenne sont le même.
+			const uint8_t* row0 = src + (size_t)std::min(2 * (int)y, srcSize.y - 1) * srcSize.x * 4;
+			const uint8_t* row1 = src + (size_t)std::min(2 * (int)y + 1, srcSize.y - 1) * srcSize.x * 4;
+			uint8_t* out = dst + y * dstSize.x * 4;
+			for (int x = 0; x < dstSize.x; x++) {
+				int x0 = std::min(2 * x, srcSize.x - 1) * 4;
+				int x1 = std::min(2 * x + 1, srcSize.x - 1) * 4;
+				vec4 sum = decodePixel(row0 + x0, gammaCorrect, toLinear) + decodePixel(row0 + x1, gammaCorrect, toLinear) +
+				           decodePixel(row1 + x0, gammaCorrect, toLinear) + decodePixel(row1 + x1, gammaCorrect, toLinear);
+				encodePixel(sum * 0.25f, out + x * 4, gammaCorrect, toSrgb);
+			}
+		}
+	}, minMipRowsPerThread);
+}
+
+inline void downsampleKaiser(const uint8_t* src, ivec2 srcSize, uint8_t* dst, ivec2 dstSize, bool gammaCorrect) {
+	auto& toLinear = getSrgbToLinearTable();
+	auto& toSrgb = getLinearToSrgbTable();
+	auto& weights = getKaiserWeights();
+	// Pixel source de la colonne (ou rangée) i du noyau pour le pixel destination x. Les bords sont étirés (clamp). Si la dimension n'est pas réduite (déjà à 1), on garde le pixel tel quel.
+	auto sourceIndex = [](int x, int i, int srcLength, int dstLength) {
+		if (srcLength == dstLength)
+			return x;
+		return std::clamp(2 * x - kaiserNumTaps / 2 + 1 + i, 0, srcLength - 1);
+	};
+	parallelFor(dstSize.y, [&](size_t begin, size_t end) {
+		// Le filtre est séparable : on filtre d'abord les rangées source horizontalement, puis on combine verticalement 8 rangées filtrées. Les rangées filtrées sont gardées dans un tampon circulaire de 8 rangées, car deux rangées destination consécutives en partagent 6.
+		std::vector<vec4> ring((size_t)kaiserNumTaps * dstSize.x);
+		std::array<int, kaiserNumTaps> ringRows;
+		ringRows.fill(-1);
+		auto getFilteredRow = [&](int srcY) {
+			vec4* row = &ring[(size_t)(srcY % kaiserNumTaps) * dstSize.x];
+			if (ringRows[srcY % kaiserNumTaps] == srcY)
+				return row;
+			ringRows[srcY % kaiserNumTaps] = srcY;
+			const uint8_t* in = src + (size_t)srcY * srcSize.x * 4;
+			for (int x = 0; x < dstSize.x; x++) {
+				if (srcSize.x == dstSize.x) {
+					row[x] = decodePixel(in + x * 4, gammaCorrect, toLinear);
+					continue;
+				}
+				vec4 sum = vec4(0);
+				for (int i = 0; i < kaiserNumTaps; i++)
+					sum += decodePixel(in + sourceIndex(x, i, srcSize.x, dstSize.x) * 4, gammaCorrect, toLinear) * weights[i];
+				row[x] = sum;
+			}
+			return row;
+		};
+
+		std::vector<const vec4*> rows(kaiserNumTaps);
+		for (size_t y = begin; y < end; y++) {
+			uint8_t* out = dst + y * dstSize.x * 4;
+			if (srcSize.y == dstSize.y) {
+				const vec4* row = getFilteredRow((int)y);
+				for (int x = 0; x < dstSize.x; x++)
+					encodePixel(row[x], out + x * 4, gammaCorrect, toSrgb);
+				continue;
+			}
+			// Les 8 rangées d'une fenêtre sont consécutives (ou répétées aux bords), donc elles occupent des cases différentes du tampon.
+			for (int i = 0; i < kaiserNumTaps; i++)
+				rows[i] = getFilteredRow(sourceIndex((int)y, i, srcSize.y, dstSize.y));
+			for (int x = 0; x < dstSize.x; x++) {
+				vec4 sum = vec4(0);
+				for (int i = 0; i < kaiserNumTaps; i++)
+					sum += rows[i][x] * weights[i];
+				encodePixel(sum, out + x * 4, gammaCorrect, toSrgb);
+			}
+		}
+	}, minMipRowsPerThread);
+}
+
+}
+
+// Construire la chaîne de mipmaps d'une image RGBA 8 bits. Si numLevels est 0 (ou plus grand que la chaîne complète), on va jusqu'à 1x1. Si gammaCorrect est faux, les composantes sont filtrées telles quelles (pour les textures qui ne sont pas des couleurs, comme les cartes de normales).
+inline MipChain buildMipChain(ivec2 size, const void* pixels, int numLevels = 0, MipmapFilter filter = MipmapFilter::Box, bool gammaCorrect = true) {
+	int maxLevels = getMaxMipLevels(size);
+	numLevels = numLevels <= 0 ? maxLevels : std::min(numLevels, maxLevels);
+
+	MipChain result;
+	result.sizes.reserve(numLevels);
+	result.levels.reserve(numLevels);
+	result.sizes.push_back(size);
+	result.levels.emplace_back((const uint8_t*)pixels, (const uint8_t*)pixels + (size_t)size.x * size.y * 4);
+	for (int i = 1; i < numLevels; i++) {
+		ivec2 srcSize = result.sizes.back();
+		ivec2 dstSize = getNextMipSize(srcSize);
+		std::vector<uint8_t> level((size_t)dstSize.x * dstSize.y * 4);
+		const uint8_t* src = result.levels.back().data();
+		if (filter == MipmapFilter::Kaiser)
+			mipmaps_detail::downsampleKaiser(src, srcSize, level.data(), dstSize, gammaCorrect);
+		else
+			mipmaps_detail::downsampleBox(src, srcSize, level.data(), dstSize, gammaCorrect);
+		result.sizes.push_back(dstSize);
+		result.levels.push_back(std::move(level));
+	}
+	return result;
+}
+
+
+// Entête d'un fichier de cache de mipmaps. Le fichier contient l'entête, suivi des pixels de chaque niveau mis bout à bout (du niveau 0 au plus petit). Les images sont déjà renversées dans la convention d'OpenGL (voir Texture::loadFromImage).
+struct MipCacheHeader
+{
+	char magic[4]; // Toujours "I27X".
+	uint32_t version; // Incrémenté à chaque changement du format ou des filtres.
+	uint64_t sourceHash; // Hash du fichier source. Si le fichier source change, le cache est invalide.
+	int32_t width;
+	int32_t height;
+	uint32_t numLevels;
+	uint32_t filter; // Un MipmapFilter.
+	uint32_t gammaCorrect;
+	uint32_t padding;
+};
+
+inline constexpr char mipCacheMagic[4] = {'I', '2', '7', 'X'};
+inline constexpr uint32_t mipCacheVersion = 1;
+
+// Lire un cache de mipmaps. Retourne faux si le cache est absent, corrompu, d'une autre version ou généré à partir d'une source ou de paramètres différents.
+inline bool loadMipChainFromCache(std::string_view cacheFilename, uint64_t sourceHash, int numLevels, MipmapFilter filter, bool gammaCorrect, MipChain& result) {
+	MappedFile cache(cacheFilename);
+	if (not cache.isOpen() or cache.size() < sizeof(MipCacheHeader))
+		return false;
+
+	MipCacheHeader header = {};
+	std::memcpy(&header, cache.data(), sizeof(header));
+	bool isValid = std::memcmp(header.magic, mipCacheMagic, sizeof(header.magic)) == 0 and
+	               header.version == mipCacheVersion and
+	               header.sourceHash == sourceHash and
+	               header.width > 0 and header.height > 0 and
+	               header.filter == (uint32_t)filter and
+	               header.gammaCorrect == (uint32_t)gammaCorrect;
+	if (not isValid)
+		return false;
+	ivec2 size = {header.width, header.height};
+	int maxLevels = getMaxMipLevels(size);
+	if ((int)header.numLevels != (numLevels <= 0 ? maxLevels : std::min(numLevels, maxLevels)))
+		return false;
+
+	// Valider la taille totale avant de copier.
+	size_t dataSize = 0;
+	for (uint32_t i = 0; i < header.numLevels; i++, size = getNextMipSize(size))
+		dataSize += (size_t)size.x * size.y * 4;
+	if (cache.size() - sizeof(MipCacheHeader) != dataSize)
+		return false;
+
+	result = {};
+	size = {header.width, header.height};
+	size_t offset = sizeof(MipCacheHeader);
+	for (uint32_t i = 0; i < header.numLevels; i++, size = getNextMipSize(size)) {
+		size_t levelSize = (size_t)size.x * size.y * 4;
+		result.sizes.push_back(size);
+		result.levels.emplace_back((const uint8_t*)cache.data() + offset, (const uint8_t*)cache.data() + offset + levelSize);
+		offset += levelSize;
+	}
+	return true;
+}
+
+// Écrire un cache de mipmaps.
+inline bool saveMipChainToCache(std::string_view cacheFilename, uint64_t sourceHash, MipmapFilter filter, bool gammaCorrect, const MipChain& chain) {
+	MipCacheHeader header = {};
+	std::memcpy(header.magic, mipCacheMagic, sizeof(header.magic));
+	header.version = mipCacheVersion;
+	header.sourceHash = sourceHash;
+	header.width = chain.sizes[0].x;
+	header.height = chain.sizes[0].y;
+	header.numLevels = (uint32_t)chain.getNumLevels();
+	header.filter = (uint32_t)filter;
+	header.gammaCorrect = (uint32_t)gammaCorrect;
+	return writeFileAtomically(std::string(cacheFilename), [&](std::ofstream& file) {
+		file.write((const char*)&header, sizeof(header));
+		for (auto&& level : chain.levels)
+			file.write((const char*)level.data(), level.size());
+	});
+}
+
+// Le nom du fichier de cache d'une image, à côté de la source. Les paramètres de construction en font partie, pour que les chargements d'une même image avec des nombres de niveaux ou des filtres différents aient chacun leur cache, au lieu de réécrire le même fichier à tour de rôle.
+inline std::string getMipCacheFilename(std::string_view filename, int numLevels, MipmapFilter filter, bool gammaCorrect) {
+	int32_t params[] = {std::max(numLevels, 0), (int32_t)filter, (int32_t)gammaCorrect};
+	uint64_t paramsHash = hashBytes(params, sizeof(params));
+	return std::format("{}.{:08x}.mipcache", filename, (uint32_t)(paramsHash ^ (paramsHash >> 32)));
+}
+
+// Décoder une image encodée (PNG, JPEG, etc.) déjà en mémoire, la renverser verticalement (voir Texture::loadFromImage) et construire ses mipmaps. Retourne une chaîne vide si l'image ne peut pas être décodée (l'erreur est affichée avec filename).
+inline MipChain buildMipChainFromEncodedImage(const void* data, size_t size, const std::string& filename, int numLevels = 0, MipmapFilter filter = MipmapFilter::Box, bool gammaCorrect = true) {
+	sf::Image img;
+	if (not img.loadFromMemory(data, size)) {
+		std::cerr << std::format("{} could not be loaded", filename) << "\n";
+		return {};
+	}
+	img.flipVertically();
+	return buildMipChain(ivec2(img.getSize().x, img.getSize().y), img.getPixelsPtr(), numLevels, filter, gammaCorrect);
+}
+
+// Charger une image, la renverser verticalement et construire ses mipmaps, en passant par un cache binaire enregistré à côté du fichier source (voir getMipCacheFilename). Aux chargements suivants, ni le décodage de l'image ni le filtrage ne sont refaits. Comme pour Mesh::loadFromWavefrontFileCached, le cache est validé par le hash du fichier source.
+// Avec un seul niveau, il n'y a pas de filtrage à éviter, et le cache serait une copie non compressée de l'image plus grosse que le fichier source : l'image est simplement décodée.
+// Retourne une chaîne vide si l'image ne peut pas être chargée (l'erreur est affichée).
+inline MipChain loadMipChainFromFileCached(const std::string& filename, int numLevels = 0, MipmapFilter filter = MipmapFilter::Box, bool gammaCorrect = true) {
+	MappedFile source(filename);
+	if (not source.isOpen()) {
+		std::cerr << std::format("{} could not be loaded", filename) << "\n";
+		return {};
+	}
+	if (numLevels == 1)
+		return buildMipChainFromEncodedImage(source.data(), source.size(), filename, numLevels, filter, gammaCorrect);
+
+	std::string cacheFilename = getMipCacheFilename(filename, numLevels, filter, gammaCorrect);
+	uint64_t sourceHash = hashBytes(source.data(), source.size());
+
+	MipChain result;
+	if (loadMipChainFromCache(cacheFilename, sourceHash, numLevels, filter, gammaCorrect, result))
+		return result;
+
+	// Cache absent ou périmé : décoder l'image à partir du fichier déjà projeté en mémoire.
+	result = buildMipChainFromEncodedImage(source.data(), source.size(), filename, numLevels, filter, gammaCorrect);
+	if (result.levels.empty())
+		return result;
+	if (not saveMipChainToCache(cacheFilename, sourceHash, filter, gammaCorrect, result))
+		std::cerr << std::format("WARNING Mipmaps: could not write cache file {}", cacheFilename) << "\n";
+	return result;
+}
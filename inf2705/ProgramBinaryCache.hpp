@@ -0,0 +1,116 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+#include "utils.hpp"
+
+
+using namespace gl;
+
+
+// Un cache sur le disque des programmes nuanceurs déjà liés, pour ne pas recompiler les mêmes sources à chaque lancement. Le pilote donne le programme lié sous forme binaire (glGetProgramBinary) et peut le recharger directement (glProgramBinary), sans compilation ni édition des liens.
+// Le binaire n'est valide que pour le pilote qui l'a produit : le cache garde aussi un hash du fabricant, du GPU et de la version du pilote. Le pilote peut quand même refuser un binaire (par exemple après une mise à jour qui ne change pas la version affichée), il faut donc toujours pouvoir revenir à la compilation. Voir ShaderProgram::link.
+
+
+// glGetProgramBinary fait partie d'OpenGL 4.1, mais un pilote peut ne supporter aucun format de binaire (c'est le cas sur macOS). Il n'y a alors rien à mettre en cache.
+inline bool isProgramBinarySupported() {
+	static const bool result = [] {
+		GLint numFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		return numFormats > 0;
+	}();
+	return result;
+}
+
+// Hash du pilote courant (fabricant, GPU, version).
+inline uint64_t getProgramBinaryDriverHash() {
+	static const uint64_t result = [] {
+		uint64_t hash = hashBytes(nullptr, 0);
+		for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+			auto str = (const char*)glGetString(name);
+			if (str != nullptr)
+				hash = hashBytes(str, std::strlen(str) + 1, hash);
+		}
+		return hash;
+	}();
+	return result;
+}
+
+
+// L'en-tête du fichier de cache. Le binaire du programme suit directement.
+struct ProgramCacheHeader
+{
+	char magic[4]; // Toujours "I27P".
+	uint32_t version; // Incrémenté à chaque changement du format.
+	uint64_t sourceHash; // Hash des sources, des définitions et de l'état appliqué avant l'édition des liens. Si une source change, le cache est invalide.
+	uint64_t driverHash; // Voir getProgramBinaryDriverHash.
+	uint32_t binaryFormat; // Le format donné par glGetProgramBinary, à redonner à glProgramBinary.
+	uint32_t binarySize;
+};
+
+inline constexpr char programCacheMagic[4] = {'I', '2', '7', 'P'};
+inline constexpr uint32_t programCacheVersion = 1;
+
+// Le nom du fichier de cache d'un programme, à côté de sa première source. identityHash distingue les programmes qui commencent par la même source (les noms des fichiers et les définitions, pas leur contenu, pour que le fichier soit réécrit plutôt que multiplié quand les sources changent).
+inline std::string getProgramCacheFilename(std::string_view firstSourceFilename, uint64_t identityHash) {
+	return std::format("{}.{:08x}.progcache", firstSourceFilename, (uint32_t)(identityHash ^ (identityHash >> 32)));
+}
+
+// Charger le binaire dans le programme. Retourne faux si le cache est absent, invalide, ou si le pilote le refuse ; le programme doit alors être compilé et lié normalement.
+inline bool loadProgramBinaryFromCache(std::string_view cacheFilename, uint64_t sourceHash, GLuint program) {
+	MappedFile cache(cacheFilename);
+	if (not cache.isOpen() or cache.size() < sizeof(ProgramCacheHeader))
+		return false;
+
+	ProgramCacheHeader header = {};
+	std::memcpy(&header, cache.data(), sizeof(header));
+	bool isValid = std::memcmp(header.magic, programCacheMagic, sizeof(header.magic)) == 0 and
+	               header.version == programCacheVersion and
+	               header.sourceHash == sourceHash and
+	               header.driverHash == getProgramBinaryDriverHash() and
+	               cache.size() - sizeof(ProgramCacheHeader) == header.binarySize;
+	if (not isValid)
+		return false;
+
+	glProgramBinary(program, (GLenum)header.binaryFormat, (const uint8_t*)cache.data() + sizeof(ProgramCacheHeader), (GLsizei)header.binarySize);
+	GLint isLinked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+	return isLinked != 0;
+}
+
+// Enregistrer le binaire d'un programme lié. Le programme doit avoir été lié avec GL_PROGRAM_BINARY_RETRIEVABLE_HINT, sinon certains pilotes ne donnent rien.
+inline bool saveProgramBinaryToCache(std::string_view cacheFilename, uint64_t sourceHash, GLuint program) {
+	GLint binarySize = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+	if (binarySize <= 0)
+		return false;
+	std::vector<uint8_t> binary(binarySize);
+	GLenum binaryFormat = {};
+	GLsizei writtenSize = 0;
+	glGetProgramBinary(program, binarySize, &writtenSize, &binaryFormat, binary.data());
+	if (writtenSize <= 0)
+		return false;
+
+	ProgramCacheHeader header = {};
+	std::memcpy(header.magic, programCacheMagic, sizeof(header.magic));
+	header.version = programCacheVersion;
+	header.sourceHash = sourceHash;
+	header.driverHash = getProgramBinaryDriverHash();
+	header.binaryFormat = (uint32_t)binaryFormat;
+	header.binarySize = (uint32_t)writtenSize;
+	return writeFileAtomically(std::string(cacheFilename), [&](std::ofstream& file) {
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)binary.data(), writtenSize);
+	});
+}
@@ -10,6 +10,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <type_traits>
+#include <vector>
 
 #include <glbinding/gl/gl.h>
 #include <glm/glm.hpp>
@@ -18,6 +19,7 @@
 
 #include "utils.hpp"
 #include "TransformStack.hpp"
+#include "ProgramBinaryCache.hpp"
 
 
 using namespace gl;
@@ -35,8 +37,12 @@ public:
 
 	ShaderProgram(GLuint obj) : programObject_(obj) { }
 
-	// Le code donné par OpenGL
-	GLuint getObject() const { return programObject_; }
+	// Le code donné par OpenGL. Avant l'édition des liens, on ne peut pas savoir quel état est modifié directement sur l'objet (glTransformFeedbackVaryings, glBindFragDataLocation, etc.), donc link() n'utilise alors pas le cache binaire.
+	GLuint getObject() const {
+		if (not isLinked_)
+			hasUntrackedPreLinkState_ = true;
+		return programObject_;
+	}
 
 	const std::unordered_set<GLuint>& getShaderObjects(GLenum type) const {
 		static const std::unordered_set<GLuint> emptyValue;
@@ -56,27 +62,10 @@ public:
 		if (programObject_ == 0)
 			create();
 
-		// Créer le nuanceur.
-		GLuint shaderObject = glCreateShader(type);
-		if (shaderObject == 0)
-			return 0;
-
 		// Charger la source et compiler.
-		std::string source = readFile(filename);
-		auto src = source.c_str();
-		glShaderSource(shaderObject, 1, &src, nullptr);
-		glCompileShader(shaderObject);
-
-		// Afficher le message d'erreur si applicable.
-		GLint infologLength = 0;
-		glGetShaderiv(shaderObject, GL_INFO_LOG_LENGTH, &infologLength);
-		if (infologLength > 1) {
-			std::string infoLog(infologLength, '\0');
-			glGetShaderInfoLog(shaderObject, infologLength, nullptr, infoLog.data());
-			std::cerr << std::format("Compilation Error in '{}':\n{}", filename, infoLog) << std::endl;
-			glDeleteShader(shaderObject);
+		GLuint shaderObject = compileShader(type, readFile(filename), filename);
+		if (shaderObject == 0)
 			return 0;
-		}
 
 		// Attacher au programme.
 		attachExistingShader(type, shaderObject);
@@ -84,6 +73,18 @@ public:
 		return shaderObject;
 	}
 
+	// Comme attachSourceFile, mais la compilation est reportée à link(), qui la saute si le programme lié est déjà dans le cache binaire (voir ProgramBinaryCache.hpp). Il n'y a donc pas d'objet de nuanceur à retourner.
+	void addSourceFile(GLenum type, std::string_view filename) {
+		if (programObject_ == 0)
+			create();
+		pendingSources_.push_back({type, std::string(filename), readFile(filename)});
+	}
+
+	// Ajouter un #define aux sources ajoutées avec addSourceFile (avant ou après l'ajout, tant que c'est avant link()), pour faire des variantes d'un même nuanceur. Les définitions font partie de la clé du cache.
+	void addDefine(std::string_view name, std::string_view value = "") {
+		defines_ += std::format("#define {} {}\n", name, value);
+	}
+
 	void attachExistingShader(GLenum type, GLuint shaderObject) {
 		// Attacher au programme.
 		glAttachShader(programObject_, shaderObject);
@@ -91,8 +92,48 @@ public:
 		shadersByType_[type].insert(shaderObject);
 	}
 
-	// Faire l'édition des liens du programme
+	// Faire l'édition des liens du programme. S'il y a des sources ajoutées avec addSourceFile, on essaie d'abord de charger le programme déjà lié à partir du cache binaire. Si le cache est absent, périmé ou refusé par le pilote, les sources sont compilées et liées normalement, puis le cache est réécrit.
+	// L'état appliqué avant l'édition des liens par setAttribLocation, setFragDataLocation et setTransformFeedbackVaryings fait partie de la clé du cache. Tout autre état appliqué à l'objet obtenu par getObject() fait sauter le cache.
 	bool link() {
+		isLinked_ = true;
+		if (pendingSources_.empty())
+			return linkAttachedShaders();
+
+		auto sources = std::move(pendingSources_);
+		pendingSources_.clear();
+		std::string cacheFilename;
+		uint64_t sourceHash = 0;
+		if (isProgramBinarySupported() and not hasUntrackedPreLinkState_) {
+			uint64_t identityHash = hashBytes(defines_.data(), defines_.size());
+			sourceHash = hashBytes(defines_.data(), defines_.size());
+			sourceHash = hashBytes(preLinkState_.data(), preLinkState_.size(), sourceHash);
+			for (auto&& src : sources) {
+				identityHash = hashBytes(&src.type, sizeof(src.type), identityHash);
+				identityHash = hashBytes(src.filename.data(), src.filename.size() + 1, identityHash);
+				sourceHash = hashBytes(&src.type, sizeof(src.type), sourceHash);
+				sourceHash = hashBytes(src.source.data(), src.source.size() + 1, sourceHash);
+			}
+			cacheFilename = getProgramCacheFilename(sources[0].filename, identityHash);
+			if (loadProgramBinaryFromCache(cacheFilename, sourceHash, programObject_))
+				return true;
+			// Demander au pilote de garder le binaire pour pouvoir le lire après l'édition des liens.
+			glProgramParameteri(programObject_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, 1);
+		}
+
+		for (auto&& src : sources) {
+			GLuint shaderObject = compileShader(src.type, insertDefines(src.source), src.filename);
+			if (shaderObject == 0)
+				return false;
+			attachExistingShader(src.type, shaderObject);
+		}
+		if (not linkAttachedShaders())
+			return false;
+		if (not cacheFilename.empty() and not saveProgramBinaryToCache(cacheFilename, sourceHash, programObject_))
+			std::cerr << std::format("ShaderProgram: {} could not be written", cacheFilename) << "\n";
+		return true;
+	}
+
+	bool linkAttachedShaders() {
 		glLinkProgram(programObject_);
 
 		// Afficher le message d'erreur si applicable.
@@ -226,6 +267,22 @@ public:
 
 	void setAttribLocation(GLuint index, std::string_view name) {
 		glBindAttribLocation(programObject_, index, name.data());
+		// Les liaisons sont appliquées à l'édition des liens, donc incluses dans le binaire du cache.
+		preLinkState_ += std::format("attrib {} {}\n", index, name);
+	}
+
+	void setFragDataLocation(GLuint colorNumber, std::string_view name) {
+		glBindFragDataLocation(programObject_, colorNumber, std::string(name).c_str());
+		preLinkState_ += std::format("frag {} {}\n", colorNumber, name);
+	}
+
+	// Comme glTransformFeedbackVaryings, doit être appelée AVANT l'édition des liens.
+	void setTransformFeedbackVaryings(const std::vector<const char*>& names, GLenum bufferMode) {
+		glTransformFeedbackVaryings(programObject_, (GLsizei)names.size(), names.data(), bufferMode);
+		preLinkState_ += std::format("varyings {}", (int)bufferMode);
+		for (auto&& name : names)
+			preLinkState_ += std::format(" {}", name);
+		preLinkState_ += "\n";
 	}
 
 	GLuint getUniformLocation(std::string_view name) const {
@@ -237,8 +294,56 @@ public:
 	}
 
 private:
+	struct PendingSource
+	{
+		GLenum type;
+		std::string filename;
+		std::string source;
+	};
+
+	static GLuint compileShader(GLenum type, const std::string& source, std::string_view filename) {
+		// Créer le nuanceur.
+		GLuint shaderObject = glCreateShader(type);
+		if (shaderObject == 0)
+			return 0;
+
+		auto src = source.c_str();
+		glShaderSource(shaderObject, 1, &src, nullptr);
+		glCompileShader(shaderObject);
+
+		// Afficher le message d'erreur si applicable.
+		GLint infologLength = 0;
+		glGetShaderiv(shaderObject, GL_INFO_LOG_LENGTH, &infologLength);
+		if (infologLength > 1) {
+			std::string infoLog(infologLength, '\0');
+			glGetShaderInfoLog(shaderObject, infologLength, nullptr, infoLog.data());
+			std::cerr << std::format("Compilation Error in '{}':\n{}", filename, infoLog) << std::endl;
+			glDeleteShader(shaderObject);
+			return 0;
+		}
+		return shaderObject;
+	}
+
+	// Les définitions doivent suivre la directive #version, qui doit être la première du fichier (seulement précédée de commentaires).
+	std::string insertDefines(const std::string& source) const {
+		if (defines_.empty())
+			return source;
+		size_t versionPos = source.find("#version");
+		if (versionPos == std::string::npos)
+			return defines_ + source;
+		size_t lineEnd = source.find('\n', versionPos);
+		if (lineEnd == std::string::npos)
+			return source + "\n" + defines_;
+		return source.substr(0, lineEnd + 1) + defines_ + source.substr(lineEnd + 1);
+	}
+
 	GLuint programObject_ = 0; // Le ID de programme nuanceur.
 	std::unordered_map<GLenum, std::unordered_set<GLuint>> shadersByType_; // Les nuanceurs.
+	std::vector<PendingSource> pendingSources_; // Les sources à compiler par link() (voir addSourceFile).
+	std::string defines_; // Les #define ajoutés aux sources en attente.
+	std::string preLinkState_; // L'état appliqué avant l'édition des liens qui fait partie de la clé du cache.
+	bool isLinked_ = false; // Si link() a déjà été appelée.
+	mutable bool hasUntrackedPreLinkState_ = false; // Si l'objet a été exposé par getObject() avant l'édition des liens (voir link()).
 };
 
 // Une variable uniforme qui se rappelle de ses localisations pour chaque programme nuanceur. On peut accéder à la valeur sous-jacente avec get() ou comme un pointeur avec * et ->.
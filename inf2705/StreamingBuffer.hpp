@@ -0,0 +1,191 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+
+using namespace gl;
+
+
+// Outils pour mettre à jour des tampons OpenGL à chaque trame sans réallouer leur mémoire et sans attendre après le GPU.
+
+
+// Le contexte OpenGL courant est-il au moins de la version major.minor, ou a-t-il l'extension donnée? Les exemples visent OpenGL 4.1 (le maximum sur macOS), donc les fonctionnalités plus récentes doivent être vérifiées à l'exécution.
+inline bool isOpenGLVersionOrExtensionSupported(int major, int minor, std::string_view extension = {}) {
+	GLint contextMajor = 0, contextMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+	if (contextMajor > major or (contextMajor == major and contextMinor >= minor))
+		return true;
+	if (extension.empty())
+		return false;
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; i++) {
+		auto name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name != nullptr and extension == name)
+			return true;
+	}
+	return false;
+}
+
+// glBufferStorage et les projections persistantes demandent OpenGL 4.4 (ou l'extension ARB_buffer_storage).
+inline bool isBufferStorageSupported() {
+	static const bool result = isOpenGLVersionOrExtensionSupported(4, 4, "GL_ARB_buffer_storage");
+	return result;
+}
+
+
+// Envoyer size octets au début du tampon lié à target, en remplaçant tout son contenu. La capacité déjà allouée (capacity octets) est gardée tant que les données y tiennent. Sinon le tampon est réalloué, avec 50 % de marge s'il avait déjà été alloué, puisqu'un tampon qui grandit va probablement grandir encore.
+// Le tampon est d'abord rendu orphelin (glBufferData avec nullptr, de la même taille) : le pilote donne une nouvelle mémoire au tampon pendant que les tracés déjà soumis lisent encore l'ancienne. Un glBufferSubData directement dans la mémoire que le GPU lit peut l'obliger à attendre la fin de ces tracés.
+inline void uploadToBuffer(GLenum target, const void* data, size_t size, size_t& capacity, GLenum usageMode) {
+	if (size <= capacity) {
+		glBufferData(target, capacity, nullptr, usageMode);
+		glBufferSubData(target, 0, size, data);
+	} else if (capacity == 0) {
+		glBufferData(target, size, data, usageMode);
+		capacity = size;
+	} else {
+		capacity = std::max(size, capacity + capacity / 2);
+		glBufferData(target, capacity, nullptr, usageMode);
+		glBufferSubData(target, 0, size, data);
+	}
+}
+
+
+// Un ensemble de plages modifiées [début, fin[ dans un tableau, fusionnées au besoin. Sert à n'envoyer au GPU que les parties d'un tableau qui ont changé.
+class DirtyRanges
+{
+public:
+	bool isEmpty() const { return ranges_.empty(); }
+	void clear() { ranges_.clear(); }
+
+	void add(size_t first, size_t count) {
+		if (count != 0)
+			ranges_.push_back({first, first + count});
+	}
+
+	// Les plages triées, avec celles qui se touchent ou se chevauchent fusionnées. Deux plages séparées par moins de mergeGap éléments sont aussi fusionnées, puisqu'un appel de plus à glBufferSubData coûte plus cher que quelques éléments de trop.
+	const std::vector<std::pair<size_t, size_t>>& getMerged(size_t mergeGap = 0) {
+		std::sort(ranges_.begin(), ranges_.end());
+		size_t numMerged = 0;
+		for (auto&& range : ranges_) {
+			if (numMerged > 0 and range.first <= ranges_[numMerged - 1].second + mergeGap)
+				ranges_[numMerged - 1].second = std::max(ranges_[numMerged - 1].second, range.second);
+			else
+				ranges_[numMerged++] = range;
+		}
+		ranges_.resize(numMerged);
+		return ranges_;
+	}
+
+private:
+	std::vector<std::pair<size_t, size_t>> ranges_;
+};
+
+
+// Un tampon en anneau de numRegions régions, pour la géométrie qui change au complet à chaque trame. On écrit dans une région pendant que le GPU lit encore les régions précédentes, donc pas de synchronisation implicite. Une clôture (fence) est placée après les tracés qui utilisent une région, et on ne l'attend que si on revient à cette région avant que le GPU ait fini (ce qui n'arrive à peu près jamais avec trois régions).
+// Avec OpenGL 4.4, le tampon est alloué une fois avec glBufferStorage et projeté en mémoire de façon persistante et cohérente : on écrit directement dans la mémoire visible par le GPU, sans aucun appel OpenGL. Sinon, on écrit dans une copie locale qui est envoyée avec glBufferSubData dans la région (le tampon n'est quand même jamais réalloué).
+class StreamingRingBuffer
+{
+public:
+	static constexpr int numRegions = 3;
+
+	// Comme pour les Mesh, les copies partagent les mêmes objets OpenGL, qui doivent être supprimés explicitement une seule fois avec deleteObjects().
+	GLuint getBuffer() const { return buffer_; }
+	size_t getRegionSize() const { return regionSize_; }
+	// Le décalage en octets de la région courante dans le tampon.
+	size_t getRegionOffset() const { return currentRegion_ * regionSize_; }
+	int getCurrentRegion() const { return currentRegion_; }
+	bool isPersistent() const { return mappedData_ != nullptr; }
+
+	// Créer le tampon avec des régions de regionSize octets. Le tampon est lié à target après l'appel.
+	void create(GLenum target, size_t regionSize) {
+		deleteObjects();
+		target_ = target;
+		regionSize_ = regionSize;
+		currentRegion_ = numRegions - 1;
+
+		glGenBuffers(1, &buffer_);
+		glBindBuffer(target_, buffer_);
+		size_t totalSize = regionSize_ * numRegions;
+		if (isBufferStorageSupported()) {
+			// Stockage immuable : la taille ne peut plus changer, ce qui permet la projection persistante.
+			glBufferStorage(target_, totalSize, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+			mappedData_ = (char*)glMapBufferRange(target_, 0, totalSize, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+		} else {
+			glBufferData(target_, totalSize, nullptr, GL_STREAM_DRAW);
+			stagingData_.resize(regionSize_);
+		}
+	}
+
+	// Passer à la région suivante et retourner un pointeur où écrire ses size octets (au plus getRegionSize()). Attend le GPU seulement s'il utilise encore cette région.
+	void* beginWrite() {
+		currentRegion_ = (currentRegion_ + 1) % numRegions;
+		waitForRegion(currentRegion_);
+		if (mappedData_ != nullptr)
+			return mappedData_ + getRegionOffset();
+		else
+			return stagingData_.data();
+	}
+
+	// Terminer l'écriture de size octets dans la région courante. Avec la projection persistante et cohérente, il n'y a rien à faire.
+	void endWrite(size_t size) {
+		if (mappedData_ == nullptr) {
+			glBindBuffer(target_, buffer_);
+			glBufferSubData(target_, getRegionOffset(), std::min(size, regionSize_), stagingData_.data());
+		}
+	}
+
+	// Placer une clôture après les tracés qui lisent la région courante. À appeler après le dernier tracé qui l'utilise (on peut l'appeler après chaque tracé, seule la dernière clôture est gardée).
+	void fenceCurrentRegion() {
+		if (fences_[currentRegion_] != nullptr)
+			glDeleteSync(fences_[currentRegion_]);
+		fences_[currentRegion_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, UnusedMask::GL_NONE_BIT);
+	}
+
+	void deleteObjects() {
+		if (buffer_ == 0)
+			return;
+		for (int i = 0; i < numRegions; i++) {
+			waitForRegion(i);
+		}
+		if (mappedData_ != nullptr) {
+			glBindBuffer(target_, buffer_);
+			glUnmapBuffer(target_);
+			mappedData_ = nullptr;
+		}
+		glDeleteBuffers(1, &buffer_);
+		buffer_ = 0;
+		stagingData_.clear();
+	}
+
+private:
+	void waitForRegion(int region) {
+		GLsync& fence = fences_[region];
+		if (fence == nullptr)
+			return;
+		// On vide les commandes au premier essai pour que la clôture soit garantie d'être atteinte, puis on attend par tranches d'une milliseconde.
+		GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(fence, SyncObjectMask::GL_NONE_BIT, 1'000'000);
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	GLuint buffer_ = 0;
+	GLenum target_ = GL_ARRAY_BUFFER;
+	size_t regionSize_ = 0;
+	int currentRegion_ = 0;
+	char* mappedData_ = nullptr;
+	std::vector<char> stagingData_;
+	GLsync fences_[numRegions] = {};
+};
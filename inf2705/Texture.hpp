@@ -4,14 +4,23 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <format>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
 
 #include <glbinding/gl/gl.h>
 #include <glm/glm.hpp>
 #include <SFML/Graphics.hpp>
 
 #include "sfml_utils.hpp"
+#include "Mipmaps.hpp"
+#include "TextureCompression.hpp"
+#include "TextureBinding.hpp"
+#include "TextureFormat.hpp"
 #include "ShaderProgram.hpp"
 
 
@@ -24,10 +33,14 @@ struct Texture
 	GLuint id = 0; // L'objet donné par OpenGL.
 	ivec2 size = {}; // La taille de l'image sous-jacente.
 	int numLevels = 0; // Le nombre de niveaux de détails (mipmap ou manuel).
+	GLuint sampler = 0; // L'objet d'échantillonnage partagé (voir setSampling), lié avec la texture.
+	GLenum internalFormat = GL_NONE; // Le format sur le GPU, choisi à l'allocation.
+	size_t memorySize = 0; // La mémoire prise sur le GPU par tous les niveaux (voir TextureMemoryStats).
 
+	// Les liaisons passent par le suivi de getTextureBindings(), qui évite les appels redondants quand la même texture reste liée d'un tracé à l'autre.
 	void bindToTextureUnit(int textureUnit) {
-		glActiveTexture(GL_TEXTURE0 + textureUnit);
-		glBindTexture(GL_TEXTURE_2D, id);
+		getTextureBindings().bindTexture(textureUnit, GL_TEXTURE_2D, id);
+		getTextureBindings().bindSampler(textureUnit, sampler);
 	}
 
 	void bindToTextureUnit(int textureUnit, ShaderProgram& prog, std::string_view name) {
@@ -40,57 +53,141 @@ struct Texture
 		prog.setInt(loc, textureUnit);
 	}
 
+	// Choisir les paramètres de filtrage et de répétition. Les textures qui ont les mêmes paramètres partagent un même objet d'échantillonnage (voir SamplerCache), au lieu de faire des glTexParameteri sur chaque texture.
+	void setSampling(const TextureSampling& sampling) {
+		TextureSampling concrete = sampling;
+		concrete.minFilter = sampling.getMinFilterFor(numLevels);
+		sampler = getSamplers().get(concrete);
+	}
+
+	// Allouer d'un coup le stockage de tous les niveaux (size et numLevels doivent être choisis). Le stockage est immuable : sa taille et son format ne changent plus, on ne fait ensuite que remplacer des pixels avec glTexSubImage2D. Le pilote n'a donc pas à vérifier à chaque tracé que les niveaux sont complets et cohérents, ce qu'il doit faire avec des glTexImage2D séparés.
+	// Une texture ne peut donc être allouée qu'une fois (glTexStorage2D échouerait, et la mémoire serait comptée deux fois dans TextureMemoryStats). Pour changer de taille ou de format, il faut une nouvelle texture (deleteObject, puis glGenTextures).
+	void allocateStorage(GLenum format = GL_RGBA8) {
+		if (memorySize != 0) {
+			std::cerr << std::format("Texture: le stockage de la texture {} est déjà alloué", id) << "\n";
+			return;
+		}
+		getTextureBindings().bindForEditing(GL_TEXTURE_2D, id);
+		numLevels = std::clamp(numLevels, 1, getMaxMipLevels(size));
+		internalFormat = format;
+		size_t numTexels = getMipChainNumTexels(size, numLevels);
+		memorySize = numTexels * getInternalFormatTexelSize(format);
+		getTextureMemoryStats().add(format, memorySize, numTexels * 4);
+		if (isTextureStorageSupported()) {
+			glTexStorage2D(GL_TEXTURE_2D, numLevels, format, size.x, size.y);
+			return;
+		}
+		// Sans glTexStorage2D (OpenGL 4.1, donc macOS), allouer chaque niveau sans données, et limiter les niveaux utilisés (voir loadFromMipmapFiles).
+		ivec2 levelSize = size;
+		for (int i = 0; i < numLevels; i++) {
+			glTexImage2D(GL_TEXTURE_2D, i, format, levelSize.x, levelSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			levelSize = getNextMipSize(levelSize);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+	}
+
+	// Allouer le stockage avec le format d'une disposition de canaux (voir TexelLayout), et le masque de permutation qui fait lire .rgba au nuanceur comme si la texture était RGBA.
+	void allocateStorage(TexelLayout layout) {
+		allocateStorage(getTexelLayoutInternalFormat(layout));
+		if (layout != TexelLayout::Rgba) {
+			auto swizzle = getTexelLayoutSwizzle(layout);
+			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle.data());
+		}
+	}
+
+	// Remplacer les pixels du niveau 0 avec glTexSubImage2D, qui n'alloue rien : le stockage doit déjà être alloué (voir allocateStorage). S'il ne l'est pas encore, il est alloué ici en RGBA8 avec size et numLevels.
 	void setPixelData(GLenum format, const void* data) {
-		glBindTexture(GL_TEXTURE_2D, id);
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0,
-			format,
-			size.x,
-			size.y,
-			0,
-			format,
-			GL_UNSIGNED_BYTE,
-			data
-		);
+		if (memorySize == 0)
+			allocateStorage();
+		getTextureBindings().bindForEditing(GL_TEXTURE_2D, id);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.x, size.y, format, GL_UNSIGNED_BYTE, data);
 	}
 
 	void deleteObject() {
+		if (id != 0 and memorySize != 0)
+			getTextureMemoryStats().remove(internalFormat, memorySize, getMipChainNumTexels(size, numLevels) * 4);
+		memorySize = 0;
+		getTextureBindings().forgetTexture(id);
 		glDeleteTextures(1, &id);
 		id = 0;
 	}
 
+	// Envoyer au niveau level (déjà alloué) de la texture liée des pixels RGBA 8 bits, en ne gardant que les canaux de la disposition (voir TexelLayout). Si isTopDown est vrai, la première rangée est en haut de l'image (la convention de SFML et de la plupart des bibliothèques d'images) et les rangées sont renversées pendant l'envoi, sans image temporaire sur le CPU.
+	// Les rangées sont copiées (réduites et dans l'ordre voulu) directement dans un tampon de pixels (PBO) projeté en mémoire, puis glTexSubImage2D lit le tampon. C'est la seule copie, que le pilote aurait faite de toute façon avec un pointeur client : le pic de mémoire reste à une seule copie de l'image.
+	static void uploadPixels(int level, ivec2 size, const void* pixels, TexelLayout layout = TexelLayout::Rgba, bool isTopDown = false) {
+		GLenum format = getTexelLayoutPixelFormat(layout);
+		// Rien à réduire ni à renverser : les pixels sont passés tels quels.
+		if (layout == TexelLayout::Rgba and not isTopDown) {
+			glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, size.x, size.y, format, GL_UNSIGNED_BYTE, pixels);
+			return;
+		}
+
+		size_t srcRowSize = (size_t)size.x * 4;
+		size_t rowSize = (size_t)size.x * getTexelLayoutNumChannels(layout);
+		size_t totalSize = rowSize * size.y;
+		auto src = (const uint8_t*)pixels;
+		auto getSrcRow = [&](int y) { return src + (size_t)(isTopDown ? size.y - 1 - y : y) * srcRowSize; };
+		// Les rangées de 1 à 3 octets par texel ne sont pas forcément alignées sur 4 octets (l'alignement par défaut).
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		GLuint pbo = 0;
+		glGenBuffers(1, &pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+		auto mapped = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, totalSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		bool isUploaded = false;
+		if (mapped != nullptr) {
+			for (int y = 0; y < size.y; y++)
+				packTexelRow(getSrcRow(y), size.x, layout, mapped + (size_t)y * rowSize);
+			// glUnmapBuffer retourne faux si le contenu a été perdu entretemps (rare, par exemple un changement de mode d'affichage).
+			GLboolean isIntact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			if (isIntact == GL_TRUE) {
+				// Avec un PBO lié, le dernier paramètre est une position dans le tampon plutôt qu'un pointeur.
+				glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, size.x, size.y, format, GL_UNSIGNED_BYTE, nullptr);
+				isUploaded = true;
+			}
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &pbo);
+
+		// Sinon, envoyer une rangée à la fois.
+		if (not isUploaded) {
+			std::vector<uint8_t> row(rowSize);
+			for (int y = 0; y < size.y; y++) {
+				packTexelRow(getSrcRow(y), size.x, layout, row.data());
+				glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, size.x, 1, format, GL_UNSIGNED_BYTE, row.data());
+			}
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
 	// Si detailLevels est > 1, demande à OpenGL de générer les mipmaps.
 	static Texture loadFromImage(const sf::Image& img, int detailLevels = 1) {
 		// Beaucoup de bibliothèques importent les images avec x=0,y=0 (donc premier pixel du tableau) au coin haut-gauche de l'image. C'est la convention en graphisme, mais les textures en OpenGL ont leur origine au coin bas-gauche.
-		// SFML applique la convention origine = haut-gauche, il faut donc renverser l'image verticalement avant de la passer à OpenGL.
-		sf::Image texImg = img;
-		texImg.flipVertically();
+		// SFML applique la convention origine = haut-gauche, il faut donc renverser l'image verticalement en la passant à OpenGL. On le fait pendant l'envoi (voir uploadPixels) plutôt qu'en copiant et renversant l'image avant.
+		return createFromPixels(ivec2(img.getSize().x, img.getSize().y), img.getPixelsPtr(), detailLevels, true);
+	}
 
-		// Générer et lier un objet de texture. Ça ressemble un peu aux VBO.
+	// Créer une texture à partir de pixels RGBA 8 bits. Les pixels sont dans la convention d'OpenGL (première rangée en bas), ou dans la convention habituelle des images (première rangée en haut) si isTopDown est vrai. Si detailLevels est > 1, demande à OpenGL de générer les mipmaps.
+	// Par défaut, le format sur le GPU est le plus petit qui garde toute l'information de l'image (voir chooseTexelLayout) : un masque en niveaux de gris prend 1 ou 2 octets par texel au lieu de 4.
+	static Texture createFromPixels(ivec2 size, const void* pixels, int detailLevels = 1, bool isTopDown = false, TexelLayout layout = TexelLayout::Auto) {
+		// Générer un objet de texture et allouer son stockage. Ça ressemble un peu aux VBO.
 		Texture tex = {};
-		tex.size = {texImg.getSize().x, texImg.getSize().y};
+		tex.size = size;
 		tex.numLevels = detailLevels;
 		glGenTextures(1, &tex.id);
-		glBindTexture(GL_TEXTURE_2D, tex.id);
-		// Passer les données de l'image (un peu comme avec glBufferData). Il faut spécifier le format interne qui sera enregistré sur le GPU ainsi que celui dont est fait le tableau de données passé en paramètre.
-		tex.setPixelData(GL_RGBA, texImg.getPixelsPtr());
-
-		// Le paramètre contrôle la génération automatique de mipmaps.
-		if (detailLevels > 1) {
-			// Spécifier le mode de filtrage pour la minimisation (zoom out). Si on utilise du mipmap, il faut utiliser le mode spécifique aux mipmaps (GL_NEAREST_MIPMAP_* ou GL_LINEAR_MIPMAP_*)
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-			// Spécifier le mode de filtrage pour le grossissement (zoom in). Beaucoup de ressources en ligne font l'erreur d'utiliser GL_*_MIPMAP_* pour le grossissement. Les seules valeurs applicables sont GL_LINEAR et GL_NEAREST.
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			// Générer automatiquement les mipmaps. L'algorithme utilisé pour faire la mise à l'échelle n'est pas spécifiée dans le standard OpenGL. C'est un compromis entre la solution simple (pas de mipmap) et la solution compliqué (mipmap manuel).
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, detailLevels - 1);
+		if (layout == TexelLayout::Auto)
+			layout = chooseTexelLayout(size, pixels);
+		tex.allocateStorage(layout);
+		// Passer les données de l'image (un peu comme avec glBufferSubData). Le format interne enregistré sur le GPU est choisi à l'allocation, on spécifie ici celui dont est fait le tableau de données passé en paramètre.
+		uploadPixels(0, size, pixels, layout, isTopDown);
+
+		// Générer automatiquement les mipmaps. L'algorithme utilisé pour faire la mise à l'échelle n'est pas spécifiée dans le standard OpenGL. C'est un compromis entre la solution simple (pas de mipmap) et la solution compliqué (mipmap manuel).
+		if (tex.numLevels > 1)
 			glGenerateMipmap(GL_TEXTURE_2D);
-		} else {
-			// Spéficier les modes de filtrage. GL_NEAREST pour la minimisation et GL_LINEAR pour le grossissement fonctionnent bien dans une majorité des cas.
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		}
 
+		// Les modes de filtrage par défaut : GL_NEAREST (ou GL_NEAREST_MIPMAP_NEAREST avec des mipmaps) pour la minimisation et GL_LINEAR pour le grossissement fonctionnent bien dans une majorité des cas. Voir TextureSampling.
+		tex.setSampling({});
 		return tex;
 	}
 
@@ -105,62 +202,182 @@ struct Texture
 		return loadFromImage(texImg, detailLevels);
 	}
 
+	// Créer une texture à partir d'une chaîne de mipmaps construite sur le CPU (voir Mipmaps.hpp), un glTexSubImage2D par niveau comme avec loadFromMipmapFiles. Le format est choisi selon le niveau 0 comme avec createFromPixels : le filtrage traite chaque canal de la même façon, donc les niveaux réduits d'une image grise ou opaque le restent.
+	static Texture createFromMipChain(const MipChain& chain, TexelLayout layout = TexelLayout::Auto) {
+		Texture tex = {};
+		if (chain.levels.empty())
+			return tex;
+		tex.size = chain.sizes[0];
+		tex.numLevels = chain.getNumLevels();
+		glGenTextures(1, &tex.id);
+		if (layout == TexelLayout::Auto)
+			layout = chooseTexelLayout(chain.sizes[0], chain.levels[0].data());
+		tex.allocateStorage(layout);
+		for (int i = 0; i < tex.numLevels; i++)
+			uploadPixels(i, chain.sizes[i], chain.levels[i].data(), layout);
+
+		// Mêmes filtres que pour glGenerateMipmap (voir createFromPixels).
+		tex.setSampling({});
+		return tex;
+	}
+
+	// Comme loadFromFile, mais les mipmaps sont générés sur le CPU (filtrage dans l'espace linéaire, résultat identique sur toutes les plateformes) et gardés dans un cache sur le disque. Voir loadMipChainFromFileCached.
+	static Texture loadFromFileWithMipmaps(const std::string& filename, int detailLevels, MipmapFilter filter = MipmapFilter::Box) {
+		return createFromMipChain(loadMipChainFromFileCached(filename, detailLevels, filter));
+	}
+
+	// Créer une texture compressée par blocs (voir TextureCompression.hpp). Les blocs sont passés tels quels, le GPU les décode à l'échantillonnage.
+	static Texture createFromCompressedMipChain(const CompressedMipChain& chain) {
+		Texture tex = {};
+		if (chain.levels.empty())
+			return tex;
+		tex.size = chain.sizes[0];
+		tex.numLevels = chain.getNumLevels();
+		glGenTextures(1, &tex.id);
+		getTextureBindings().bindForEditing(GL_TEXTURE_2D, tex.id);
+		GLenum internalFormat = getBlockFormatInternalFormat(chain.format);
+		tex.internalFormat = internalFormat;
+		for (auto&& level : chain.levels)
+			tex.memorySize += level.size();
+		getTextureMemoryStats().add(internalFormat, tex.memorySize, getMipChainNumTexels(tex.size, tex.numLevels) * 4);
+		if (isTextureStorageSupported()) {
+			glTexStorage2D(GL_TEXTURE_2D, tex.numLevels, internalFormat, tex.size.x, tex.size.y);
+			for (int i = 0; i < tex.numLevels; i++)
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, chain.sizes[i].x, chain.sizes[i].y, internalFormat, (GLsizei)chain.levels[i].size(), chain.levels[i].data());
+		} else {
+			for (int i = 0; i < tex.numLevels; i++)
+				glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, chain.sizes[i].x, chain.sizes[i].y, 0, (GLsizei)chain.levels[i].size(), chain.levels[i].data());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex.numLevels - 1);
+		}
+
+		tex.setSampling({});
+		return tex;
+	}
+
+	// Comme loadFromFileWithMipmaps, mais la texture est compressée en BC1 (opaque) ou BC3 (avec alpha), ce qui prend 4 à 8 fois moins de mémoire. La compression est faite une fois et gardée dans un cache .bccache à côté de l'image. Si le GPU ne supporte pas S3TC, on revient à une texture non compressée.
+	static Texture loadFromFileCompressed(const std::string& filename, int detailLevels = 1, BlockFormat format = BlockFormat::Auto, MipmapFilter filter = MipmapFilter::Box) {
+		if (not isS3tcSupported())
+			return loadFromFileWithMipmaps(filename, detailLevels, filter);
+		return createFromCompressedMipChain(loadCompressedMipChainFromFileCached(filename, detailLevels, format, filter));
+	}
+
 	// filenamePattern doit contenir un "{}" qui sera remplacé par 0 à numLevels (avec un format de spécification optionnel comme en Python).
+	// Tous les niveaux sont chargés avant de retourner. Pour les textures trop grandes pour être entièrement sur le GPU, TextureStreamer charge les niveaux progressivement à partir des mêmes fichiers.
 	static Texture loadFromMipmapFiles(const std::string& filenamePattern, int numLevels) {
-		// Créer et lier l'objet de texture. Quand on fait des mipmap manuellement, il faut créer une seule texture à laquelle on passe une image différente pour chaque niveau de détail.
+		// Créer l'objet de texture. Quand on fait des mipmap manuellement, il faut créer une seule texture à laquelle on passe une image différente pour chaque niveau de détail.
 		Texture result = {};
 		glGenTextures(1, &result.id);
-		glBindTexture(GL_TEXTURE_2D, result.id);
 		// Pour chaque niveau de détails:
 		for (int i = 0; i < numLevels; i++) {
 			// Générer le nom de fichier (du beau C++20).
 			auto filename = std::vformat(filenamePattern, std::make_format_args(i));
-			// Charger l'image et la renverser verticalement (voir commentaire dans fonction précédente).
+			// Charger l'image.
 			sf::Image texImg;
 			if (not texImg.loadFromFile(filename))
 				throw std::runtime_error(std::format("{} could not be loaded", filename));
-			texImg.flipVertically();
-			// Passer l'image en spécifiant le niveau de détail (2e paramètre de glTexImage2D).
-			glTexImage2D(
-				GL_TEXTURE_2D,
-				i,
-				GL_RGBA,
-				texImg.getSize().x,
-				texImg.getSize().y,
-				0,
-				GL_RGBA,
-				GL_UNSIGNED_BYTE,
-				texImg.getPixelsPtr()
-			);
-			if (i == 0)
+			// Le stockage de tous les niveaux est alloué une fois la taille de base connue.
+			if (i == 0) {
 				result.size = {texImg.getSize().x, texImg.getSize().y};
+				result.numLevels = numLevels;
+				result.allocateStorage();
+			}
+			// Passer l'image en spécifiant le niveau de détail (2e paramètre de glTexSubImage2D). Elle est renversée verticalement pendant l'envoi (voir loadFromImage). Les niveaux sont des images indépendantes, on les garde donc en RGBA plutôt que de choisir le format d'après le niveau 0.
+			uploadPixels(i, ivec2(texImg.getSize().x, texImg.getSize().y), texImg.getPixelsPtr(), TexelLayout::Rgba, true);
 		}
 
+		// ATTENTION: Ce n'est pas super clair dans la documentation officielle, mais il faut limiter le nombre de niveaux quand on fait des mipmap manuellement, sinon OpenGL s'attend à recevoir tous les niveaux jusqu'à 1x1. C'est fait par allocateStorage : le stockage immuable n'a que numLevels niveaux (sinon GL_TEXTURE_MAX_LEVEL est mis à numLevels - 1).
 		// Spécifier le mode de filtrage. On utilise les mêmes que si on utilisait glGenerateMipmap.
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		// Spécifier (optionnellement) le niveau de détail correspondant à la définition de base. Par défaut c'est 0 et donc pas nécessaire de le modifier.
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-		// ATTENTION: Ce n'est pas super clair dans la documentation officielle, mais il faut configurer le GL_TEXTURE_MAX_LEVEL quand on fait des mipmap manuellement. Le défaut est 1000, il s'attend donc à recevoir 1000 tableaux de pixels.
-		// Dans notre cas on a 6 niveaux, donc 0 à 5, alors on passe 5.
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
-		result.numLevels = numLevels;
-
+		result.setSampling({});
 		return result;
 	}
 
-	// Créer une texture de 1 pixel d'une couleur donnée.
-	static Texture createFromColor(vec4 color) {
-		Texture tex = {};
-		tex.size = {1, 1};
-		tex.numLevels = 1;
-		glGenTextures(1, &tex.id);
-		glBindTexture(GL_TEXTURE_2D, tex.id);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, &color);
-		return tex;
+	// Une couleur constante. Plutôt qu'une texture de 1 pixel par couleur, la couleur est un texel de la palette partagée (voir ColorPalette) : la texture retournée est celle de la palette (à ne pas détruire avec deleteObject) et texCoordsTransform reçoit la transformation des coordonnées de texture qui donne la couleur (voir ColorPalette::getTexCoordsTransform).
+	static Texture createFromColor(vec4 color, vec4& texCoordsTransform);
+};
+
+
+// Une palette de couleurs constantes, toutes dans une seule petite texture (un texel par couleur) au lieu d'une texture de 1x1 par couleur.
+// Pour échantillonner une couleur de la palette, le nuanceur remplace ses coordonnées de texture par le centre du texel de la couleur. getTexCoordsTransform() donne la transformation (échelle dans xy, décalage dans zw) à appliquer aux coordonnées de texture dans le nuanceur de sommets :
+//     texCoords = a_texCoords * texCoordsTransform.xy + texCoordsTransform.zw;
+// Avec vec4(1, 1, 0, 0), on retrouve les coordonnées d'origine pour les textures normales.
+// La palette partagée est donnée par getColorPalette() (comme getTextureBindings(), les exemples n'ont qu'un contexte). Sa texture appartient à la palette : elle est détruite par deleteObject(), pas par les utilisateurs des couleurs.
+class ColorPalette
+{
+public:
+	// La palette a width x width couleurs.
+	ColorPalette(int width = 16)
+	: width_(width) { }
+
+	Texture& getTexture() { return texture_; }
+	size_t getNumColors() const { return colors_.size(); }
+
+	// L'indice de la couleur dans la palette. Les couleurs sont arrondies à 8 bits par composante, donc deux couleurs qui donnent les mêmes octets partagent le même texel. La couleur est ajoutée (et envoyée au GPU) si elle n'y est pas déjà.
+	int getColorIndex(vec4 color) {
+		u8vec4 texel = u8vec4(round(clamp(color, 0.0f, 1.0f) * 255.0f));
+		uint32_t key = texel.x | (texel.y << 8) | (texel.z << 16) | ((uint32_t)texel.w << 24);
+		if (auto it = indices_.find(key); it != indices_.end())
+			return it->second;
+
+		if ((int)colors_.size() == width_ * width_) {
+			std::cerr << std::format("ColorPalette: plus de place pour la couleur ({}, {}, {}, {})", color.x, color.y, color.z, color.w) << "\n";
+			return 0;
+		}
+		if (texture_.id == 0)
+			createTexture();
+		int index = (int)colors_.size();
+		colors_.push_back(texel);
+		indices_[key] = index;
+		getTextureBindings().bindForEditing(GL_TEXTURE_2D, texture_.id);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, index % width_, index / width_, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &texel);
+		return index;
+	}
+
+	// Les coordonnées de texture du centre du texel de la couleur.
+	vec2 getTexCoords(vec4 color) {
+		int index = getColorIndex(color);
+		return (vec2(index % width_, index / width_) + 0.5f) / (float)width_;
 	}
+
+	vec4 getTexCoordsTransform(vec4 color) {
+		vec2 texCoords = getTexCoords(color);
+		return vec4(0, 0, texCoords.x, texCoords.y);
+	}
+
+	void deleteObject() {
+		texture_.deleteObject();
+		colors_.clear();
+		indices_.clear();
+	}
+
+private:
+	void createTexture() {
+		texture_.size = {width_, width_};
+		texture_.numLevels = 1;
+		glGenTextures(1, &texture_.id);
+		texture_.allocateStorage();
+		// Pas de mipmap ni de filtrage linéaire, sinon les couleurs voisines se mélangent.
+		texture_.setSampling({GL_NEAREST, GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE});
+	}
+
+	int width_;
+	Texture texture_;
+	std::vector<u8vec4> colors_;
+	std::unordered_map<uint32_t, int> indices_;
 };
 
+
+inline ColorPalette& getColorPalette() {
+	static ColorPalette palette;
+	return palette;
+}
+
+inline Texture Texture::createFromColor(vec4 color, vec4& texCoordsTransform) {
+	auto& palette = getColorPalette();
+	texCoordsTransform = palette.getTexCoordsTransform(color);
+	return palette.getTexture();
+}
+
+
 // Une texture liée à une variable uniforme et une unité active.
 struct BoundTexture
 {
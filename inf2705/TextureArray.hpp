@@ -0,0 +1,304 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+#include <SFML/Graphics.hpp>
+
+#include "Mipmaps.hpp"
+#include "TextureBinding.hpp"
+#include "TextureFormat.hpp"
+#include "ShaderProgram.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Un tableau de textures (GL_TEXTURE_2D_ARRAY) : plusieurs images de même taille, appelées couches, dans un seul objet de texture. Le nuanceur les échantillonne avec un sampler2DArray et des coordonnées vec3(u, v, couche).
+// Plutôt que de lier une texture différente pour chaque trame d'animation ou chaque matériau, on lie le tableau une seule fois et on choisit la couche par une variable uniforme ou un attribut de sommet (par instance). Des milliers de lutins animés peuvent donc être tracés en un seul appel.
+struct TextureArray
+{
+	GLuint id = 0;
+	ivec2 size = {}; // La taille d'une couche.
+	int numLayers = 0;
+	int numLevels = 0;
+	GLuint sampler = 0; // L'objet d'échantillonnage partagé (voir Texture::setSampling).
+	size_t memorySize = 0; // La mémoire prise sur le GPU par toutes les couches et tous les niveaux (voir TextureMemoryStats).
+
+	void bindToTextureUnit(int textureUnit) {
+		getTextureBindings().bindTexture(textureUnit, GL_TEXTURE_2D_ARRAY, id);
+		getTextureBindings().bindSampler(textureUnit, sampler);
+	}
+
+	void bindToTextureUnit(int textureUnit, ShaderProgram& prog, std::string_view name) {
+		bindToTextureUnit(textureUnit);
+		prog.use();
+		prog.setInt(name, textureUnit);
+	}
+
+	void setSampling(const TextureSampling& sampling) {
+		TextureSampling concrete = sampling;
+		concrete.minFilter = sampling.getMinFilterFor(numLevels);
+		sampler = getSamplers().get(concrete);
+	}
+
+	void deleteObject() {
+		if (id != 0 and memorySize != 0)
+			getTextureMemoryStats().remove(GL_RGBA8, memorySize, memorySize);
+		memorySize = 0;
+		getTextureBindings().forgetTexture(id);
+		glDeleteTextures(1, &id);
+		id = 0;
+	}
+
+	// Créer un tableau à partir des pixels RGBA 8 bits (déjà dans la convention d'OpenGL) des couches mises bout à bout. Si detailLevels est > 1, les mipmaps de chaque couche sont générés sur le CPU (voir Mipmaps.hpp).
+	static TextureArray createFromLayers(ivec2 size, int numLayers, const void* pixels, int detailLevels = 1) {
+		if (numLayers <= 0 or size.x <= 0 or size.y <= 0)
+			return {};
+		TextureArray result;
+		result.size = size;
+		result.numLayers = numLayers;
+		size_t layerSize = (size_t)size.x * size.y * 4;
+
+		std::vector<MipChain> chains;
+		if (detailLevels > 1) {
+			for (int i = 0; i < numLayers; i++)
+				chains.push_back(buildMipChain(size, (const uint8_t*)pixels + i * layerSize, detailLevels));
+		}
+		result.numLevels = detailLevels > 1 ? chains[0].getNumLevels() : 1;
+
+		glGenTextures(1, &result.id);
+		getTextureBindings().bindForEditing(GL_TEXTURE_2D_ARRAY, result.id);
+		// Stockage immuable de tous les niveaux quand c'est supporté (voir Texture::allocateStorage).
+		bool isStorageImmutable = isTextureStorageSupported();
+		result.memorySize = getMipChainNumTexels(size, result.numLevels) * numLayers * 4;
+		getTextureMemoryStats().add(GL_RGBA8, result.memorySize, result.memorySize);
+		if (isStorageImmutable)
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, result.numLevels, GL_RGBA8, size.x, size.y, numLayers);
+		// Toutes les couches d'un niveau sont passées ensemble, comme une texture 3D dont la profondeur est le nombre de couches.
+		std::vector<uint8_t> levelPixels;
+		for (int level = 0; level < result.numLevels; level++) {
+			ivec2 levelSize = size;
+			const void* data = pixels;
+			if (level > 0) {
+				levelSize = chains[0].sizes[level];
+				levelPixels.clear();
+				for (auto&& chain : chains)
+					levelPixels.insert(levelPixels.end(), chain.levels[level].begin(), chain.levels[level].end());
+				data = levelPixels.data();
+			}
+			if (isStorageImmutable)
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, levelSize.x, levelSize.y, numLayers, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			else
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, levelSize.x, levelSize.y, numLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		}
+		if (not isStorageImmutable)
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, result.numLevels - 1);
+
+		result.setSampling({});
+		return result;
+	}
+
+	// Découper une feuille de lutins (spritesheet) en une couche par lutin. Les lutins sont des cellules de spriteSize pixels disposées de gauche à droite, puis de haut en bas. La feuille est lue et envoyée en une seule fois, sans une texture par lutin.
+	static TextureArray loadFromSpriteSheet(const std::string& filename, ivec2 spriteSize, int numSprites) {
+		sf::Image sheet;
+		if (not sheet.loadFromFile(filename)) {
+			std::cerr << std::format("{} could not be loaded", filename) << "\n";
+			return {};
+		}
+		ivec2 sheetSize = {(int)sheet.getSize().x, (int)sheet.getSize().y};
+		int numColumns = std::max(sheetSize.x / spriteSize.x, 1);
+		if ((numSprites + numColumns - 1) / numColumns * spriteSize.y > sheetSize.y) {
+			std::cerr << std::format("{} is too small for {} sprites", filename, numSprites) << "\n";
+			return {};
+		}
+
+		// Copier les rangées de chaque lutin dans sa couche en les renversant (origine en bas, voir Texture::loadFromImage).
+		size_t rowSize = (size_t)spriteSize.x * 4;
+		std::vector<uint8_t> layers(rowSize * spriteSize.y * numSprites);
+		const uint8_t* src = sheet.getPixelsPtr();
+		for (int i = 0; i < numSprites; i++) {
+			ivec2 origin = {i % numColumns * spriteSize.x, i / numColumns * spriteSize.y};
+			for (int y = 0; y < spriteSize.y; y++) {
+				const uint8_t* srcRow = src + ((size_t)(origin.y + y) * sheetSize.x + origin.x) * 4;
+				uint8_t* dstRow = layers.data() + ((size_t)i * spriteSize.y + (spriteSize.y - 1 - y)) * rowSize;
+				std::memcpy(dstRow, srcRow, rowSize);
+			}
+		}
+
+		TextureArray result = createFromLayers(spriteSize, numSprites, layers.data());
+		// Des lutins pixelisés : pas de filtrage et pas de répétition.
+		result.setSampling({GL_NEAREST, GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE});
+		return result;
+	}
+};
+
+
+// L'emplacement d'une image dans un atlas : sa couche et la transformation de ses coordonnées de texture (échelle dans scale, décalage dans offset). Dans le nuanceur :
+//     vec3 atlasCoords = vec3(texCoords * entry.scale + entry.offset, entry.layer);
+struct AtlasEntry
+{
+	vec2 offset;
+	vec2 scale;
+	int layer;
+	ivec2 size; // La taille de l'image en pixels.
+};
+
+// Un atlas : des images de tailles différentes placées dans les couches d'un tableau de textures, avec la table de leurs emplacements.
+struct TextureAtlas
+{
+	TextureArray texture;
+	std::vector<AtlasEntry> entries;
+
+	// Les transformations de coordonnées de texture en vec4 (scale dans xy, offset dans zw), à envoyer dans un tableau de variables uniformes. Les couches (entries[i].layer) vont dans un tableau séparé.
+	std::vector<vec4> getTexCoordsTransforms() const {
+		std::vector<vec4> result;
+		for (auto&& entry : entries)
+			result.push_back({entry.scale.x, entry.scale.y, entry.offset.x, entry.offset.y});
+		return result;
+	}
+
+	void deleteObject() {
+		texture.deleteObject();
+		entries.clear();
+	}
+};
+
+// Construit un atlas en plaçant les images par étagères : on remplit une rangée (étagère) de gauche à droite, puis on en commence une nouvelle au-dessus avec la hauteur de l'image la plus haute de la rangée. Les images sont d'abord triées par hauteur décroissante, ce qui laisse peu d'espace perdu pour un algorithme aussi simple. Quand une couche est pleine, on passe à la suivante.
+// Chaque image est entourée d'une bordure qui répète ses pixels du bord, pour que le filtrage linéaire n'aille pas chercher les pixels des images voisines. Les coordonnées de texture ne doivent pas sortir de [0, 1] : les textures répétées (GL_REPEAT) ne vont pas dans un atlas.
+// Avec des mipmaps, un texel du niveau n couvre 2^n pixels de côté du niveau 0. Pour qu'aucun niveau ne mélange deux images, la bordure fait au moins 2^(detailLevels - 1) pixels, et chaque image avec sa bordure occupe une case alignée sur cette taille et dont les côtés en sont des multiples. La place perdue double avec chaque niveau : on garde donc peu de niveaux (3 ou 4) pour un atlas.
+class TextureAtlasBuilder
+{
+public:
+	// Le nombre de niveaux de mipmaps de l'atlas est fixé ici, puisqu'il détermine la bordure et l'alignement des images. detailLevels est limité au nombre de niveaux d'une couche.
+	TextureAtlasBuilder(ivec2 layerSize = {1024, 1024}, int detailLevels = 1, int padding = 1)
+	: layerSize_(layerSize) {
+		numLevels_ = std::clamp(detailLevels, 1, getMaxMipLevels(layerSize));
+		alignment_ = 1 << (numLevels_ - 1);
+		padding_ = std::max(padding, numLevels_ > 1 ? alignment_ : 0);
+	}
+
+	int getNumLevels() const { return numLevels_; }
+	int getPadding() const { return padding_; }
+
+	// Ajouter une image (pixels RGBA 8 bits dans la convention d'OpenGL). Retourne l'indice de son entrée dans l'atlas, ou -1 si elle est plus grande qu'une couche.
+	int add(ivec2 size, const void* pixels) {
+		ivec2 cellSize = getCellSize(size);
+		if (cellSize.x > layerSize_.x or cellSize.y > layerSize_.y) {
+			std::cerr << std::format("TextureAtlasBuilder: image {}x{} is too large for the atlas", size.x, size.y) << "\n";
+			return -1;
+		}
+		images_.push_back({size, std::vector<uint8_t>((const uint8_t*)pixels, (const uint8_t*)pixels + (size_t)size.x * size.y * 4)});
+		return (int)images_.size() - 1;
+	}
+
+	// Ajouter une image à partir d'un fichier. Retourne -1 si elle ne peut pas être chargée.
+	int addFromFile(const std::string& filename) {
+		sf::Image img;
+		if (not img.loadFromFile(filename)) {
+			std::cerr << std::format("{} could not be loaded", filename) << "\n";
+			return -1;
+		}
+		img.flipVertically();
+		return add(ivec2(img.getSize().x, img.getSize().y), img.getPixelsPtr());
+	}
+
+	// Placer les images et créer le tableau de textures.
+	TextureAtlas build() {
+		TextureAtlas result;
+		result.entries.resize(images_.size());
+		std::vector<ivec2> positions = pack(result.entries);
+		int numLayers = 0;
+		for (auto&& entry : result.entries)
+			numLayers = std::max(numLayers, entry.layer + 1);
+
+		// Copier chaque image à sa place, et répéter ses pixels du bord dans le reste de sa case (la bordure et l'arrondi à l'alignement).
+		size_t layerSize = (size_t)layerSize_.x * layerSize_.y * 4;
+		std::vector<uint8_t> layers(layerSize * numLayers);
+		for (size_t i = 0; i < images_.size(); i++) {
+			auto& img = images_[i];
+			uint8_t* layer = layers.data() + result.entries[i].layer * layerSize;
+			ivec2 cellSize = getCellSize(img.size);
+			for (int y = -padding_; y < cellSize.y - padding_; y++) {
+				int srcY = std::clamp(y, 0, img.size.y - 1);
+				for (int x = -padding_; x < cellSize.x - padding_; x++) {
+					int srcX = std::clamp(x, 0, img.size.x - 1);
+					ivec2 dst = positions[i] + ivec2(x, y);
+					std::memcpy(layer + ((size_t)dst.y * layerSize_.x + dst.x) * 4, img.pixels.data() + ((size_t)srcY * img.size.x + srcX) * 4, 4);
+				}
+			}
+		}
+
+		if (numLayers == 0)
+			return result;
+		result.texture = TextureArray::createFromLayers(layerSize_, numLayers, layers.data(), numLevels_);
+		result.texture.setSampling({GL_NONE, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE});
+		return result;
+	}
+
+private:
+	struct Image
+	{
+		ivec2 size;
+		std::vector<uint8_t> pixels;
+	};
+
+	// La taille de la case d'une image : l'image et sa bordure, arrondies à un multiple de l'alignement.
+	ivec2 getCellSize(ivec2 size) const {
+		ivec2 paddedSize = size + 2 * padding_;
+		return (paddedSize + alignment_ - 1) / alignment_ * alignment_;
+	}
+
+	// Placer les images par étagères. Remplit les entrées et retourne la position (coin bas-gauche, sans la bordure) de chaque image. Les cases ont des côtés multiples de l'alignement et sont placées bout à bout à partir de 0, donc elles restent alignées.
+	std::vector<ivec2> pack(std::vector<AtlasEntry>& entries) const {
+		std::vector<size_t> order(images_.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return images_[a].size.y > images_[b].size.y; });
+
+		std::vector<ivec2> positions(images_.size());
+		int layer = 0;
+		ivec2 cursor = {0, 0};
+		int shelfHeight = 0;
+		for (size_t i : order) {
+			ivec2 cellSize = getCellSize(images_[i].size);
+			// Nouvelle étagère si la rangée est pleine, nouvelle couche si la couche est pleine.
+			if (cursor.x + cellSize.x > layerSize_.x) {
+				cursor = {0, cursor.y + shelfHeight};
+				shelfHeight = 0;
+			}
+			if (cursor.y + cellSize.y > layerSize_.y) {
+				layer++;
+				cursor = {0, 0};
+				shelfHeight = 0;
+			}
+			positions[i] = cursor + padding_;
+			shelfHeight = std::max(shelfHeight, cellSize.y);
+			cursor.x += cellSize.x;
+
+			auto& entry = entries[i];
+			entry.layer = layer;
+			entry.size = images_[i].size;
+			entry.scale = vec2(images_[i].size) / vec2(layerSize_);
+			entry.offset = vec2(positions[i]) / vec2(layerSize_);
+		}
+		return positions;
+	}
+
+	ivec2 layerSize_;
+	int numLevels_ = 1;
+	int alignment_ = 1; // 2^(numLevels_ - 1) : les cases commencent et finissent sur des multiples de cette taille.
+	int padding_ = 1;
+	std::vector<Image> images_;
+};
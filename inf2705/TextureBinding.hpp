@@ -0,0 +1,197 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <compare>
+#include <map>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+
+#include "StreamingBuffer.hpp"
+
+
+using namespace gl;
+
+
+// glTexStorage2D/3D (stockage immuable) demandent OpenGL 4.2 (ou l'extension ARB_texture_storage).
+inline bool isTextureStorageSupported() {
+	static const bool result = isOpenGLVersionOrExtensionSupported(4, 2, "GL_ARB_texture_storage");
+	return result;
+}
+
+
+// Le suivi des textures et des objets d'échantillonnage liés à chaque unité de texture, pour ne pas refaire les glActiveTexture, glBindTexture et glBindSampler qui ne changent rien. Le pilote ne le fait pas toujours lui-même, et chaque appel coûte du temps CPU à chaque tracé.
+// Le suivi n'est valide que si toutes les liaisons passent par ici : le code qui appelle glBindTexture ou glActiveTexture directement doit ensuite appeler invalidate(). Les textures 2D et les tableaux de textures sont suivis, les autres cibles sont liées sans vérification.
+class TextureBindingCache
+{
+public:
+	// Lier une texture à une unité. Retourne faux si elle y était déjà liée (aucun appel OpenGL).
+	bool bindTexture(int unit, GLenum target, GLuint id) {
+		GLuint* bound = getBoundSlot(unit, target);
+		if (bound != nullptr and *bound == id) {
+			numSkippedCalls_++;
+			return false;
+		}
+		setActiveUnit(unit);
+		glBindTexture(target, id);
+		numCalls_++;
+		if (bound != nullptr)
+			*bound = id;
+		return true;
+	}
+
+	// Lier un objet d'échantillonnage à une unité (0 pour revenir aux paramètres de la texture).
+	bool bindSampler(int unit, GLuint sampler) {
+		auto& state = getUnit(unit);
+		if (state.sampler == sampler) {
+			numSkippedCalls_++;
+			return false;
+		}
+		glBindSampler(unit, sampler);
+		numCalls_++;
+		state.sampler = sampler;
+		return true;
+	}
+
+	// Lier une texture à l'unité active, pour la créer ou changer ses paramètres.
+	void bindForEditing(GLenum target, GLuint id) {
+		bindTexture(activeUnit_ == unknown ? 0 : activeUnit_, target, id);
+	}
+
+	// Oublier une texture détruite : OpenGL la délie de toutes les unités, et son nom pourra être réutilisé par une nouvelle texture.
+	void forgetTexture(GLuint id) {
+		for (auto& state : units_) {
+			if (state.texture2D == id)
+				state.texture2D = 0;
+			if (state.texture2DArray == id)
+				state.texture2DArray = 0;
+		}
+	}
+
+	void forgetSampler(GLuint sampler) {
+		for (auto& state : units_) {
+			if (state.sampler == sampler)
+				state.sampler = 0;
+		}
+	}
+
+	// Oublier tout ce qui est connu de l'état d'OpenGL, à appeler après des liaisons faites directement.
+	void invalidate() {
+		units_.clear();
+		activeUnit_ = unknown;
+	}
+
+	// Le nombre d'appels OpenGL faits et évités depuis le dernier resetCounters().
+	size_t getNumCalls() const { return numCalls_; }
+	size_t getNumSkippedCalls() const { return numSkippedCalls_; }
+
+	void resetCounters() {
+		numCalls_ = 0;
+		numSkippedCalls_ = 0;
+	}
+
+private:
+	static constexpr GLuint unknown = ~0u;
+
+	struct UnitState
+	{
+		GLuint texture2D = unknown;
+		GLuint texture2DArray = unknown;
+		GLuint sampler = unknown;
+	};
+
+	UnitState& getUnit(int unit) {
+		if ((size_t)unit >= units_.size())
+			units_.resize(unit + 1);
+		return units_[unit];
+	}
+
+	GLuint* getBoundSlot(int unit, GLenum target) {
+		if (target == GL_TEXTURE_2D)
+			return &getUnit(unit).texture2D;
+		if (target == GL_TEXTURE_2D_ARRAY)
+			return &getUnit(unit).texture2DArray;
+		return nullptr;
+	}
+
+	void setActiveUnit(int unit) {
+		if ((GLuint)unit == activeUnit_) {
+			numSkippedCalls_++;
+			return;
+		}
+		glActiveTexture(GL_TEXTURE0 + unit);
+		numCalls_++;
+		activeUnit_ = unit;
+	}
+
+	std::vector<UnitState> units_;
+	GLuint activeUnit_ = unknown;
+	size_t numCalls_ = 0;
+	size_t numSkippedCalls_ = 0;
+};
+
+// Le suivi des liaisons du contexte OpenGL (les exemples n'en ont qu'un).
+inline TextureBindingCache& getTextureBindings() {
+	static TextureBindingCache bindings;
+	return bindings;
+}
+
+
+// Les paramètres d'échantillonnage d'une texture. Avec minFilter = GL_NONE, on garde le filtre par défaut selon le nombre de niveaux (voir getMinFilterFor).
+struct TextureSampling
+{
+	GLenum minFilter = GL_NONE;
+	GLenum magFilter = GL_LINEAR;
+	GLenum wrapS = GL_REPEAT;
+	GLenum wrapT = GL_REPEAT;
+
+	auto operator<=> (const TextureSampling&) const = default;
+
+	// Le filtre de minimisation pour une texture de numLevels niveaux (le même que Texture::createFromPixels si minFilter est GL_NONE).
+	GLenum getMinFilterFor(int numLevels) const {
+		if (minFilter != GL_NONE)
+			return minFilter;
+		return numLevels > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST;
+	}
+};
+
+// Les objets d'échantillonnage (sampler objects, OpenGL 3.3), un par combinaison de paramètres. Un objet d'échantillonnage lié à une unité remplace les paramètres de filtrage et de répétition de la texture liée à la même unité : les textures qui ont les mêmes paramètres partagent donc le même objet, au lieu que chacune garde sa copie des paramètres.
+class SamplerCache
+{
+public:
+	// L'objet pour des paramètres. minFilter doit être concret (pas GL_NONE, voir TextureSampling::getMinFilterFor).
+	GLuint get(const TextureSampling& sampling) {
+		if (auto it = samplers_.find(sampling); it != samplers_.end())
+			return it->second;
+		GLuint sampler = 0;
+		glGenSamplers(1, &sampler);
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, sampling.minFilter);
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, sampling.magFilter);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, sampling.wrapS);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, sampling.wrapT);
+		samplers_[sampling] = sampler;
+		return sampler;
+	}
+
+	size_t getNumSamplers() const { return samplers_.size(); }
+
+	void deleteObjects() {
+		for (auto&& [sampling, sampler] : samplers_) {
+			getTextureBindings().forgetSampler(sampler);
+			glDeleteSamplers(1, &sampler);
+		}
+		samplers_.clear();
+	}
+
+private:
+	std::map<TextureSampling, GLuint> samplers_;
+};
+
+// Les objets d'échantillonnage partagés du contexte OpenGL. deleteObjects() est à appeler dans onClose() par les applications qui s'en servent.
+inline SamplerCache& getSamplers() {
+	static SamplerCache samplers;
+	return samplers;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <compare>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "Texture.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Une texture partagée. Les copies pointent vers le même objet OpenGL, c'est le cache qui le détruit.
+using SharedTexture = std::shared_ptr<Texture>;
+
+
+// Un cache de textures chargées à partir de fichiers. Une même image demandée plusieurs fois (avec le même nombre de niveaux et les mêmes paramètres d'échantillonnage) n'est chargée et envoyée au GPU qu'une seule fois : les appels suivants retournent la même texture partagée.
+// Le cache garde une référence à chaque texture. releaseUnused() détruit celles qui ne sont plus utilisées ailleurs, et deleteObjects() les détruit toutes (à appeler dans onClose(), pendant que le contexte OpenGL existe encore).
+class TextureCache
+{
+public:
+	// La palette des couleurs constantes (voir ColorPalette). C'est la palette partagée, aussi utilisée par Texture::createFromColor.
+	ColorPalette& palette = getColorPalette();
+	// Compresser les textures chargées par la suite en BC1/BC3 (voir Texture::loadFromFileCompressed).
+	bool compressing = false;
+
+	// L'identité d'une texture dans le cache.
+	struct Key
+	{
+		std::string path;
+		int detailLevels;
+		TextureSampling sampling;
+		bool compressed;
+
+		auto operator<=> (const Key&) const = default;
+	};
+
+	// Normaliser le chemin pour que "rust.png" et "./rust.png" donnent la même entrée.
+	static Key makeKey(const std::string& filename, int detailLevels, const TextureSampling& sampling, bool compressed) {
+		return {std::filesystem::path(filename).lexically_normal().generic_string(), detailLevels, sampling, compressed};
+	}
+
+	// La texture déjà dans le cache, ou nullptr si elle n'y est pas (elle n'est alors pas chargée).
+	SharedTexture find(const Key& key) {
+		auto it = textures_.find(key);
+		if (it == textures_.end())
+			return nullptr;
+		numHits_++;
+		return it->second;
+	}
+
+	// Ajouter une texture chargée ailleurs (par exemple par AssetLoader). Le cache en devient propriétaire. Si la clé y est déjà, l'entrée existante est gardée et la nouvelle texture est détruite.
+	SharedTexture insert(const Key& key, const Texture& texture) {
+		if (auto it = textures_.find(key); it != textures_.end()) {
+			Texture duplicate = texture;
+			if (duplicate.id != it->second->id)
+				duplicate.deleteObject();
+			return it->second;
+		}
+		auto tex = std::make_shared<Texture>(texture);
+		tex->setSampling(key.sampling);
+		textures_[key] = tex;
+		return tex;
+	}
+
+	SharedTexture load(const std::string& filename, int detailLevels = 1, const TextureSampling& sampling = {}) {
+		Key key = makeKey(filename, detailLevels, sampling, compressing);
+		if (auto tex = find(key))
+			return tex;
+
+		// Les mipmaps sont générés sur le CPU pour avoir le même résultat sur toutes les plateformes (voir Mipmaps.hpp). Les échecs (déjà affichés) ne sont pas gardés, pour réessayer au prochain appel.
+		Texture loaded;
+		if (compressing)
+			loaded = Texture::loadFromFileCompressed(filename, detailLevels);
+		else if (detailLevels > 1)
+			loaded = Texture::loadFromFileWithMipmaps(filename, detailLevels);
+		else
+			loaded = Texture::loadFromFile(filename);
+		if (loaded.id == 0)
+			return std::make_shared<Texture>(loaded);
+		return insert(key, loaded);
+	}
+
+	// Coordonnées de texture d'une couleur constante dans la palette, à utiliser avec palette.getTexture().
+	vec4 getColorTexCoordsTransform(vec4 color) { return palette.getTexCoordsTransform(color); }
+
+	size_t getNumTextures() const { return textures_.size(); }
+	// Le nombre de chargements évités grâce au cache.
+	size_t getNumHits() const { return numHits_; }
+
+	// Détruire les textures qui ne sont référencées que par le cache. Retourne le nombre de textures détruites.
+	size_t releaseUnused() {
+		size_t numReleased = 0;
+		for (auto it = textures_.begin(); it != textures_.end(); ) {
+			if (it->second.use_count() == 1) {
+				it->second->deleteObject();
+				it = textures_.erase(it);
+				numReleased++;
+			} else {
+				++it;
+			}
+		}
+		return numReleased;
+	}
+
+	// Les poignées encore en circulation pointent ensuite vers une texture vide (id = 0).
+	void deleteObjects() {
+		for (auto&& [key, tex] : textures_)
+			tex->deleteObject();
+		textures_.clear();
+		palette.deleteObject();
+	}
+
+private:
+	std::map<Key, SharedTexture> textures_;
+	size_t numHits_ = 0;
+};
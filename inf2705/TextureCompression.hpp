@@ -0,0 +1,391 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "utils.hpp"
+#include "Mipmaps.hpp"
+#include "StreamingBuffer.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Compression de textures par blocs (S3TC, aussi appelé BC1 à BC3 dans Direct3D). L'image est découpée en blocs de 4x4 pixels et chaque bloc est encodé indépendamment en taille fixe :
+//  - BC1 (DXT1) : 8 octets par bloc, donc 4 bits par pixel au lieu de 32. Deux couleurs de référence en RGB 5:6:5 et, pour chaque pixel, un indice de 2 bits vers les 4 couleurs interpolées entre elles. Pas d'alpha.
+//  - BC3 (DXT5) : 16 octets par bloc (8 bits par pixel). Un bloc BC1 pour la couleur, précédé d'un bloc semblable pour l'alpha (deux alphas de référence et 8 niveaux interpolés, indices de 3 bits).
+// Le GPU décode les blocs à l'échantillonnage, donc la texture prend 4 à 8 fois moins de mémoire et de bande passante. La compression est avec perte, et beaucoup plus lente que la décompression : on la fait une fois sur le CPU (en parallèle par rangées de blocs) et on garde le résultat dans un cache sur le disque.
+// L'encodeur choisit les couleurs de référence selon l'axe principal des couleurs du bloc (analyse en composantes principales), puis les raffine une fois par moindres carrés selon les indices choisis. C'est un bon compromis qualité/vitesse, sans viser la qualité des encodeurs hors-ligne qui essaient beaucoup de combinaisons.
+
+
+enum class BlockFormat : uint32_t
+{
+	Auto, // BC1 si l'image est opaque, BC3 sinon.
+	BC1,
+	BC3,
+};
+
+// S3TC n'est pas dans le noyau d'OpenGL, mais l'extension est offerte par tous les GPU de bureau (incluant macOS).
+inline bool isS3tcSupported() {
+	static const bool result = isOpenGLVersionOrExtensionSupported(std::numeric_limits<int>::max(), 0, "GL_EXT_texture_compression_s3tc");
+	return result;
+}
+
+inline GLenum getBlockFormatInternalFormat(BlockFormat format) {
+	return format == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+inline size_t getBlockFormatBlockSize(BlockFormat format) {
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+inline size_t getCompressedLevelSize(ivec2 size, BlockFormat format) {
+	return (size_t)((size.x + 3) / 4) * ((size.y + 3) / 4) * getBlockFormatBlockSize(format);
+}
+
+// Une chaîne de mipmaps compressée. Chaque niveau contient ses blocs rangée par rangée.
+struct CompressedMipChain
+{
+	BlockFormat format = BlockFormat::BC1;
+	std::vector<ivec2> sizes;
+	std::vector<std::vector<uint8_t>> levels;
+
+	int getNumLevels() const { return (int)levels.size(); }
+
+	size_t getTotalSize() const {
+		size_t total = 0;
+		for (auto&& level : levels)
+			total += level.size();
+		return total;
+	}
+};
+
+// Nombre minimal de rangées de blocs par fil.
+inline constexpr size_t minBlockRowsPerThread = 4;
+
+namespace bc_detail {
+
+inline uint16_t packRgb565(vec3 c) {
+	ivec3 q = ivec3(round(clamp(c, vec3(0), vec3(255)) * vec3(31, 63, 31) / 255.0f));
+	return (uint16_t)((q.x << 11) | (q.y << 5) | q.z);
+}
+
+inline vec3 unpackRgb565(uint16_t c) {
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	return vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+// Choisir les indices (2 bits par pixel) vers la palette de 4 couleurs des références c0 et c1. Retourne l'erreur totale (somme des carrés).
+inline float computeColorIndices(const vec3 (&pixels)[16], uint16_t c0, uint16_t c1, uint32_t& indices) {
+	vec3 a = unpackRgb565(c0), b = unpackRgb565(c1);
+	vec3 palette[4] = {a, b, (2.0f * a + b) / 3.0f, (a + 2.0f * b) / 3.0f};
+	float error = 0;
+	indices = 0;
+	for (int i = 0; i < 16; i++) {
+		int best = 0;
+		float bestDist = std::numeric_limits<float>::max();
+		for (int k = 0; k < 4; k++) {
+			vec3 d = pixels[i] - palette[k];
+			float dist = dot(d, d);
+			if (dist < bestDist) {
+				bestDist = dist;
+				best = k;
+			}
+		}
+		indices |= (uint32_t)best << (2 * i);
+		error += bestDist;
+	}
+	return error;
+}
+
+// Refaire les deux références par moindres carrés : chaque pixel est approximé par w * a + (1 - w) * b, où w dépend de son indice.
+inline bool refineEndpoints(const vec3 (&pixels)[16], uint32_t indices, vec3& a, vec3& b) {
+	constexpr float weights[4] = {1, 0, 2 / 3.0f, 1 / 3.0f};
+	float aa = 0, bb = 0, ab = 0;
+	vec3 ax = vec3(0), bx = vec3(0);
+	for (int i = 0; i < 16; i++) {
+		float w = weights[(indices >> (2 * i)) & 3];
+		aa += w * w;
+		bb += (1 - w) * (1 - w);
+		ab += w * (1 - w);
+		ax += pixels[i] * w;
+		bx += pixels[i] * (1 - w);
+	}
+	float det = aa * bb - ab * ab;
+	if (std::abs(det) < 1e-6f)
+		return false;
+	a = (ax * bb - bx * ab) / det;
+	b = (bx * aa - ax * ab) / det;
+	return true;
+}
+
+// Encoder la couleur d'un bloc en 8 octets (BC1, aussi utilisé dans BC3).
+inline void encodeColorBlock(const u8vec4 (&block)[16], uint8_t* out) {
+	vec3 pixels[16];
+	vec3 mean = vec3(0);
+	for (int i = 0; i < 16; i++) {
+		pixels[i] = vec3(block[i].x, block[i].y, block[i].z);
+		mean += pixels[i];
+	}
+	mean /= 16.0f;
+
+	// Axe principal par itération de la puissance sur la matrice de covariance (symétrique, donc 6 termes).
+	float cov[6] = {};
+	for (auto&& p : pixels) {
+		vec3 d = p - mean;
+		cov[0] += d.x * d.x; cov[1] += d.x * d.y; cov[2] += d.x * d.z;
+		cov[3] += d.y * d.y; cov[4] += d.y * d.z; cov[5] += d.z * d.z;
+	}
+	vec3 axis = vec3(1, 1, 1);
+	for (int k = 0; k < 8; k++) {
+		vec3 next = {
+			cov[0] * axis.x + cov[1] * axis.y + cov[2] * axis.z,
+			cov[1] * axis.x + cov[3] * axis.y + cov[4] * axis.z,
+			cov[2] * axis.x + cov[4] * axis.y + cov[5] * axis.z,
+		};
+		float len = length(next);
+		if (len < 1e-6f)
+			break;
+		axis = next / len;
+	}
+
+	// Les références sont les extrémités des pixels projetés sur l'axe.
+	float tMin = std::numeric_limits<float>::max(), tMax = -std::numeric_limits<float>::max();
+	for (auto&& p : pixels) {
+		float t = dot(p - mean, axis);
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+	vec3 a = mean + axis * tMax;
+	vec3 b = mean + axis * tMin;
+
+	uint16_t c0 = packRgb565(a), c1 = packRgb565(b);
+	uint32_t indices = 0;
+	float error = computeColorIndices(pixels, c0, c1, indices);
+	if (refineEndpoints(pixels, indices, a, b)) {
+		uint16_t r0 = packRgb565(a), r1 = packRgb565(b);
+		uint32_t refinedIndices = 0;
+		if (computeColorIndices(pixels, r0, r1, refinedIndices) < error) {
+			c0 = r0;
+			c1 = r1;
+			indices = refinedIndices;
+		}
+	}
+
+	// En BC1, c0 <= c1 active le mode à 3 couleurs + transparent. On garde le mode à 4 couleurs en inversant les références (et les indices 0<->1, 2<->3, soit un XOR de 1).
+	if (c0 < c1) {
+		std::swap(c0, c1);
+		indices ^= 0x55555555;
+	} else if (c0 == c1) {
+		indices = 0;
+	}
+	out[0] = (uint8_t)(c0 & 0xff);
+	out[1] = (uint8_t)(c0 >> 8);
+	out[2] = (uint8_t)(c1 & 0xff);
+	out[3] = (uint8_t)(c1 >> 8);
+	std::memcpy(out + 4, &indices, 4); // Petit-boutiste, comme le format.
+}
+
+// Encoder l'alpha d'un bloc en 8 octets (partie alpha de BC3), en mode à 8 niveaux entre le maximum et le minimum.
+inline void encodeAlphaBlock(const u8vec4 (&block)[16], uint8_t* out) {
+	int a0 = 0, a1 = 255;
+	for (auto&& p : block) {
+		a0 = std::max(a0, (int)p.w);
+		a1 = std::min(a1, (int)p.w);
+	}
+	out[0] = (uint8_t)a0;
+	out[1] = (uint8_t)a1;
+	uint64_t indices = 0;
+	if (a0 > a1) {
+		int palette[8] = {a0, a1};
+		for (int k = 1; k < 7; k++)
+			palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			for (int k = 1; k < 8; k++) {
+				if (std::abs(block[i].w - palette[k]) < std::abs(block[i].w - palette[best]))
+					best = k;
+			}
+			indices |= (uint64_t)best << (3 * i);
+		}
+	}
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+}
+
+// Le format à utiliser pour une image : BC1 si tous les pixels du niveau 0 sont opaques, BC3 sinon.
+inline BlockFormat chooseBlockFormat(const MipChain& chain) {
+	const auto& pixels = chain.levels[0];
+	for (size_t i = 3; i < pixels.size(); i += 4) {
+		if (pixels[i] != 255)
+			return BlockFormat::BC3;
+	}
+	return BlockFormat::BC1;
+}
+
+// Compresser un niveau RGBA 8 bits. Les blocs qui dépassent l'image (dimensions non multiples de 4) répètent les pixels du bord.
+inline std::vector<uint8_t> compressLevel(ivec2 size, const uint8_t* pixels, BlockFormat format) {
+	ivec2 numBlocks = (size + 3) / 4;
+	size_t blockSize = getBlockFormatBlockSize(format);
+	std::vector<uint8_t> result(getCompressedLevelSize(size, format));
+	parallelFor(numBlocks.y, [&](size_t begin, size_t end) {
+		for (size_t by = begin; by < end; by++) {
+			for (int bx = 0; bx < numBlocks.x; bx++) {
+				u8vec4 block[16];
+				for (int i = 0; i < 16; i++) {
+					int x = std::min(bx * 4 + i % 4, size.x - 1);
+					int y = std::min((int)by * 4 + i / 4, size.y - 1);
+					std::memcpy(&block[i], pixels + ((size_t)y * size.x + x) * 4, 4);
+				}
+				uint8_t* out = result.data() + (by * numBlocks.x + bx) * blockSize;
+				if (format == BlockFormat::BC3) {
+					bc_detail::encodeAlphaBlock(block, out);
+					out += 8;
+				}
+				bc_detail::encodeColorBlock(block, out);
+			}
+		}
+	}, minBlockRowsPerThread);
+	return result;
+}
+
+inline CompressedMipChain compressMipChain(const MipChain& chain, BlockFormat format = BlockFormat::Auto) {
+	CompressedMipChain result;
+	if (chain.levels.empty())
+		return result;
+	result.format = format == BlockFormat::Auto ? chooseBlockFormat(chain) : format;
+	result.sizes = chain.sizes;
+	for (int i = 0; i < chain.getNumLevels(); i++)
+		result.levels.push_back(compressLevel(chain.sizes[i], chain.levels[i].data(), result.format));
+	return result;
+}
+
+
+// Entête d'un fichier de cache de texture compressée (un conteneur semblable à KTX, mais réduit à ce dont on a besoin). Le fichier contient l'entête, suivi des blocs de chaque niveau mis bout à bout (du niveau 0 au plus petit), déjà dans la convention d'OpenGL (première rangée en bas).
+struct CompressedTextureCacheHeader
+{
+	char magic[4]; // Toujours "I27C".
+	uint32_t version; // Incrémenté à chaque changement du format ou de l'encodeur.
+	uint64_t sourceHash; // Hash du fichier source. Si le fichier source change, le cache est invalide.
+	int32_t width;
+	int32_t height;
+	uint32_t numLevels;
+	uint32_t requestedFormat; // Le BlockFormat demandé (peut être Auto).
+	uint32_t format; // Le BlockFormat des blocs (jamais Auto).
+	uint32_t filter; // Le MipmapFilter utilisé pour les mipmaps.
+};
+
+inline constexpr char compressedTextureCacheMagic[4] = {'I', '2', '7', 'C'};
+inline constexpr uint32_t compressedTextureCacheVersion = 1;
+
+// Lire un cache de texture compressée. Retourne faux si le cache est absent, corrompu, d'une autre version ou généré à partir d'une source ou de paramètres différents.
+inline bool loadCompressedMipChainFromCache(std::string_view cacheFilename, uint64_t sourceHash, int numLevels, BlockFormat format, MipmapFilter filter, CompressedMipChain& result) {
+	MappedFile cache(cacheFilename);
+	if (not cache.isOpen() or cache.size() < sizeof(CompressedTextureCacheHeader))
+		return false;
+
+	CompressedTextureCacheHeader header = {};
+	std::memcpy(&header, cache.data(), sizeof(header));
+	bool isValid = std::memcmp(header.magic, compressedTextureCacheMagic, sizeof(header.magic)) == 0 and
+	               header.version == compressedTextureCacheVersion and
+	               header.sourceHash == sourceHash and
+	               header.width > 0 and header.height > 0 and
+	               header.requestedFormat == (uint32_t)format and
+	               (header.format == (uint32_t)BlockFormat::BC1 or header.format == (uint32_t)BlockFormat::BC3) and
+	               header.filter == (uint32_t)filter;
+	if (not isValid)
+		return false;
+	ivec2 size = {header.width, header.height};
+	int maxLevels = getMaxMipLevels(size);
+	if ((int)header.numLevels != (numLevels <= 0 ? maxLevels : std::min(numLevels, maxLevels)))
+		return false;
+
+	// Valider la taille totale avant de copier.
+	BlockFormat blockFormat = (BlockFormat)header.format;
+	size_t dataSize = 0;
+	for (uint32_t i = 0; i < header.numLevels; i++, size = getNextMipSize(size))
+		dataSize += getCompressedLevelSize(size, blockFormat);
+	if (cache.size() - sizeof(CompressedTextureCacheHeader) != dataSize)
+		return false;
+
+	result = {};
+	result.format = blockFormat;
+	size = {header.width, header.height};
+	size_t offset = sizeof(CompressedTextureCacheHeader);
+	for (uint32_t i = 0; i < header.numLevels; i++, size = getNextMipSize(size)) {
+		size_t levelSize = getCompressedLevelSize(size, blockFormat);
+		result.sizes.push_back(size);
+		result.levels.emplace_back((const uint8_t*)cache.data() + offset, (const uint8_t*)cache.data() + offset + levelSize);
+		offset += levelSize;
+	}
+	return true;
+}
+
+// Écrire un cache de texture compressée.
+inline bool saveCompressedMipChainToCache(std::string_view cacheFilename, uint64_t sourceHash, BlockFormat requestedFormat, MipmapFilter filter, const CompressedMipChain& chain) {
+	CompressedTextureCacheHeader header = {};
+	std::memcpy(header.magic, compressedTextureCacheMagic, sizeof(header.magic));
+	header.version = compressedTextureCacheVersion;
+	header.sourceHash = sourceHash;
+	header.width = chain.sizes[0].x;
+	header.height = chain.sizes[0].y;
+	header.numLevels = (uint32_t)chain.getNumLevels();
+	header.requestedFormat = (uint32_t)requestedFormat;
+	header.format = (uint32_t)chain.format;
+	header.filter = (uint32_t)filter;
+	return writeFileAtomically(std::string(cacheFilename), [&](std::ofstream& file) {
+		file.write((const char*)&header, sizeof(header));
+		for (auto&& level : chain.levels)
+			file.write((const char*)level.data(), level.size());
+	});
+}
+
+// Le nom du fichier de cache, avec les paramètres de construction (voir getMipCacheFilename).
+inline std::string getCompressedTextureCacheFilename(std::string_view filename, int numLevels, BlockFormat format, MipmapFilter filter) {
+	int32_t params[] = {std::max(numLevels, 0), (int32_t)format, (int32_t)filter};
+	uint64_t paramsHash = hashBytes(params, sizeof(params));
+	return std::format("{}.{:08x}.bccache", filename, (uint32_t)(paramsHash ^ (paramsHash >> 32)));
+}
+
+// Charger une image, construire ses mipmaps (voir Mipmaps.hpp) et les compresser, en passant par un cache enregistré à côté du fichier source (voir getCompressedTextureCacheFilename). Aux chargements suivants, les blocs sont lus directement du cache. Le cache est validé par le hash du fichier source.
+// Retourne une chaîne vide si l'image ne peut pas être chargée (l'erreur est affichée).
+inline CompressedMipChain loadCompressedMipChainFromFileCached(const std::string& filename, int numLevels = 0, BlockFormat format = BlockFormat::Auto, MipmapFilter filter = MipmapFilter::Box) {
+	std::string cacheFilename = getCompressedTextureCacheFilename(filename, numLevels, format, filter);
+
+	MappedFile source(filename);
+	if (not source.isOpen()) {
+		std::cerr << std::format("{} could not be loaded", filename) << "\n";
+		return {};
+	}
+	uint64_t sourceHash = hashBytes(source.data(), source.size());
+
+	CompressedMipChain result;
+	if (loadCompressedMipChainFromCache(cacheFilename, sourceHash, numLevels, format, filter, result))
+		return result;
+
+	// Cache absent ou périmé. On n'écrit pas de .mipcache en passant : seule la version compressée sera relue.
+	MipChain chain = buildMipChainFromEncodedImage(source.data(), source.size(), filename, numLevels, filter);
+	source.close();
+	if (chain.levels.empty())
+		return {};
+	result = compressMipChain(chain, format);
+	if (not saveCompressedMipChainToCache(cacheFilename, sourceHash, format, filter, result))
+		std::cerr << std::format("WARNING TextureCompression: could not write cache file {}", cacheFilename) << "\n";
+	return result;
+}
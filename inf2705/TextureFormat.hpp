@@ -0,0 +1,196 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <iostream>
+#include <map>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "Mipmaps.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// La disposition des canaux d'une texture sur le GPU. Les images sont lues en RGBA 8 bits, mais beaucoup n'utilisent pas tous les canaux (masques en niveaux de gris, images opaques). On n'envoie alors que les canaux utiles, et un masque de permutation (swizzle) de la texture fait que le nuanceur lit toujours .rgba comme avant.
+enum class TexelLayout
+{
+	Auto,      // Choisir selon le contenu de l'image (voir chooseTexelLayout).
+	Gray,      // GL_R8, lu comme (r, r, r, 1).
+	GrayAlpha, // GL_RG8, lu comme (r, r, r, g).
+	Rgb,       // GL_RGB8, lu comme (r, g, b, 1).
+	Rgba,      // GL_RGBA8.
+};
+
+inline int getTexelLayoutNumChannels(TexelLayout layout) {
+	switch (layout) {
+	case TexelLayout::Gray: return 1;
+	case TexelLayout::GrayAlpha: return 2;
+	case TexelLayout::Rgb: return 3;
+	default: return 4;
+	}
+}
+
+inline GLenum getTexelLayoutInternalFormat(TexelLayout layout) {
+	switch (layout) {
+	case TexelLayout::Gray: return GL_R8;
+	case TexelLayout::GrayAlpha: return GL_RG8;
+	case TexelLayout::Rgb: return GL_RGB8;
+	default: return GL_RGBA8;
+	}
+}
+
+// Le format des pixels passés à glTexSubImage2D pour la disposition.
+inline GLenum getTexelLayoutPixelFormat(TexelLayout layout) {
+	switch (layout) {
+	case TexelLayout::Gray: return GL_RED;
+	case TexelLayout::GrayAlpha: return GL_RG;
+	case TexelLayout::Rgb: return GL_RGB;
+	default: return GL_RGBA;
+	}
+}
+
+// Le masque de permutation (GL_TEXTURE_SWIZZLE_RGBA) qui donne au nuanceur les mêmes valeurs .rgba que l'image d'origine.
+inline std::array<GLint, 4> getTexelLayoutSwizzle(TexelLayout layout) {
+	switch (layout) {
+	case TexelLayout::Gray: return {(GLint)GL_RED, (GLint)GL_RED, (GLint)GL_RED, (GLint)GL_ONE};
+	case TexelLayout::GrayAlpha: return {(GLint)GL_RED, (GLint)GL_RED, (GLint)GL_RED, (GLint)GL_GREEN};
+	default: return {(GLint)GL_RED, (GLint)GL_GREEN, (GLint)GL_BLUE, (GLint)GL_ALPHA};
+	}
+}
+
+// Le nombre d'octets par texel d'un format interne non compressé.
+inline size_t getInternalFormatTexelSize(GLenum internalFormat) {
+	switch (internalFormat) {
+	case GL_R8: return 1;
+	case GL_RG8: return 2;
+	case GL_RGB8: return 3;
+	default: return 4;
+	}
+}
+
+// Le nombre de texels de numLevels niveaux de mipmaps à partir de size.
+inline size_t getMipChainNumTexels(ivec2 size, int numLevels) {
+	size_t result = 0;
+	for (int i = 0; i < numLevels; i++) {
+		result += (size_t)size.x * size.y;
+		size = getNextMipSize(size);
+	}
+	return result;
+}
+
+// La plus petite disposition qui représente les pixels RGBA 8 bits sans perte : gris si r = g = b partout, sans alpha si a = 255 partout. Un seul passage sur l'image, arrêté dès qu'un pixel en couleur et un pixel transparent ont été vus.
+inline TexelLayout chooseTexelLayout(ivec2 size, const void* pixels) {
+	auto p = (const uint8_t*)pixels;
+	size_t numPixels = (size_t)size.x * size.y;
+	bool isGray = true;
+	bool isOpaque = true;
+	for (size_t i = 0; i < numPixels and (isGray or isOpaque); i++, p += 4) {
+		isGray = isGray and p[0] == p[1] and p[0] == p[2];
+		isOpaque = isOpaque and p[3] == 255;
+	}
+	if (isGray)
+		return isOpaque ? TexelLayout::Gray : TexelLayout::GrayAlpha;
+	return isOpaque ? TexelLayout::Rgb : TexelLayout::Rgba;
+}
+
+// Copier une rangée de pixels RGBA 8 bits en ne gardant que les canaux de la disposition.
+inline void packTexelRow(const uint8_t* src, int width, TexelLayout layout, uint8_t* dst) {
+	switch (layout) {
+	case TexelLayout::Gray:
+		for (int x = 0; x < width; x++)
+			dst[x] = src[x * 4];
+		break;
+	case TexelLayout::GrayAlpha:
+		for (int x = 0; x < width; x++) {
+			dst[x * 2 + 0] = src[x * 4 + 0];
+			dst[x * 2 + 1] = src[x * 4 + 3];
+		}
+		break;
+	case TexelLayout::Rgb:
+		for (int x = 0; x < width; x++) {
+			dst[x * 3 + 0] = src[x * 4 + 0];
+			dst[x * 3 + 1] = src[x * 4 + 1];
+			dst[x * 3 + 2] = src[x * 4 + 2];
+		}
+		break;
+	default:
+		std::copy_n(src, (size_t)width * 4, dst);
+		break;
+	}
+}
+
+
+// La mémoire prise par les textures sur le GPU, par format interne. Les tailles sont nominales (largeur x hauteur x octets par texel, pour tous les niveaux) : un pilote peut aligner davantage, en particulier GL_RGB8 est souvent gardé sur 4 octets par texel.
+// numRgba8Bytes est ce que les mêmes textures prendraient toutes en GL_RGBA8 non compressé, pour voir l'économie faite par le choix des formats et la compression.
+class TextureMemoryStats
+{
+public:
+	struct FormatUsage
+	{
+		size_t numTextures = 0;
+		size_t numBytes = 0;
+	};
+
+	void add(GLenum internalFormat, size_t numBytes, size_t numRgba8Bytes) {
+		auto& usage = formats_[internalFormat];
+		usage.numTextures++;
+		usage.numBytes += numBytes;
+		numBytes_ += numBytes;
+		numRgba8Bytes_ += numRgba8Bytes;
+	}
+
+	void remove(GLenum internalFormat, size_t numBytes, size_t numRgba8Bytes) {
+		auto it = formats_.find(internalFormat);
+		if (it == formats_.end())
+			return;
+		it->second.numTextures--;
+		it->second.numBytes -= numBytes;
+		if (it->second.numTextures == 0)
+			formats_.erase(it);
+		numBytes_ -= numBytes;
+		numRgba8Bytes_ -= numRgba8Bytes;
+	}
+
+	size_t getNumBytes() const { return numBytes_; }
+	size_t getNumRgba8Bytes() const { return numRgba8Bytes_; }
+	const std::map<GLenum, FormatUsage>& getFormats() const { return formats_; }
+
+	void print(std::ostream& out = std::cout) const {
+		for (auto&& [format, usage] : formats_)
+			out << std::format("{:>6} : {} texture(s), {:.2f} Mo", getInternalFormatName(format), usage.numTextures, usage.numBytes / (1024.0 * 1024.0)) << "\n";
+		double ratio = numBytes_ != 0 ? (double)numRgba8Bytes_ / numBytes_ : 1.0;
+		out << std::format("Total : {:.2f} Mo ({:.2f} Mo en RGBA8, {:.1f}x moins)", numBytes_ / (1024.0 * 1024.0), numRgba8Bytes_ / (1024.0 * 1024.0), ratio) << "\n";
+	}
+
+	static const char* getInternalFormatName(GLenum internalFormat) {
+		switch (internalFormat) {
+		case GL_R8: return "R8";
+		case GL_RG8: return "RG8";
+		case GL_RGB8: return "RGB8";
+		case GL_RGBA8: return "RGBA8";
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+		default: return "autre";
+		}
+	}
+
+private:
+	std::map<GLenum, FormatUsage> formats_;
+	size_t numBytes_ = 0;
+	size_t numRgba8Bytes_ = 0;
+};
+
+// Les statistiques du contexte OpenGL, tenues à jour par Texture et TextureArray.
+inline TextureMemoryStats& getTextureMemoryStats() {
+	static TextureMemoryStats stats;
+	return stats;
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+#include <SFML/Graphics.hpp>
+
+#include "AssetLoader.hpp"
+#include "Texture.hpp"
+#include "TextureBinding.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Une texture dont les niveaux de détails sont chargés progressivement par TextureStreamer, du plus grossier au plus fin. Elle est utilisable dès que son niveau le plus grossier est envoyé : les niveaux plus fins s'ajoutent ensuite en descendant GL_TEXTURE_BASE_LEVEL, et sont retirés (en remontant GL_TEXTURE_BASE_LEVEL) quand la mémoire manque et que la texture n'a pas servi récemment.
+// Le stockage n'est pas immuable (voir Texture::allocateStorage) : il faut pouvoir libérer les niveaux fins un à un, ce que glTexStorage2D ne permet pas.
+class StreamingTexture
+{
+public:
+	Texture texture; // La texture OpenGL, avec tous les niveaux (résidents ou non). texture.size est la taille du niveau 0, connue une fois qu'il a été décodé.
+
+	// Lier la texture et la marquer comme utilisée pour la prochaine mise à jour du TextureStreamer. Les textures qui ne sont pas liées ne sont pas raffinées et sont les premières à perdre leurs niveaux fins.
+	void bindToTextureUnit(int textureUnit) {
+		isUsed_ = true;
+		texture.bindToTextureUnit(textureUnit);
+	}
+
+	void bindToTextureUnit(int textureUnit, ShaderProgram& prog, std::string_view name) {
+		isUsed_ = true;
+		texture.bindToTextureUnit(textureUnit, prog, name);
+	}
+
+	// Le niveau le plus fin sur le GPU (numLevels si aucun, donc texture pas encore utilisable).
+	int getResidentBaseLevel() const { return residentBase_; }
+	bool isUsable() const { return residentBase_ < numLevels_; }
+	bool isFullyResident() const { return residentBase_ == 0; }
+	bool hasFailed() const { return hasFailed_; }
+	// La mémoire prise sur le GPU par les niveaux résidents.
+	size_t getResidentBytes() const { return residentBytes_; }
+
+private:
+	friend class TextureStreamer;
+
+	std::string filenamePattern_;
+	int numLevels_ = 0;
+	std::vector<ivec2> sizes_; // La taille de chaque niveau, {0, 0} tant qu'il n'a pas été décodé une première fois.
+	int residentBase_ = 0;
+	int pendingLevel_ = -1; // Le niveau en décodage ou en attente d'envoi, -1 si aucun.
+	size_t pendingBytes_ = 0; // La mémoire réservée pour le niveau en attente.
+	size_t residentBytes_ = 0;
+	uint64_t lastUsedFrame_ = 0;
+	bool isUsed_ = false;
+	bool hasFailed_ = false;
+};
+
+using SharedStreamingTexture = std::shared_ptr<StreamingTexture>;
+
+
+// Le chargement progressif de textures trop grandes pour être toutes entièrement sur le GPU.
+// Chaque niveau est décodé sur un fil de travail de l'AssetLoader, puis envoyé par update() sous un budget d'octets par trame : le niveau le plus grossier de chaque texture en premier, puis les niveaux plus fins des textures liées à la dernière trame, les textures les moins raffinées d'abord. Quand un niveau ne rentre pas dans le budget de mémoire, les niveaux fins des textures qui n'ont pas été liées depuis le plus longtemps sont retirés. Le niveau le plus grossier de chaque texture reste toujours résident.
+// À chaque trame, sur le fil principal :
+//     loader.processUploads(2);
+//     streamer.update(4 << 20);
+class TextureStreamer
+{
+public:
+	TextureStreamer(AssetLoader& loader, size_t memoryBudget, int maxPendingLevels = 4)
+	: loader_(loader), memoryBudget_(memoryBudget), maxPendingLevels_(maxPendingLevels) { }
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator= (const TextureStreamer&) = delete;
+
+	// Comme Texture::loadFromMipmapFiles : filenamePattern contient un "{}" remplacé par 0 à numLevels - 1, le niveau 0 étant le plus fin. Seul le niveau le plus grossier est demandé tout de suite.
+	SharedStreamingTexture load(const std::string& filenamePattern, int numLevels) {
+		auto tex = std::make_shared<StreamingTexture>();
+		tex->filenamePattern_ = filenamePattern;
+		tex->numLevels_ = std::max(numLevels, 1);
+		tex->sizes_.resize(tex->numLevels_);
+		tex->residentBase_ = tex->numLevels_;
+		tex->texture.numLevels = tex->numLevels_;
+		glGenTextures(1, &tex->texture.id);
+		getTextureBindings().bindForEditing(GL_TEXTURE_2D, tex->texture.id);
+		// Tant qu'aucun niveau n'est envoyé, la texture est incomplète (échantillonnée en noir).
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, tex->numLevels_ - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex->numLevels_ - 1);
+		tex->texture.setSampling({});
+		textures_.push_back(tex);
+		requestLevel(tex, tex->numLevels_ - 1, 0);
+		return tex;
+	}
+
+	// Mettre à jour les textures, une fois par trame après loader.processUploads() : envoyer les niveaux décodés (au moins un, puis jusqu'à uploadBudgetBytes octets), puis demander les niveaux suivants.
+	void update(size_t uploadBudgetBytes) {
+		frame_++;
+		for (auto& tex : textures_) {
+			if (tex->isUsed_)
+				tex->lastUsedFrame_ = frame_;
+			tex->isUsed_ = false;
+		}
+
+		uploadReadyLevels(uploadBudgetBytes);
+		// Si le budget a été réduit, libérer ce qui dépasse.
+		evictUntilFits(0);
+		requestFinerLevels();
+	}
+
+	void setMemoryBudget(size_t memoryBudget) { memoryBudget_ = memoryBudget; }
+	size_t getMemoryBudget() const { return memoryBudget_; }
+	// La mémoire prise par les niveaux résidents, et celle réservée pour les niveaux en cours de chargement.
+	size_t getResidentBytes() const { return residentBytes_; }
+	size_t getPendingBytes() const { return pendingBytes_; }
+	// Le nombre d'octets envoyés à la dernière mise à jour, et le nombre total de niveaux retirés.
+	size_t getNumUploadedBytes() const { return numUploadedBytes_; }
+	size_t getNumEvictions() const { return numEvictions_; }
+
+	// Les poignées encore en circulation pointent ensuite vers une texture vide (id = 0).
+	void deleteObjects() {
+		for (auto& tex : textures_) {
+			tex->texture.deleteObject();
+			tex->residentBase_ = tex->numLevels_;
+			tex->residentBytes_ = 0;
+			// Les niveaux encore en décodage seront abandonnés à leur arrivée (id = 0).
+			tex->pendingBytes_ = 0;
+		}
+		textures_.clear();
+		ready_.clear();
+		residentBytes_ = 0;
+		pendingBytes_ = 0;
+	}
+
+private:
+	// Un niveau décodé en attente d'envoi (pixels déjà dans la convention d'OpenGL).
+	struct DecodedLevel
+	{
+		SharedStreamingTexture texture;
+		int level;
+		ivec2 size;
+		std::vector<uint8_t> pixels;
+	};
+
+	static size_t getLevelBytes(ivec2 size) { return (size_t)size.x * size.y * 4; }
+
+	// L'estimation de la mémoire d'un niveau pas encore décodé, à partir du niveau plus grossier (le double de chaque côté).
+	static size_t estimateLevelBytes(const StreamingTexture& tex, int level) {
+		if (tex.sizes_[level] != ivec2(0))
+			return getLevelBytes(tex.sizes_[level]);
+		if (level + 1 < tex.numLevels_ and tex.sizes_[level + 1] != ivec2(0))
+			return getLevelBytes(tex.sizes_[level + 1] * 2);
+		return 0;
+	}
+
+	void requestLevel(const SharedStreamingTexture& tex, int level, size_t reservedBytes) {
+		tex->pendingLevel_ = level;
+		tex->pendingBytes_ = reservedBytes;
+		pendingBytes_ += reservedBytes;
+		numPendingLevels_++;
+		std::string filename = std::vformat(tex->filenamePattern_, std::make_format_args(level));
+		loader_.enqueue([this, tex, level, filename]() -> AssetLoader::UploadFunc {
+			// Décoder et renverser l'image sur le fil de travail (voir Texture::loadFromImage).
+			sf::Image img;
+			if (not img.loadFromFile(filename)) {
+				std::cerr << std::format("{} could not be loaded", filename) << "\n";
+				return [this, tex, level]() { onLevelDecoded({tex, level, {}, {}}); };
+			}
+			auto decoded = std::make_shared<DecodedLevel>(DecodedLevel{tex, level, {img.getSize().x, img.getSize().y}, {}});
+			size_t rowSize = (size_t)decoded->size.x * 4;
+			decoded->pixels.resize(rowSize * decoded->size.y);
+			for (int y = 0; y < decoded->size.y; y++)
+				std::memcpy(decoded->pixels.data() + (size_t)(decoded->size.y - 1 - y) * rowSize, img.getPixelsPtr() + (size_t)y * rowSize, rowSize);
+			return [this, decoded]() { onLevelDecoded(std::move(*decoded)); };
+		});
+	}
+
+	// Appelée sur le fil principal par loader.processUploads(). L'envoi lui-même attend update() pour respecter le budget.
+	void onLevelDecoded(DecodedLevel decoded) {
+		auto& tex = *decoded.texture;
+		numPendingLevels_--;
+		if (decoded.pixels.empty()) {
+			tex.hasFailed_ = true;
+			releasePending(tex);
+			return;
+		}
+		ready_.push_back(std::move(decoded));
+	}
+
+	void releasePending(StreamingTexture& tex) {
+		pendingBytes_ -= tex.pendingBytes_;
+		tex.pendingBytes_ = 0;
+		tex.pendingLevel_ = -1;
+	}
+
+	void uploadReadyLevels(size_t uploadBudgetBytes) {
+		// Les plus petits niveaux d'abord : les textures pas encore utilisables passent avant le raffinement des autres.
+		std::sort(ready_.begin(), ready_.end(), [](const DecodedLevel& a, const DecodedLevel& b) {
+			return getLevelBytes(a.size) < getLevelBytes(b.size);
+		});
+		numUploadedBytes_ = 0;
+		size_t numUploaded = 0;
+		for (; numUploaded < ready_.size(); numUploaded++) {
+			auto& decoded = ready_[numUploaded];
+			size_t numBytes = getLevelBytes(decoded.size);
+			if (numUploaded > 0 and numUploadedBytes_ + numBytes > uploadBudgetBytes)
+				break;
+			if (uploadLevel(decoded))
+				numUploadedBytes_ += numBytes;
+		}
+		ready_.erase(ready_.begin(), ready_.begin() + numUploaded);
+	}
+
+	// Envoyer un niveau décodé s'il est toujours le prochain niveau de sa texture. Retourne faux s'il est abandonné.
+	bool uploadLevel(DecodedLevel& decoded) {
+		auto& tex = *decoded.texture;
+		releasePending(tex);
+		// La texture a été détruite, ou le niveau plus grossier a été retiré pendant le décodage.
+		if (tex.texture.id == 0 or decoded.level != tex.residentBase_ - 1)
+			return false;
+		// Chaque niveau doit faire la moitié (arrondie vers le bas) du précédent, sinon la texture serait incomplète.
+		if (decoded.level + 1 < tex.numLevels_ and getNextMipSize(decoded.size) != tex.sizes_[decoded.level + 1]) {
+			std::cerr << std::format("{} n'a pas la taille attendue pour le niveau {}", std::vformat(tex.filenamePattern_, std::make_format_args(decoded.level)), decoded.level) << "\n";
+			tex.hasFailed_ = true;
+			return false;
+		}
+		size_t numBytes = getLevelBytes(decoded.size);
+		// La réservation était une estimation, s'assurer que le niveau rentre vraiment.
+		if (not evictUntilFits(numBytes, &tex) and decoded.level < tex.numLevels_ - 1)
+			return false;
+
+		tex.sizes_[decoded.level] = decoded.size;
+		getTextureBindings().bindForEditing(GL_TEXTURE_2D, tex.texture.id);
+		glTexImage2D(GL_TEXTURE_2D, decoded.level, GL_RGBA8, decoded.size.x, decoded.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, decoded.pixels.data());
+		// Le niveau est complet, l'échantillonnage peut maintenant descendre jusqu'à lui.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, decoded.level);
+		tex.residentBase_ = decoded.level;
+		tex.residentBytes_ += numBytes;
+		residentBytes_ += numBytes;
+		if (decoded.level == 0)
+			tex.texture.size = decoded.size;
+		return true;
+	}
+
+	// Demander le prochain niveau des textures liées à la dernière trame, les moins raffinées d'abord.
+	void requestFinerLevels() {
+		std::vector<SharedStreamingTexture> candidates;
+		for (auto& tex : textures_) {
+			if (tex->lastUsedFrame_ == frame_ and tex->isUsable() and not tex->isFullyResident() and tex->pendingLevel_ == -1 and not tex->hasFailed_)
+				candidates.push_back(tex);
+		}
+		std::sort(candidates.begin(), candidates.end(), [](auto& a, auto& b) { return a->residentBase_ > b->residentBase_; });
+		for (auto& tex : candidates) {
+			if (numPendingLevels_ + ready_.size() >= (size_t)maxPendingLevels_)
+				break;
+			int level = tex->residentBase_ - 1;
+			size_t numBytes = estimateLevelBytes(*tex, level);
+			if (not evictUntilFits(numBytes, tex.get()))
+				break;
+			requestLevel(tex, level, numBytes);
+		}
+	}
+
+	// Retirer des niveaux fins jusqu'à ce que numBytes de plus rentrent dans le budget. Seules les textures qui n'ont pas été liées à la dernière trame sont touchées, celles utilisées il y a le plus longtemps d'abord. Retourne faux si ça ne suffit pas.
+	bool evictUntilFits(size_t numBytes, const StreamingTexture* requester = nullptr) {
+		while (residentBytes_ + pendingBytes_ + numBytes > memoryBudget_) {
+			StreamingTexture* victim = nullptr;
+			for (auto& tex : textures_) {
+				bool isEvictable = tex.get() != requester and tex->lastUsedFrame_ < frame_ and tex->residentBase_ < tex->numLevels_ - 1;
+				if (isEvictable and (victim == nullptr or tex->lastUsedFrame_ < victim->lastUsedFrame_))
+					victim = tex.get();
+			}
+			if (victim == nullptr)
+				return false;
+			evictFinestLevel(*victim);
+		}
+		return true;
+	}
+
+	void evictFinestLevel(StreamingTexture& tex) {
+		int level = tex.residentBase_;
+		getTextureBindings().bindForEditing(GL_TEXTURE_2D, tex.texture.id);
+		// Remonter le niveau de base avant de libérer le niveau, pour que la texture reste complète.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		size_t numBytes = getLevelBytes(tex.sizes_[level]);
+		tex.residentBase_ = level + 1;
+		tex.residentBytes_ -= numBytes;
+		residentBytes_ -= numBytes;
+		numEvictions_++;
+	}
+
+	AssetLoader& loader_;
+	size_t memoryBudget_;
+	int maxPendingLevels_;
+	std::vector<SharedStreamingTexture> textures_;
+	std::vector<DecodedLevel> ready_;
+	uint64_t frame_ = 0;
+	size_t numPendingLevels_ = 0; // Les niveaux en décodage (pas encore dans ready_).
+	size_t residentBytes_ = 0;
+	size_t pendingBytes_ = 0;
+	size_t numUploadedBytes_ = 0;
+	size_t numEvictions_ = 0;
+};
@@ -0,0 +1,381 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <format>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glbinding/gl/gl.h>
+#include <glm/glm.hpp>
+
+#include "utils.hpp"
+#include "StreamingBuffer.hpp"
+
+
+using namespace gl;
+using namespace glm;
+
+
+// Description des attributs d'un type de sommet évaluée à la compilation. On déclare une seule fois les membres d'une struct avec leur localisation en spécialisant VertexAttribList :
+//     template <>
+//     struct VertexAttribList<Particle>
+//     {
+//         static constexpr std::array attribs = {
+//             VERTEX_ATTRIB(0, Particle, position),
+//             VERTEX_ATTRIB(1, Particle, velocity),
+//             ...
+//         };
+//     };
+// VertexFormat<Particle, disposition> en tire ensuite la configuration des attributs de sommets, la liste des variables de rétroaction (transform feedback) et la disposition std430 pour les SSBO.
+
+
+// OpenGL 4.3 pour séparer le format des attributs du tampon source (glVertexAttribFormat et glBindVertexBuffer).
+inline bool isVertexAttribBindingSupported() {
+	static const bool result = isOpenGLVersionOrExtensionSupported(4, 3, "GL_ARB_vertex_attrib_binding");
+	return result;
+}
+
+
+// La disposition des sommets dans le tampon, choisie à la compilation.
+enum class VertexLayout
+{
+	Interleaved,       // Un sommet complet après l'autre, exactement comme le tableau de structs (un seul flux).
+	StructureOfArrays, // Chaque attribut dans son propre bloc contigu du tampon (un flux par attribut).
+	SplitStreams,      // Le premier attribut (normalement la position) seul dans un premier flux, puis les autres attributs entrelacés dans un deuxième. Une passe de profondeur ou d'ombre ne lit alors que les positions.
+};
+
+// Comment le nuanceur reçoit un attribut.
+enum class VertexAttribKind
+{
+	Float,      // Converti en float tel quel (glVertexAttribPointer).
+	Normalized, // Entier normalisé à [0,1] (non signé) ou [-1,1] (signé).
+	Integer,    // Gardé entier (glVertexAttribIPointer), pour les `in int`/`in uint` du nuanceur.
+};
+
+struct VertexAttribDesc
+{
+	const char* name; // Le nom du membre, qui doit aussi être le nom de la variable de sortie pour la rétroaction.
+	GLuint location;
+	GLint numComponents;
+	GLenum type;
+	size_t offset; // Position du membre dans la struct C++.
+	size_t size; // Taille du membre en octets.
+	VertexAttribKind kind;
+};
+
+template <typename T>
+inline constexpr VertexAttribDesc makeVertexAttribDesc(const char* name, GLuint location, size_t offset, VertexAttribKind kind) {
+	// Un membre est soit un scalaire, soit un vecteur de glm (qui a length() et value_type).
+	if constexpr (requires { T::length(); }) {
+		static_assert(getTypeGLenum_v<typename T::value_type> != GL_INVALID_ENUM, "Type de composante d'attribut non supporté");
+		return {name, location, (GLint)T::length(), getTypeGLenum_v<typename T::value_type>, offset, sizeof(T), kind};
+	} else {
+		static_assert(getTypeGLenum_v<T> != GL_INVALID_ENUM, "Type d'attribut non supporté");
+		return {name, location, 1, getTypeGLenum_v<T>, offset, sizeof(T), kind};
+	}
+}
+
+// Décrire l'attribut de sommets `member` (scalaire ou vecteur) d'une struct `elemType` à la localisation `index`.
+#define VERTEX_ATTRIB(index, elemType, member) \
+	makeVertexAttribDesc<decltype(elemType::member)>(#member, (GLuint)(index), offsetof(elemType, member), VertexAttribKind::Float)
+
+// Comme VERTEX_ATTRIB, mais les entiers sont normalisés ([0,1] pour les non signés, [-1,1] pour les signés).
+#define NORMALIZED_VERTEX_ATTRIB(index, elemType, member) \
+	makeVertexAttribDesc<decltype(elemType::member)>(#member, (GLuint)(index), offsetof(elemType, member), VertexAttribKind::Normalized)
+
+// Comme VERTEX_ATTRIB, mais les entiers restent entiers dans le nuanceur.
+#define INTEGER_VERTEX_ATTRIB(index, elemType, member) \
+	makeVertexAttribDesc<decltype(elemType::member)>(#member, (GLuint)(index), offsetof(elemType, member), VertexAttribKind::Integer)
+
+// À spécialiser pour chaque type de sommet (voir plus haut).
+template <typename T>
+struct VertexAttribList;
+
+
+template <typename T, VertexLayout Layout = VertexLayout::Interleaved>
+struct VertexFormat
+{
+	static constexpr auto& attribs = VertexAttribList<T>::attribs;
+	static constexpr size_t numAttribs = attribs.size();
+	static constexpr VertexLayout layout = Layout;
+
+	// Vérifier la déclaration à la compilation : localisations uniques, membres dans la struct sans chevauchement, attributs entiers de type entier.
+	static constexpr bool isDeclarationValid() {
+		for (size_t i = 0; i < numAttribs; i++) {
+			if (attribs[i].offset + attribs[i].size > sizeof(T))
+				return false;
+			if (attribs[i].kind == VertexAttribKind::Integer and (attribs[i].type == GL_FLOAT or attribs[i].type == GL_DOUBLE or attribs[i].type == GL_HALF_FLOAT))
+				return false;
+			for (size_t j = i + 1; j < numAttribs; j++) {
+				if (attribs[i].location == attribs[j].location)
+					return false;
+				if (attribs[i].offset < attribs[j].offset + attribs[j].size and attribs[j].offset < attribs[i].offset + attribs[i].size)
+					return false;
+			}
+		}
+		return numAttribs > 0;
+	}
+	static_assert(isDeclarationValid(), "Déclaration d'attributs de sommets invalide");
+
+	// La taille d'un sommet sans le bourrage de la struct.
+	static constexpr size_t packedSize = [] {
+		size_t size = 0;
+		for (auto& attrib : attribs)
+			size += attrib.size;
+		return size;
+	}();
+
+	// Nombre de flux, c'est-à-dire de plages du tampon qui ont chacune leur propre pas.
+	static constexpr size_t numStreams =
+		Layout == VertexLayout::Interleaved ? 1 :
+		Layout == VertexLayout::StructureOfArrays ? numAttribs :
+		(numAttribs > 1 ? 2 : 1);
+
+	static constexpr size_t getStream(size_t attrib) {
+		if constexpr (Layout == VertexLayout::Interleaved)
+			return 0;
+		else if constexpr (Layout == VertexLayout::StructureOfArrays)
+			return attrib;
+		else
+			return attrib == 0 ? 0 : 1;
+	}
+
+	// Le pas (stride) en octets entre deux sommets d'un flux.
+	static constexpr size_t getStreamStride(size_t stream) {
+		if constexpr (Layout == VertexLayout::Interleaved)
+			return sizeof(T);
+		else if constexpr (Layout == VertexLayout::StructureOfArrays)
+			return attribs[stream].size;
+		else
+			return stream == 0 ? attribs[0].size : packedSize - attribs[0].size;
+	}
+
+	// La position d'un attribut dans un sommet de son flux.
+	static constexpr size_t getOffsetInStream(size_t attrib) {
+		if constexpr (Layout == VertexLayout::Interleaved)
+			return attribs[attrib].offset;
+		size_t offset = 0;
+		for (size_t i = 0; i < attrib; i++) {
+			if (getStream(i) == getStream(attrib))
+				offset += attribs[i].size;
+		}
+		return offset;
+	}
+
+	// La position du début d'un flux dans le tampon. Sauf pour la disposition entrelacée, elle dépend du nombre de sommets : il faut refaire setupAttribs() quand il change.
+	static constexpr size_t getStreamOffset(size_t stream, size_t numVertices) {
+		size_t offset = 0;
+		for (size_t s = 0; s < stream; s++)
+			offset += getStreamStride(s) * numVertices;
+		return offset;
+	}
+
+	static constexpr size_t getBufferSize(size_t numVertices) {
+		return getStreamOffset(numStreams, numVertices);
+	}
+
+	// Copier des sommets (tableau de structs) vers un tampon dans la disposition du format. dst doit avoir au moins getBufferSize(numVertices) octets.
+	static void pack(const T* vertices, size_t numVertices, void* dst) {
+		auto out = (std::byte*)dst;
+		if constexpr (Layout == VertexLayout::Interleaved) {
+			std::memcpy(out, vertices, numVertices * sizeof(T));
+		} else {
+			for (size_t a = 0; a < numAttribs; a++) {
+				size_t stream = getStream(a);
+				size_t stride = getStreamStride(stream);
+				std::byte* attribOut = out + getStreamOffset(stream, numVertices) + getOffsetInStream(a);
+				for (size_t v = 0; v < numVertices; v++)
+					std::memcpy(attribOut + v * stride, (const std::byte*)&vertices[v] + attribs[a].offset, attribs[a].size);
+			}
+		}
+	}
+
+	// L'inverse de pack(), par exemple pour relire les résultats d'une rétroaction.
+	static void unpack(const void* src, size_t numVertices, T* vertices) {
+		auto in = (const std::byte*)src;
+		if constexpr (Layout == VertexLayout::Interleaved) {
+			std::memcpy(vertices, in, numVertices * sizeof(T));
+		} else {
+			for (size_t a = 0; a < numAttribs; a++) {
+				size_t stream = getStream(a);
+				size_t stride = getStreamStride(stream);
+				const std::byte* attribIn = in + getStreamOffset(stream, numVertices) + getOffsetInStream(a);
+				for (size_t v = 0; v < numVertices; v++)
+					std::memcpy((std::byte*)&vertices[v] + attribs[a].offset, attribIn + v * stride, attribs[a].size);
+			}
+		}
+	}
+
+	// Configurer et activer tous les attributs sur le VAO et le GL_ARRAY_BUFFER liés. baseOffset est la position des données dans le tampon.
+	static void setupAttribs(size_t numVertices = 0, size_t baseOffset = 0) {
+		for (size_t a = 0; a < numAttribs; a++) {
+			auto& attrib = attribs[a];
+			size_t stream = getStream(a);
+			auto stride = (GLsizei)getStreamStride(stream);
+			auto pointer = (const void*)(baseOffset + getStreamOffset(stream, numVertices) + getOffsetInStream(a));
+			if (attrib.kind == VertexAttribKind::Integer)
+				glVertexAttribIPointer(attrib.location, attrib.numComponents, attrib.type, stride, pointer);
+			else
+				glVertexAttribPointer(attrib.location, attrib.numComponents, attrib.type, attrib.kind == VertexAttribKind::Normalized ? GL_TRUE : GL_FALSE, stride, pointer);
+			glEnableVertexAttribArray(attrib.location);
+		}
+	}
+
+	// Configurer seulement le format des attributs du VAO lié (type, composantes, position dans le sommet) et les associer aux points de liaison firstBinding à firstBinding + numStreams - 1. À faire une seule fois par VAO : changer ensuite de tampon source, par exemple pour alterner deux tampons de rétroaction, se fait avec bindVertexBuffer() sans refaire la validation des attributs. Sans le support d'OpenGL 4.3, ne fait rien et bindVertexBuffer() fait la configuration complète.
+	static void setupAttribFormats(GLuint firstBinding = 0) {
+		if (not isVertexAttribBindingSupported())
+			return;
+		for (size_t a = 0; a < numAttribs; a++) {
+			auto& attrib = attribs[a];
+			auto relativeOffset = (GLuint)getOffsetInStream(a);
+			if (attrib.kind == VertexAttribKind::Integer)
+				glVertexAttribIFormat(attrib.location, attrib.numComponents, attrib.type, relativeOffset);
+			else
+				glVertexAttribFormat(attrib.location, attrib.numComponents, attrib.type, attrib.kind == VertexAttribKind::Normalized ? GL_TRUE : GL_FALSE, relativeOffset);
+			glVertexAttribBinding(attrib.location, firstBinding + (GLuint)getStream(a));
+			glEnableVertexAttribArray(attrib.location);
+		}
+	}
+
+	// Lier le tampon source des sommets au VAO lié (un glBindVertexBuffer par flux). Sans le support d'OpenGL 4.3, on lie le tampon à GL_ARRAY_BUFFER et on reconfigure les attributs avec setupAttribs().
+	static void bindVertexBuffer(GLuint buffer, size_t numVertices = 0, size_t baseOffset = 0, GLuint firstBinding = 0) {
+		if (isVertexAttribBindingSupported()) {
+			for (size_t s = 0; s < numStreams; s++)
+				glBindVertexBuffer(firstBinding + (GLuint)s, buffer, (GLintptr)(baseOffset + getStreamOffset(s, numVertices)), (GLsizei)getStreamStride(s));
+		} else {
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			setupAttribs(numVertices, baseOffset);
+		}
+	}
+
+	// Les noms des variables de sortie à passer à glTransformFeedbackVaryings, dans l'ordre des membres. La rétroaction n'écrit que des types de 32 bits. Le bourrage de la struct est sauté avec gl_SkipComponents, et gl_NextBuffer sépare les flux (un point de liaison GL_TRANSFORM_FEEDBACK_BUFFER par flux).
+	static std::vector<const char*> getVaryingNames() {
+		static constexpr const char* skipNames[] = {"", "gl_SkipComponents1", "gl_SkipComponents2", "gl_SkipComponents3", "gl_SkipComponents4"};
+		std::vector<const char*> names;
+		size_t position = 0;
+		for (size_t a = 0; a < numAttribs; a++) {
+			if (a > 0 and getStream(a) != getStream(a - 1))
+				names.push_back("gl_NextBuffer");
+			if constexpr (Layout == VertexLayout::Interleaved) {
+				for (size_t gap = (attribs[a].offset - position) / 4; gap > 0; gap -= std::min<size_t>(gap, 4))
+					names.push_back(skipNames[std::min<size_t>(gap, 4)]);
+				position = attribs[a].offset + attribs[a].size;
+			}
+			names.push_back(attribs[a].name);
+		}
+		if constexpr (Layout == VertexLayout::Interleaved) {
+			for (size_t gap = (sizeof(T) - position) / 4; gap > 0; gap -= std::min<size_t>(gap, 4))
+				names.push_back(skipNames[std::min<size_t>(gap, 4)]);
+		}
+		return names;
+	}
+
+	// Configurer les variables de rétroaction d'un programme. Comme glTransformFeedbackVaryings, doit être appelée AVANT l'édition des liens.
+	static void setTransformFeedbackVaryings(GLuint program) {
+		auto names = getVaryingNames();
+		glTransformFeedbackVaryings(program, (GLsizei)names.size(), names.data(), GL_INTERLEAVED_ATTRIBS);
+	}
+
+	// Lier les flux d'un tampon de numVertices sommets aux points de liaison de la rétroaction (un par flux, à partir de 0).
+	static void bindTransformFeedbackBuffer(GLuint buffer, size_t numVertices, size_t baseOffset = 0) {
+		for (size_t s = 0; s < numStreams; s++)
+			glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, (GLuint)s, buffer, (GLintptr)(baseOffset + getStreamOffset(s, numVertices)), (GLsizeiptr)(getStreamStride(s) * numVertices));
+	}
+
+	// Disposition std430 (SSBO). Seuls les types de 32 bits non normalisés y sont représentables. Un vec3 y est aligné sur 16 octets, donc la struct C++ a rarement la même disposition (voir isStd430Compatible et packStd430).
+	static constexpr bool isStd430Representable = [] {
+		for (auto& attrib : attribs) {
+			bool is32Bits = attrib.type == GL_FLOAT or attrib.type == GL_INT or attrib.type == GL_UNSIGNED_INT;
+			if (not is32Bits or attrib.kind == VertexAttribKind::Normalized)
+				return false;
+		}
+		return true;
+	}();
+
+	static constexpr size_t getStd430Alignment(size_t attrib) {
+		return attribs[attrib].numComponents == 1 ? 4 : attribs[attrib].numComponents == 2 ? 8 : 16;
+	}
+
+	static constexpr std::array<size_t, numAttribs> std430Offsets = [] {
+		std::array<size_t, numAttribs> offsets = {};
+		size_t offset = 0;
+		for (size_t a = 0; a < numAttribs; a++) {
+			size_t alignment = getStd430Alignment(a);
+			offset = (offset + alignment - 1) / alignment * alignment;
+			offsets[a] = offset;
+			offset += attribs[a].size;
+		}
+		return offsets;
+	}();
+
+	// La taille d'un élément dans un tableau std430 : arrondie à l'alignement du plus gros membre.
+	static constexpr size_t std430Stride = [] {
+		size_t alignment = 4;
+		for (size_t a = 0; a < numAttribs; a++)
+			alignment = std::max(alignment, getStd430Alignment(a));
+		size_t end = std430Offsets[numAttribs - 1] + attribs[numAttribs - 1].size;
+		return (end + alignment - 1) / alignment * alignment;
+	}();
+
+	// Vrai si on peut envoyer le tableau de structs directement dans un SSBO.
+	static constexpr bool isStd430Compatible = [] {
+		if (not isStd430Representable or std430Stride != sizeof(T))
+			return false;
+		for (size_t a = 0; a < numAttribs; a++) {
+			if (std430Offsets[a] != attribs[a].offset)
+				return false;
+		}
+		return true;
+	}();
+
+	// La déclaration GLSL de la struct, à insérer dans le nuanceur qui lit le SSBO.
+	static std::string getStd430Declaration(std::string_view structName) {
+		static_assert(isStd430Representable, "Le type de sommet n'est pas représentable en std430");
+		std::string result = std::format("struct {}\n{{\n", structName);
+		for (auto& attrib : attribs) {
+			std::string_view scalarName = attrib.type == GL_FLOAT ? "float" : attrib.type == GL_INT ? "int" : "uint";
+			std::string_view vectorPrefix = attrib.type == GL_FLOAT ? "" : attrib.type == GL_INT ? "i" : "u";
+			if (attrib.numComponents == 1)
+				result += std::format("\t{} {};\n", scalarName, attrib.name);
+			else
+				result += std::format("\t{}vec{} {};\n", vectorPrefix, attrib.numComponents, attrib.name);
+		}
+		return result + "};\n";
+	}
+
+	// Copier des sommets dans un tampon en disposition std430. dst doit avoir au moins numVertices * std430Stride octets.
+	static void packStd430(const T* vertices, size_t numVertices, void* dst) {
+		static_assert(isStd430Representable, "Le type de sommet n'est pas représentable en std430");
+		auto out = (std::byte*)dst;
+		if constexpr (isStd430Compatible) {
+			std::memcpy(out, vertices, numVertices * sizeof(T));
+		} else {
+			std::memset(out, 0, numVertices * std430Stride);
+			for (size_t v = 0; v < numVertices; v++) {
+				for (size_t a = 0; a < numAttribs; a++)
+					std::memcpy(out + v * std430Stride + std430Offsets[a], (const std::byte*)&vertices[v] + attribs[a].offset, attribs[a].size);
+			}
+		}
+	}
+};
+
+
+// Les mêmes opérations avec une disposition choisie à l'exécution (par exemple une par mesh). Chaque disposition reste instanciée à la compilation.
+template <typename T, typename Func>
+inline decltype(auto) visitVertexLayout(VertexLayout layout, Func&& func) {
+	switch (layout) {
+	case VertexLayout::StructureOfArrays:
+		return func(VertexFormat<T, VertexLayout::StructureOfArrays>());
+	case VertexLayout::SplitStreams:
+		return func(VertexFormat<T, VertexLayout::SplitStreams>());
+	default:
+		return func(VertexFormat<T, VertexLayout::Interleaved>());
+	}
+}
@@ -0,0 +1,338 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "utils.hpp"
+
+
+using namespace glm;
+
+
+// Un objet (ligne o ou g) d'un fichier Wavefront, donné comme une plage de coins de triangles.
+struct WavefrontObject
+{
+	std::string name;
+	size_t firstCorner = 0;
+	size_t numCorners = 0;
+};
+
+// Le contenu géométrique d'un fichier Wavefront. Les faces sont déjà séparées en triangles et chaque coin de triangle référence ses attributs par leurs indices (à partir de 0, -1 si absent).
+struct WavefrontData
+{
+	std::vector<vec3> positions;
+	std::vector<vec3> normals;
+	std::vector<vec2> texCoords;
+	std::vector<ivec3> corners; // (position, coords de texture, normale) pour chaque coin de triangle, 3 coins par triangle.
+	std::vector<WavefrontObject> objects;
+	std::string error;
+};
+
+
+// Analyseur de fichiers Wavefront (.obj) sans tinyobjloader. Le fichier est projeté en mémoire et découpé en tranches alignées sur les fins de ligne, analysées en parallèle en deux passes :
+//   1. Compter les sommets, normales, coords de textures et coins de triangles de chaque tranche.
+//   2. Avec les sommes préfixes de ces comptes, chaque tranche connait sa position dans les tableaux finaux et y écrit directement, sans allocation ni fusion après coup.
+// Seule la géométrie (v, vt, vn, f, o, g) est lue. Les matériaux, lignes et points sont ignorés.
+namespace wavefront_detail
+{
+	// Taille minimale d'une tranche. Sous cette taille, le coût de création des fils dépasse le gain.
+	inline constexpr size_t minChunkSize = 1 << 20;
+
+	struct ChunkCounts
+	{
+		size_t numPositions = 0;
+		size_t numNormals = 0;
+		size_t numTexCoords = 0;
+		size_t numCorners = 0;
+	};
+
+	struct ObjectStart
+	{
+		std::string_view name;
+		size_t corner; // Coin à partir duquel l'objet commence (local à la tranche dans la passe 1, global ensuite).
+	};
+
+	struct Chunk
+	{
+		std::string_view text;
+		ChunkCounts counts;
+		ChunkCounts base; // Somme des comptes des tranches précédentes.
+		std::vector<ObjectStart> objectStarts;
+		std::string error;
+	};
+
+	inline bool isBlank(char c) {
+		return c == ' ' or c == '\t' or c == '\r';
+	}
+
+	inline const char* skipBlanks(const char* p, const char* end) {
+		while (p < end and isBlank(*p))
+			p++;
+		return p;
+	}
+
+	inline const char* skipToken(const char* p, const char* end) {
+		while (p < end and not isBlank(*p))
+			p++;
+		return p;
+	}
+
+	// Lire une ligne à partir de p, sans le '\n'. p est avancé au début de la ligne suivante.
+	inline std::string_view nextLine(const char*& p, const char* end) {
+		auto newline = (const char*)std::memchr(p, '\n', end - p);
+		auto lineEnd = newline != nullptr ? newline : end;
+		std::string_view line(p, lineEnd - p);
+		p = newline != nullptr ? newline + 1 : end;
+		return line;
+	}
+
+	// Enlever le commentaire (à partir de '#') à la fin d'une ligne. Les deux passes doivent voir la même ligne, sinon les comptes de la passe 1 ne correspondent plus à ce que la passe 2 écrit.
+	inline std::string_view stripComment(std::string_view line) {
+		return line.substr(0, line.find('#'));
+	}
+
+	// Le mot-clé au début d'une ligne (v, vt, vn, f, o, g, etc.) et le reste de la ligne.
+	inline std::string_view splitKeyword(std::string_view line, const char*& rest) {
+		auto end = line.data() + line.size();
+		auto p = skipBlanks(line.data(), end);
+		auto keywordEnd = skipToken(p, end);
+		rest = skipBlanks(keywordEnd, end);
+		return {p, size_t(keywordEnd - p)};
+	}
+
+	inline std::string_view trimName(const char* p, const char* end) {
+		while (end > p and isBlank(end[-1]))
+			end--;
+		return {p, size_t(end - p)};
+	}
+
+	inline int countFaceVertices(const char* p, const char* end) {
+		int n = 0;
+		while ((p = skipBlanks(p, end)) < end) {
+			p = skipToken(p, end);
+			n++;
+		}
+		return n;
+	}
+
+	inline bool parseFloat(const char*& p, const char* end, float& value) {
+		p = skipBlanks(p, end);
+		// std::from_chars n'accepte pas le '+' explicite.
+		if (p < end and *p == '+')
+			p++;
+		#if defined(__cpp_lib_to_chars)
+		auto [ptr, ec] = std::from_chars(p, end, value);
+		if (ec != std::errc())
+			return false;
+		p = ptr;
+		#else
+		// Les libc++ plus anciennes (dont celle d'AppleClang) n'ont pas std::from_chars pour les float. strtof demande une chaîne terminée par un zéro, ce que la ligne n'est pas dans le fichier projeté, donc on copie le jeton.
+		char token[64];
+		size_t length = std::min<size_t>(skipToken(p, end) - p, sizeof(token) - 1);
+		std::memcpy(token, p, length);
+		token[length] = '\0';
+		char* tokenEnd = nullptr;
+		value = std::strtof(token, &tokenEnd);
+		if (tokenEnd == token)
+			return false;
+		p += tokenEnd - token;
+		#endif
+		return true;
+	}
+
+	// Lire un indice Wavefront (à partir de 1, ou négatif pour relatif à la fin) et le convertir en indice à partir de 0. count est le nombre d'éléments définis jusqu'à maintenant, total le nombre dans le fichier entier.
+	inline bool parseIndex(const char*& p, const char* end, size_t count, size_t total, int& index) {
+		int value = 0;
+		auto [ptr, ec] = std::from_chars(p, end, value);
+		if (ec != std::errc() or value == 0)
+			return false;
+		p = ptr;
+		long long resolved = value > 0 ? (long long)value - 1 : (long long)count + value;
+		if (resolved < 0 or resolved >= (long long)total)
+			return false;
+		index = (int)resolved;
+		return true;
+	}
+
+	// Passe 1 : compter les éléments d'une tranche et noter où commencent les objets.
+	inline void countChunk(Chunk& chunk) {
+		auto p = chunk.text.data();
+		auto end = p + chunk.text.size();
+		while (p < end) {
+			auto line = stripComment(nextLine(p, end));
+			const char* rest;
+			auto keyword = splitKeyword(line, rest);
+			auto lineEnd = line.data() + line.size();
+			if (keyword == "v")
+				chunk.counts.numPositions++;
+			else if (keyword == "vn")
+				chunk.counts.numNormals++;
+			else if (keyword == "vt")
+				chunk.counts.numTexCoords++;
+			else if (keyword == "f")
+				chunk.counts.numCorners += 3 * std::max(countFaceVertices(rest, lineEnd) - 2, 0);
+			else if (keyword == "o" or keyword == "g")
+				chunk.objectStarts.push_back({trimName(rest, lineEnd), chunk.counts.numCorners});
+		}
+	}
+
+	// Passe 2 : lire les valeurs d'une tranche directement à leur place dans les tableaux finaux.
+	inline void parseChunk(Chunk& chunk, const ChunkCounts& totals, WavefrontData& result) {
+		auto pos = chunk.base;
+		auto p = chunk.text.data();
+		auto end = p + chunk.text.size();
+		while (p < end) {
+			auto line = stripComment(nextLine(p, end));
+			const char* rest;
+			auto keyword = splitKeyword(line, rest);
+			auto lineEnd = line.data() + line.size();
+			bool ok = true;
+			if (keyword == "v") {
+				auto& v = result.positions[pos.numPositions++];
+				ok = parseFloat(rest, lineEnd, v.x) and parseFloat(rest, lineEnd, v.y) and parseFloat(rest, lineEnd, v.z);
+			} else if (keyword == "vn") {
+				auto& n = result.normals[pos.numNormals++];
+				ok = parseFloat(rest, lineEnd, n.x) and parseFloat(rest, lineEnd, n.y) and parseFloat(rest, lineEnd, n.z);
+			} else if (keyword == "vt") {
+				auto& t = result.texCoords[pos.numTexCoords++];
+				// La coordonnée v est optionnelle.
+				ok = parseFloat(rest, lineEnd, t.x);
+				if (ok and skipBlanks(rest, lineEnd) < lineEnd)
+					ok = parseFloat(rest, lineEnd, t.y);
+			} else if (keyword == "f") {
+				// Séparer la face en éventail de triangles (0, i, i+1) au fur et à mesure qu'on lit ses sommets.
+				ivec3 first = {}, previous = {};
+				int numFaceVertices = 0;
+				while (ok and (rest = skipBlanks(rest, lineEnd)) < lineEnd) {
+					// Un sommet de face est p, p/t, p//n ou p/t/n.
+					ivec3 corner = {-1, -1, -1};
+					ok = parseIndex(rest, lineEnd, pos.numPositions, totals.numPositions, corner.x);
+					if (ok and rest < lineEnd and *rest == '/') {
+						rest++;
+						if (rest < lineEnd and *rest != '/')
+							ok = parseIndex(rest, lineEnd, pos.numTexCoords, totals.numTexCoords, corner.y);
+						if (ok and rest < lineEnd and *rest == '/') {
+							rest++;
+							ok = parseIndex(rest, lineEnd, pos.numNormals, totals.numNormals, corner.z);
+						}
+					}
+					ok = ok and (rest == lineEnd or isBlank(*rest));
+					if (not ok)
+						break;
+
+					if (numFaceVertices == 0) {
+						first = corner;
+					} else if (numFaceVertices >= 2) {
+						result.corners[pos.numCorners++] = first;
+						result.corners[pos.numCorners++] = previous;
+						result.corners[pos.numCorners++] = corner;
+					}
+					previous = corner;
+					numFaceVertices++;
+				}
+			}
+
+			// On arrête à la première erreur. Les écritures précédentes restent dans l'espace réservé à la tranche par la passe 1.
+			if (not ok) {
+				chunk.error = std::format("invalid line '{}'", trimName(line.data(), line.data() + line.size()));
+				return;
+			}
+		}
+	}
+}
+
+// Analyser le texte d'un fichier Wavefront. Retourne faux et remplit result.error en cas d'erreur.
+inline bool parseWavefront(std::string_view text, WavefrontData& result, unsigned maxThreads = 0) {
+	using namespace wavefront_detail;
+
+	result = {};
+
+	// Découper le texte en tranches qui se terminent sur une fin de ligne.
+	if (maxThreads == 0)
+		maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	size_t numChunks = std::clamp<size_t>(text.size() / minChunkSize, 1, maxThreads);
+	std::vector<Chunk> chunks;
+	chunks.reserve(numChunks);
+	size_t chunkBegin = 0;
+	for (size_t i = 0; i < numChunks and chunkBegin < text.size(); i++) {
+		size_t chunkEnd = text.size() * (i + 1) / numChunks;
+		if (chunkEnd < text.size()) {
+			chunkEnd = text.find('\n', std::max(chunkEnd, chunkBegin));
+			chunkEnd = chunkEnd == std::string_view::npos ? text.size() : chunkEnd + 1;
+		}
+		Chunk chunk;
+		chunk.text = text.substr(chunkBegin, chunkEnd - chunkBegin);
+		chunks.push_back(std::move(chunk));
+		chunkBegin = chunkEnd;
+	}
+
+	// Passe 1 : compter.
+	parallelFor(chunks.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			countChunk(chunks[i]);
+	});
+
+	// Sommes préfixes des comptes pour connaître la position de chaque tranche dans les tableaux finaux.
+	ChunkCounts totals = {};
+	for (auto& chunk : chunks) {
+		chunk.base = totals;
+		totals.numPositions += chunk.counts.numPositions;
+		totals.numNormals += chunk.counts.numNormals;
+		totals.numTexCoords += chunk.counts.numTexCoords;
+		totals.numCorners += chunk.counts.numCorners;
+	}
+	result.positions.resize(totals.numPositions);
+	result.normals.resize(totals.numNormals);
+	result.texCoords.resize(totals.numTexCoords);
+	result.corners.resize(totals.numCorners);
+
+	// Passe 2 : lire les valeurs.
+	parallelFor(chunks.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			parseChunk(chunks[i], totals, result);
+	});
+
+	for (auto& chunk : chunks) {
+		if (not chunk.error.empty()) {
+			result.error = chunk.error;
+			return false;
+		}
+	}
+
+	// Construire la liste des objets. Les faces qui précèdent le premier o ou g forment un objet sans nom. Comme tinyobjloader, on ignore les objets sans faces.
+	std::vector<ObjectStart> starts = {{"", 0}};
+	for (auto& chunk : chunks) {
+		for (auto& start : chunk.objectStarts)
+			starts.push_back({start.name, chunk.base.numCorners + start.corner});
+	}
+	for (size_t i = 0; i < starts.size(); i++) {
+		size_t endCorner = i + 1 < starts.size() ? starts[i + 1].corner : totals.numCorners;
+		if (endCorner > starts[i].corner)
+			result.objects.push_back({std::string(starts[i].name), starts[i].corner, endCorner - starts[i].corner});
+	}
+
+	return true;
+}
+
+// Projeter un fichier Wavefront en mémoire et l'analyser. Retourne faux et remplit result.error en cas d'erreur.
+inline bool parseWavefrontFile(std::string_view filename, WavefrontData& result, unsigned maxThreads = 0) {
+	MappedFile file(filename);
+	if (not file.isOpen()) {
+		result = {};
+		result.error = std::format("{} could not be opened", filename);
+		return false;
+	}
+	return parseWavefront(file.view(), result, maxThreads);
+}
@@ -4,12 +4,27 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <algorithm>
 #include <cctype>
 #include <cmath>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
 
 #include <glbinding/gl/enum.h>
 
@@ -50,6 +65,170 @@ inline std::string replaceAll(std::string str, const std::string& oldSubStr, con
 	return str;
 }
 
+// Appeler func(begin, end) sur des sous-intervalles contigus de [0, count) répartis sur plusieurs fils d'exécution, puis attendre qu'ils aient tous terminé. Chaque fil reçoit au moins minItemsPerThread éléments (pour ne pas créer de fils pour des petites tâches). Si maxThreads est 0, on utilise le nombre de coeurs de la machine.
+template <typename Func>
+inline void parallelFor(size_t count, Func&& func, size_t minItemsPerThread = 1, unsigned maxThreads = 0) {
+	if (maxThreads == 0)
+		maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	size_t numThreads = std::min<size_t>(maxThreads, count / std::max<size_t>(minItemsPerThread, 1));
+	numThreads = std::max<size_t>(numThreads, 1);
+
+	// Pas la peine de créer des fils s'il n'y en a qu'un.
+	if (numThreads == 1) {
+		func((size_t)0, count);
+		return;
+	}
+
+	// Le fil courant fait la dernière tranche pendant que les autres travaillent.
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+	for (size_t i = 0; i < numThreads - 1; i++)
+		threads.emplace_back(func, count * i / numThreads, count * (i + 1) / numThreads);
+	func(count * (numThreads - 1) / numThreads, count);
+	for (auto& thread : threads)
+		thread.join();
+}
+
+// Hachage FNV-1a 64 bits d'un bloc d'octets. Pas cryptographique, mais rapide et stable d'une exécution à l'autre (contrairement à std::hash), donc utilisable pour valider des fichiers de cache sur le disque. On peut enchaîner les appels en passant le hash précédent comme valeur de départ.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull) {
+	auto bytes = (const unsigned char*)data;
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+// Un fichier projeté en mémoire (memory-mapped) en lecture seule. Le système d'exploitation charge les pages du fichier à la demande, on n'a donc pas besoin de copier le contenu dans un tampon avant de le lire.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+
+	MappedFile(std::string_view filename) {
+		open(filename);
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator= (const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	MappedFile& operator= (MappedFile&& other) noexcept {
+		if (this != &other) {
+			close();
+			std::swap(data_, other.data_);
+			std::swap(size_, other.size_);
+			std::swap(isOpen_, other.isOpen_);
+		}
+		return *this;
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	const char* data() const { return data_; }
+	size_t size() const { return size_; }
+	bool isOpen() const { return isOpen_; }
+	std::string_view view() const { return {data_, size_}; }
+
+	bool open(std::string_view filename) {
+		close();
+		std::string name(filename);
+	#ifdef _WIN32
+		HANDLE file = CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize = {};
+		GetFileSizeEx(file, &fileSize);
+		size_ = (size_t)fileSize.QuadPart;
+		// On ne peut pas projeter un fichier vide, mais c'est quand même un fichier valide.
+		if (size_ != 0) {
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping != nullptr) {
+				data_ = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				// La vue garde une référence sur la projection, on peut donc fermer les handles tout de suite.
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(file);
+	#else
+		int fd = ::open(name.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat fileInfo = {};
+		fstat(fd, &fileInfo);
+		size_ = (size_t)fileInfo.st_size;
+		// On ne peut pas projeter un fichier vide, mais c'est quand même un fichier valide.
+		if (size_ != 0) {
+			void* ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			data_ = ptr != MAP_FAILED ? (const char*)ptr : nullptr;
+		}
+		// La projection reste valide après la fermeture du descripteur.
+		::close(fd);
+	#endif
+		if (size_ != 0 and data_ == nullptr) {
+			size_ = 0;
+			return false;
+		}
+		isOpen_ = true;
+		return true;
+	}
+
+	void close() {
+		if (data_ != nullptr) {
+		#ifdef _WIN32
+			UnmapViewOfFile(data_);
+		#else
+			munmap((void*)data_, size_);
+		#endif
+		}
+		data_ = nullptr;
+		size_ = 0;
+		isOpen_ = false;
+	}
+
+private:
+	const char* data_ = nullptr;
+	size_t size_ = 0;
+	bool isOpen_ = false;
+};
+
+// Écrire un fichier en passant par un fichier temporaire propre au fil d'exécution, renommé une fois complet. Deux fils qui écrivent le même fichier (par exemple deux chargements de la même image par AssetLoader) ne mélangent donc pas leurs données, et un lecteur ne voit jamais un fichier à moitié écrit. write(std::ofstream&) écrit le contenu.
+template <typename WriteFunc>
+inline bool writeFileAtomically(const std::string& filename, WriteFunc&& write) {
+	std::string tempFilename = filename + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	std::error_code error;
+	{
+		std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+		if (not file)
+			return false;
+		write(file);
+		if (not file) {
+			file.close();
+			std::filesystem::remove(tempFilename, error);
+			return false;
+		}
+	}
+	std::filesystem::rename(tempFilename, filename, error);
+	if (error) {
+		std::error_code removeError;
+		std::filesystem::remove(tempFilename, removeError);
+		return false;
+	}
+	return true;
+}
+
+// Un flottant 16 bits (half float) stocké tel quel. Sert seulement au stockage dans des tampons (attributs de sommets compacts), pas aux calculs.
+struct Half
+{
+	uint16_t bits;
+};
+
 template <typename T>
 inline constexpr gl::GLenum getTypeGLenum() {
 	using namespace gl;
@@ -70,6 +249,8 @@ inline constexpr gl::GLenum getTypeGLenum() {
 		return GL_FLOAT;
 	else if constexpr (std::is_same_v<T, GLdouble>)
 		return GL_DOUBLE;
+	else if constexpr (std::is_same_v<T, Half>)
+		return GL_HALF_FLOAT;
 	else
 		return GL_INVALID_ENUM;
 }